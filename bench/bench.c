@@ -0,0 +1,79 @@
+/**
+ * @file bench.c
+ * @brief Microbenchmark harness
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "bench.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief Gets the current time (in nanoseconds) from a monotonic clock
+ * @author A104348 Humberto Gomes
+ */
+uint64_t bench_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * @brief Comparison function of `uint64_t`s for `qsort`
+ * @author A104348 Humberto Gomes
+ */
+int bench_compare(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+	return (x > y) - (x < y);
+}
+
+void bench_print_header(void) {
+	printf("benchmark\titerations\tmin_ns\tmedian_ns\tp99_ns\n");
+}
+
+void bench_run(const char *name, size_t iterations, bench_function run, bench_function reset,
+               void *data) {
+
+	uint64_t *times = malloc(iterations * sizeof(uint64_t));
+	if (!times || iterations == 0) {
+		free(times);
+		return;
+	}
+
+	for (size_t i = 0; i < iterations; ++i) {
+		if (reset) reset(data);
+
+		uint64_t start = bench_now();
+		run(data);
+		times[i] = bench_now() - start;
+	}
+
+	qsort(times, iterations, sizeof(uint64_t), bench_compare);
+	size_t p99 = (iterations * 99 + 99) / 100 - 1; /* Nearest rank */
+
+	printf("%s\t%zu\t%llu\t%llu\t%llu\n", name, iterations,
+	       (unsigned long long) times[0],
+	       (unsigned long long) times[iterations / 2],
+	       (unsigned long long) times[p99]);
+	fflush(stdout);
+
+	free(times);
+}
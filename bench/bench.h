@@ -0,0 +1,59 @@
+/**
+ * @file bench.h
+ * @brief Microbenchmark harness
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+/**
+ * @brief A function run by a benchmark
+ * @param data Data passed to ::bench_run
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef void (*bench_function)(void *data);
+
+/**
+ * @brief Prints the header of the table of results (tab-separated values)
+ * @details Columns: benchmark name, iterations, and minimum, median and 99th percentile time of
+ *          a single iteration (in nanoseconds).
+ *
+ * @author A104348 Humberto Gomes
+ */
+void bench_print_header(void);
+
+/**
+ * @brief Runs and times a benchmark, printing its results as a line of the table
+ *
+ * @param name       Name of the benchmark (first column)
+ * @param iterations Number of timed iterations
+ * @param run        Function to be timed
+ * @param reset      Function called (untimed) before every iteration to restore the initial
+ *                   conditions. Can be `NULL`.
+ * @param data       Data passed to @p run and @p reset
+ *
+ * @author A104348 Humberto Gomes
+ */
+void bench_run(const char *name, size_t iterations, bench_function run, bench_function reset,
+               void *data);
+
+#endif
@@ -0,0 +1,397 @@
+/**
+ * @file bench/main.c
+ * @brief Microbenchmarks for the engine's hot kernels (`make bench`)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "bench.h"
+
+#include <combat.h>
+#include <entities_search.h>
+#include <generate_map.h>
+#include <map.h>
+#include <random.h>
+#include <game_states/illumination.h>
+#include <game_states/main_game.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ncurses.h>
+
+#define BENCH_SEED 1234 /**< @brief Seed of the generated maps (fixed, for comparable results) */
+
+#define BENCH_MAP_SIZE 1024 /**< @brief Size of the generated maps (like in the game) */
+
+/** @brief Size of the terminal simulated for map rendering */
+#define BENCH_TERMINAL_WIDTH  160
+#define BENCH_TERMINAL_HEIGHT 48
+
+/**
+ * @struct bench_generate_data
+ * @brief Data for the ::generate_random benchmarks
+ *
+ * @var bench_generate_data::scratch
+ *   Scratch map for ::generate_random
+ * @var bench_generate_data::map
+ *   Output map
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	map scratch, map;
+} bench_generate_data;
+
+/**
+ * @brief Generates walls in a map (::generate_random, whose cost is dominated by `radius_count`)
+ * @author A104348 Humberto Gomes
+ */
+void bench_generate_random(void *data) {
+	bench_generate_data *gen = data;
+	generate_random(gen->scratch, gen->map, 5, 2, TILE_WALL, rng_create(BENCH_SEED, 0));
+}
+
+/**
+ * @struct bench_path_data
+ * @brief Data for the ::search_path benchmarks
+ *
+ * @var bench_path_data::map
+ *   Map to search a path in
+ * @var bench_path_data::start
+ *   Start of the path
+ * @var bench_path_data::end
+ *   Destination of the path
+ * @var bench_path_data::scratch
+ *   Arena for temporary data
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	map *map;
+	animation_step start, end;
+	arena scratch;
+} bench_path_data;
+
+/**
+ * @brief Finds a path between two points (::search_path)
+ * @author A104348 Humberto Gomes
+ */
+void bench_search_path(void *data) {
+	bench_path_data *path = data;
+	animation_sequence s = search_path(path->map, ENTITY_RAT, path->start, path->end,
+	                                   &path->scratch);
+	animation_sequence_free(NULL, s);
+}
+
+/**
+ * @struct bench_light_data
+ * @brief Data for the ::state_main_game_circle_light_map benchmarks
+ *
+ * @var bench_light_data::map
+ *   Map to be lit
+ * @var bench_light_data::x
+ *   Horizontal position of the light source
+ * @var bench_light_data::y
+ *   Vertical position of the light source
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	map map;
+	int x, y;
+} bench_light_data;
+
+/**
+ * @brief Lights a circle of the map (::state_main_game_circle_light_map)
+ * @author A104348 Humberto Gomes
+ */
+void bench_light(void *data) {
+	bench_light_data *light = data;
+	state_main_game_circle_light_map(light->map, light->x, light->y, CIRCLE_RADIUS);
+}
+
+/**
+ * @brief Removes the light added by ::bench_light (untimed)
+ * @author A104348 Humberto Gomes
+ */
+void bench_light_reset(void *data) {
+	bench_light_data *light = data;
+	state_main_game_circle_clean_light_map(light->map, light->x, light->y, CIRCLE_RADIUS);
+}
+
+/**
+ * @struct bench_closeby_data
+ * @brief Data for the ::entity_get_closeby benchmarks
+ *
+ * @var bench_closeby_data::state
+ *   Game whose entities are searched
+ * @var bench_closeby_data::candidates
+ *   Indices of the entities to choose from
+ * @var bench_closeby_data::candidate_count
+ *   Number of indices in ::bench_closeby_data::candidates
+ * @var bench_closeby_data::out
+ *   Output buffer
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	state_main_game_data *state;
+	const size_t *candidates;
+	size_t candidate_count;
+	entity_handle out[16];
+} bench_closeby_data;
+
+/**
+ * @brief Finds the entities closest to the player (::entity_get_closeby)
+ * @author A104348 Humberto Gomes
+ */
+void bench_closeby(void *data) {
+	bench_closeby_data *closeby = data;
+	entity_get_closeby(PLAYER_X(closeby->state), PLAYER_Y(closeby->state),
+	                   closeby->state->entities, closeby->candidates, closeby->candidate_count,
+	                   sizeof(closeby->out) / sizeof(entity_handle), closeby->out);
+}
+
+/**
+ * @brief Lists the entities on lit tiles around the player (::entity_set_get_lit)
+ * @author A104348 Humberto Gomes
+ */
+void bench_lit(void *data) {
+	state_main_game_data *state = data;
+	state->lit_count = entity_set_get_lit(state->entities, &state->map,
+	                                      PLAYER_X(state), PLAYER_Y(state), CIRCLE_RADIUS,
+	                                      state->lit);
+}
+
+/**
+ * @struct bench_damage_data
+ * @brief Data for the ::combat_deal_damage_position benchmark
+ *
+ * @var bench_damage_data::state
+ *   Game whose entities are attacked
+ * @var bench_damage_data::rng
+ *   Random number generator for the damage dealt
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	state_main_game_data *state;
+	rng rng;
+} bench_damage_data;
+
+/**
+ * @brief   Attacks a position (::combat_deal_damage_position)
+ * @details The corner of the map is always a wall, so no entity is there (a miss).
+ *
+ * @author A104348 Humberto Gomes
+ */
+void bench_damage(void *data) {
+	bench_damage_data *damage = data;
+	combat_deal_damage_position(WEAPON_BOMB, damage->state->entities, 0, 0, NULL, NULL,
+	                            &damage->rng);
+}
+
+/**
+ * @struct bench_render_data
+ * @brief Data for the ::map_render benchmark
+ *
+ * @var bench_render_data::map
+ *   Map to be rendered
+ * @var bench_render_data::wnd
+ *   Visible window of the map
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	map map;
+	map_window wnd;
+} bench_render_data;
+
+/**
+ * @brief Renders the map to an ncurses window (::map_render)
+ * @author A104348 Humberto Gomes
+ */
+void bench_map_render(void *data) {
+	bench_render_data *render = data;
+	map_render(render->map, &render->wnd);
+}
+
+/**
+ * @brief Generates a map full of walls, except for an open square at its center
+ * @details Used as a worst case for ::search_path, when its destination is a wall (the whole map
+ *          is scanned for the nearest empty tile).
+ *
+ * @author A104348 Humberto Gomes
+ */
+void bench_walled_map(map m, int open_radius) {
+	for (unsigned y = 0; y < m.height; ++y) {
+		for (unsigned x = 0; x < m.width; ++x) {
+			int dx = (int) x - (int) m.width / 2, dy = (int) y - (int) m.height / 2;
+			m.data[y * m.width + x].type =
+				(abs(dx) <= open_radius && abs(dy) <= open_radius) ? TILE_EMPTY : TILE_WALL;
+			m.data[y * m.width + x].light = 0;
+		}
+	}
+}
+
+/**
+ * @brief Runs the benchmarks of ::generate_random
+ * @author A104348 Humberto Gomes
+ */
+void bench_run_generation(void) {
+	const unsigned sizes[2] = { 256, BENCH_MAP_SIZE };
+	const size_t iterations[2] = { 50, 5 };
+	const char *names[2] = { "generate_random/256", "generate_random/1024" };
+
+	for (int i = 0; i < 2; ++i) {
+		bench_generate_data gen = {
+			.scratch = map_allocate(sizes[i], sizes[i]),
+			.map     = map_allocate(sizes[i], sizes[i])
+		};
+
+		if (gen.scratch.data && gen.map.data)
+			bench_run(names[i], iterations[i], bench_generate_random, NULL, &gen);
+
+		map_free(gen.scratch);
+		map_free(gen.map);
+	}
+}
+
+/**
+ * @brief Runs the benchmarks of ::search_path and ::state_main_game_circle_light_map on
+ *        synthetic maps
+ *
+ * @author A104348 Humberto Gomes
+ */
+void bench_run_synthetic_maps(void) {
+	map m = map_allocate(BENCH_MAP_SIZE, BENCH_MAP_SIZE);
+	if (!m.data) return;
+
+	animation_step center = { BENCH_MAP_SIZE / 2, BENCH_MAP_SIZE / 2 };
+
+	/* Open map: BFS through free space */
+	map_zero(m);
+	bench_path_data path = {
+		.map     = &m,
+		.start   = center,
+		.end     = { center.x + 20, center.y },
+		.scratch = arena_create(64 * 1024)
+	};
+	bench_run("search_path/open_reachable", 50, bench_search_path, NULL, &path);
+
+	/* Unreachable destination: the whole diamond within the search limit is explored */
+	path.end = (animation_step) { center.x + 200, center.y + 200 };
+	bench_run("search_path/open_unreachable", 50, bench_search_path, NULL, &path);
+
+	bench_light_data light = { .map = m, .x = center.x, .y = center.y };
+	bench_run("circle_light_map/open", 1000, bench_light, bench_light_reset, &light);
+
+	/* Destination in a wall: the whole map is scanned for the nearest empty tile */
+	bench_walled_map(m, 8);
+	path.end = (animation_step) { 0, 0 };
+	bench_run("search_path/wall_destination", 20, bench_search_path, NULL, &path);
+
+	arena_free(&path.scratch);
+	map_free(m);
+}
+
+/**
+ * @brief Runs the benchmarks that require a generated game
+ * @author A104348 Humberto Gomes
+ */
+void bench_run_game(void) {
+	char name[SCORE_NAME_MAX + 1] = "bench";
+	game_state game = state_main_game_create(name, BENCH_SEED);
+	state_main_game_data *state = game.data;
+	animation_step player = { PLAYER_X(state), PLAYER_Y(state) };
+
+	bench_path_data path = {
+		.map     = &state->map,
+		.start   = { player.x, player.y },
+		.end     = { player.x + 10, player.y + 10 },
+		.scratch = arena_create(64 * 1024)
+	};
+	bench_run("search_path/game", 50, bench_search_path, NULL, &path);
+	arena_free(&path.scratch);
+
+	bench_light_data light = { .map = state->map, .x = player.x, .y = player.y };
+	bench_run("circle_light_map/game", 1000, bench_light, bench_light_reset, &light);
+	bench_light(&light); /* Leave the map lit, like in the game */
+	bench_run("entity_set_get_lit/game", 1000, bench_lit, NULL, state);
+
+	bench_closeby_data closeby = {
+		.state           = state,
+		.candidates      = state->lit,
+		.candidate_count = state->lit_count
+	};
+	bench_run("entity_get_closeby/visible", 1000, bench_closeby, NULL, &closeby);
+	closeby.candidates = entity_set_get_live(state->entities, &closeby.candidate_count);
+	bench_run("entity_get_closeby/all", 1000, bench_closeby, NULL, &closeby);
+
+	bench_damage_data damage = { .state = state, .rng = rng_create(BENCH_SEED, 0) };
+	bench_run("combat_deal_damage_position/miss", 1000, bench_damage, NULL, &damage);
+
+	/* Render to a terminal whose output is discarded */
+	FILE *out = fopen("/dev/null", "w"), *in = fopen("/dev/null", "r");
+	SCREEN *screen = (out && in) ? newterm("xterm-256color", out, in) : NULL;
+	if (screen) {
+		start_color();
+		for (int col = COLOR_BLACK; col <= COLOR_WHITE; ++col)
+			init_pair(col, col, COLOR_BLACK);
+
+		bench_render_data render = {
+			.map = state->map,
+			.wnd = {
+				.map_top   = player.y - BENCH_TERMINAL_HEIGHT / 2,
+				.map_left  = player.x - BENCH_TERMINAL_WIDTH  / 2,
+				.term_top  = 0, .term_left = 0,
+				.height    = BENCH_TERMINAL_HEIGHT, .width = BENCH_TERMINAL_WIDTH,
+				.win       = newwin(BENCH_TERMINAL_HEIGHT, BENCH_TERMINAL_WIDTH, 0, 0)
+			}
+		};
+
+		if (render.wnd.win) {
+			bench_run("map_render/160x48", 1000, bench_map_render, NULL, &render);
+			delwin(render.wnd.win);
+		}
+
+		endwin();
+		delscreen(screen);
+	} else {
+		fprintf(stderr, "Failed to create terminal: map_render not benchmarked\n");
+	}
+
+	if (out) fclose(out);
+	if (in)  fclose(in);
+
+	game.destroy(&game);
+}
+
+/**
+ * @brief The entry point for the benchmarks
+ * @details Results are printed to `stdout` as tab-separated values (see ::bench_print_header).
+ * @author A104348 Humberto Gomes
+ */
+int main(void) {
+	bench_print_header();
+
+	bench_run_generation();
+	bench_run_synthetic_maps();
+	bench_run_game();
+
+	return 0;
+}
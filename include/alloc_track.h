@@ -0,0 +1,120 @@
+/**
+ * @file alloc_track.h
+ * @brief Accounting of memory allocations per subsystem (compiled in with `ALLOC_TRACK=1 make`)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef ALLOC_TRACK_H
+#define ALLOC_TRACK_H
+
+/**
+ * @brief   Subsystems allocations are attributed to
+ * @details Each thread has a current tag (::ALLOC_TAG_OTHER by default), set by ::ALLOC_TAG_BEGIN.
+ * @author  A104348 Humberto Gomes
+ */
+typedef enum {
+	ALLOC_TAG_OTHER,          /**< Allocations outside all tagged subsystems */
+	ALLOC_TAG_MAP_GENERATION, /**< ::generate_map_random */
+	ALLOC_TAG_ENTITIES,       /**< Entity sets */
+	ALLOC_TAG_ANIMATION,      /**< Animation sequences */
+	ALLOC_TAG_PATH_FINDING,   /**< ::search_path */
+	ALLOC_TAG_COMBAT,         /**< Combat targets and the combat overlay */
+	ALLOC_TAG_MSG_BOX,        /**< Message boxes */
+	ALLOC_TAG_RENDERING,      /**< Rendering of the main game */
+	ALLOC_TAG_LIGHTING,       /**< Light masks cached by ::light_cache */
+	ALLOC_TAG_COUNT           /**< Number of tags (not a tag) */
+} alloc_tag;
+
+#ifdef ALLOC_TRACK
+
+	/**
+	 * @brief Attributes the following allocations (until ::ALLOC_TAG_END in the same scope) to
+	 *        @p tag
+	 */
+	#define ALLOC_TAG_BEGIN(tag) alloc_tag alloc_previous_tag = alloc_track_set_tag(tag)
+
+	/** @brief Restores the tag that was current before ::ALLOC_TAG_BEGIN */
+	#define ALLOC_TAG_END() alloc_track_set_tag(alloc_previous_tag)
+
+	/** @brief Marks the end of a frame (see ::alloc_track_end_frame) */
+	#define ALLOC_TRACK_END_FRAME() alloc_track_end_frame()
+
+	/** @brief Marks the end of a game turn (see ::alloc_track_end_turn) */
+	#define ALLOC_TRACK_END_TURN() alloc_track_end_turn()
+
+	/** @brief Makes the results be written to a file on exit (see ::alloc_track_init) */
+	#define ALLOC_TRACK_INIT(path) alloc_track_init(path)
+
+#else
+
+	#define ALLOC_TAG_BEGIN(tag)
+	#define ALLOC_TAG_END()         ((void) 0)
+	#define ALLOC_TRACK_END_FRAME() ((void) 0)
+	#define ALLOC_TRACK_END_TURN()  ((void) 0)
+	#define ALLOC_TRACK_INIT(path)  ((void) 0)
+
+#endif
+
+/**
+ * @brief Changes the tag of the current thread
+ * @returns The previous tag
+ *
+ * @author A104348 Humberto Gomes
+ */
+alloc_tag alloc_track_set_tag(alloc_tag tag);
+
+/**
+ * @brief Gets the name of an ::alloc_tag
+ * @author A104348 Humberto Gomes
+ */
+const char *alloc_tag_get_name(alloc_tag tag);
+
+/**
+ * @brief   Marks the end of a frame of the game loop
+ * @details The number of allocations and of bytes allocated in each frame are accounted.
+ * @author  A104348 Humberto Gomes
+ */
+void alloc_track_end_frame(void);
+
+/**
+ * @brief   Marks the end of a game turn
+ * @details Like ::alloc_track_end_frame, but for turns. Per-turn values are only meaningful when
+ *          one game is played at a time (not in `--batch` mode).
+ *
+ * @author A104348 Humberto Gomes
+ */
+void alloc_track_end_turn(void);
+
+/**
+ * @brief Writes allocation statistics (per subsystem, per frame and per turn) and the peak
+ *        resident set size to a file
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int alloc_track_dump(const char *path);
+
+/**
+ * @brief Makes ::alloc_track_dump be called (with @p path) when the program exits
+ * @param path Path of the output file. Must be valid until the end of the program.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void alloc_track_init(const char *path);
+
+#endif
@@ -34,43 +34,153 @@ typedef struct {
 	int x, y;
 } animation_step;
 
-/*
+/** @brief Number of steps an ::animation_sequence holds without needing pooled storage */
+#define ANIMATION_SEQUENCE_INLINE_STEPS 8
+
+/** @brief Number of steps in the smallest block of pooled storage */
+#define ANIMATION_POOL_MINIMUM_STEPS 16
+
+/**
+ * @brief Number of block sizes in the pool (each double the previous one)
+ * @details Longer sequences than the largest block size are allocated directly with `malloc`.
+ */
+#define ANIMATION_POOL_CLASSES 12
+
+/**
+ * @brief A free block of an ::animation_pool, whose memory links it to the next free block
+ */
+typedef struct animation_pool_block animation_pool_block;
+
+/**
+ * @brief A chunk of memory an ::animation_pool cuts blocks from
+ */
+typedef struct animation_pool_slab animation_pool_slab;
+
+/**
+ * @struct animation_pool
+ * @brief   Slab allocator for the steps of long animation sequences
+ * @details Blocks are recycled instead of being returned to the heap, and all slabs are freed
+ *          at once by ::animation_pool_free. A pool isn't thread-safe: each one must only be used
+ *          by one thread at a time (e.g.: the pool of the entities of a game).
+ *
+ * @var animation_pool::free_blocks
+ *   Lists of free blocks, one for each block size
+ * @var animation_pool::slabs
+ *   List of all slabs allocated by the pool
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	animation_pool_block *free_blocks[ANIMATION_POOL_CLASSES];
+	animation_pool_slab *slabs;
+} animation_pool;
+
+/**
  * @struct animation_sequence
  * @brief A sequence of animation steps
+ * @details Short sequences (most paths) are stored inline. Longer ones spill into blocks of an
+ *          ::animation_pool, or into the heap when no pool is given. Use
+ *          ::animation_sequence_get_steps to access the steps, as they may be in either place.
+ *          Copies of a sequence are only valid for reading, and only one of them can be freed.
+ *          A sequence must always be used with the same pool (or always without one).
  *
- * @var animation_sequence::steps
- *   The pointer to the array of animation steps
- * @var animation_sequence::lenght
+ * @var animation_sequence::inline_steps
+ *   Storage for the steps when ::animation_sequence::capacity is
+ *   ::ANIMATION_SEQUENCE_INLINE_STEPS
+ * @var animation_sequence::pooled_steps
+ *   Storage for the steps when ::animation_sequence::capacity is larger
+ * @var animation_sequence::length
  *   The number of animation steps
  * @var animation_sequence::capacity
- *   The maximum number of steps that ::animation_sequence::steps can hold.
+ *   The maximum number of steps that can be held without growing the storage
  *
  * @author A104348 Humberto Gomes
  */
 typedef struct {
-	animation_step *steps;
+	union {
+		animation_step inline_steps[ANIMATION_SEQUENCE_INLINE_STEPS];
+		animation_step *pooled_steps;
+	} storage;
 	size_t length, capacity;
 } animation_sequence;
 
-#define ANIMATION_SEQUENCE_STARTING_CAPACITY 16
+/**
+ * @brief Creates an empty ::animation_pool
+ * @details This doesn't allocate any memory.
+ *
+ * @author A104348 Humberto Gomes
+ */
+animation_pool animation_pool_create(void);
+
+/**
+ * @brief Frees all memory of an ::animation_pool
+ * @details Sequences with steps in the pool become invalid.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void animation_pool_free(animation_pool *pool);
 
 /**
  * @brief Creates an animation sequence with no steps
+ * @details This doesn't allocate any memory.
+ *
  * @author A104348 Humberto Gomes
  */
 animation_sequence animation_sequence_create(void);
 
 /**
  * @brief Frees memory for an ::animation_sequence
+ * @details Pooled storage is returned to the pool, not to the heap.
+ *
+ * @param pool The pool the sequence was made with (`NULL` for the heap)
+ * @param s    The sequence
+ *
  * @author A104348 Humberto Gomes
  */
-void animation_sequence_free(animation_sequence s);
+void animation_sequence_free(animation_pool *pool, animation_sequence s);
+
+/**
+ * @brief Gets the array of steps of an ::animation_sequence
+ * @details The returned pointer is invalidated when steps are added to the sequence.
+ *
+ * @author A104348 Humberto Gomes
+ */
+animation_step *animation_sequence_get_steps(animation_sequence *sequence);
+
+/**
+ * @brief Makes sure an ::animation_sequence can hold @p capacity steps without growing
+ *
+ * @param pool     Where to allocate storage from (`NULL` for the heap)
+ * @param sequence The sequence
+ * @param capacity Number of steps. On allocation failure, the capacity isn't changed.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void animation_sequence_reserve(animation_pool *pool, animation_sequence *sequence,
+                                size_t capacity);
 
 /**
  * @brief Adds an ::animation_step to and ::animation_sequence
+ * @param pool Where to allocate storage from (`NULL` for the heap)
+ *
+ * @author A104348 Humberto Gomes
+ */
+void animation_sequence_add_step(animation_pool *pool, animation_sequence *sequence,
+                                 animation_step add);
+
+/**
+ * @brief   Copies an ::animation_sequence
+ * @details Lets sequences be moved between pools (e.g.: paths found on other threads, on the
+ *          heap, into the pool of a game).
+ *
+ * @param pool     Where to allocate storage for the copy from (`NULL` for the heap)
+ * @param sequence The sequence to copy (only read)
+ *
+ * @returns The copy, with no steps on allocation failure
+ *
  * @author A104348 Humberto Gomes
  */
-void animation_sequence_add_step(animation_sequence *sequence, animation_step add);
+animation_sequence animation_sequence_copy(animation_pool *pool, animation_sequence *sequence);
 
 #endif
 
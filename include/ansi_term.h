@@ -0,0 +1,112 @@
+/**
+ * @file ansi_term.h
+ * @brief Terminal output backend that writes ANSI escape sequences directly
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef ANSI_TERM_H
+#define ANSI_TERM_H
+
+#include <stddef.h>
+#include <ncurses.h>
+
+/**
+ * @struct ansi_term_stats
+ * @brief Output statistics of an ::ansi_term
+ *
+ * @var ansi_term_stats::frames
+ *   Number of frames presented
+ * @var ansi_term_stats::last_frame_bytes
+ *   Number of bytes written to the terminal in the last frame
+ * @var ansi_term_stats::max_frame_bytes
+ *   Largest number of bytes written in a single frame
+ * @var ansi_term_stats::total_bytes
+ *   Number of bytes written to the terminal since the creation of the backend
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	size_t frames;
+	size_t last_frame_bytes, max_frame_bytes, total_bytes;
+} ansi_term_stats;
+
+/**
+ * @brief   An ANSI / VT100 terminal output backend.
+ * @details Frames are diffed against what is known to be on the screen, and only the changed
+ *          cells are output. Cursor movements are relative whenever that is shorter, and the
+ *          current SGR (graphic rendition) state is tracked, so that attributes are only sent
+ *          when they change. A whole frame is sent to the terminal with a single `write(2)`.
+ *
+ *          Only ncurses is used for terminal mode setup and input: no output is done by it.
+ */
+typedef struct ansi_term ansi_term;
+
+/**
+ * @brief Creates an ANSI terminal backend
+ * @details ncurses must have been initialized (with colors), as color pair information is
+ *          queried from it.
+ *
+ * @param fd The file descriptor of the terminal (usually `STDOUT_FILENO`)
+ * @returns `NULL` on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+ansi_term *ansi_term_create(int fd);
+
+/**
+ * @brief Frees an ::ansi_term, resetting the terminal's graphic rendition
+ * @author A104348 Humberto Gomes
+ */
+void ansi_term_free(ansi_term *term);
+
+/**
+ * @brief Forgets what is on the screen, so that the next frame is fully redrawn
+ * @author A104348 Humberto Gomes
+ */
+void ansi_term_invalidate(ansi_term *term);
+
+/**
+ * @brief Outputs a frame to the terminal
+ *
+ * @param term   The terminal backend
+ * @param cells  @p width * @p height ncurses cells (character, attributes and color pair),
+ *               ordered by lines
+ * @param width  Width of the frame (and of the terminal)
+ * @param height Height of the frame (and of the terminal)
+ *
+ * @returns 0 on success, 1 on failure to write to the terminal
+ *
+ * @author A104348 Humberto Gomes
+ */
+int ansi_term_present(ansi_term *term, const chtype *cells, int width, int height);
+
+/**
+ * @brief Outputs the contents of an ncurses window (usually `newscr`) to the terminal
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int ansi_term_present_window(ansi_term *term, WINDOW *win);
+
+/**
+ * @brief Gets the output statistics of an ::ansi_term
+ * @author A104348 Humberto Gomes
+ */
+ansi_term_stats ansi_term_get_stats(const ansi_term *term);
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * @file arena.h
+ * @brief Bump-pointer allocator for short-lived data
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/**
+ * @brief A block of memory of an ::arena (blocks form a linked list)
+ */
+typedef struct arena_block arena_block;
+
+/**
+ * @struct arena
+ * @brief   A bump-pointer allocator
+ * @details Allocations are very cheap (a pointer increment), and there's no way to free them
+ *          individually: all memory is reclaimed at once, with ::arena_reset or ::arena_restore.
+ *          When a block is full, another one is chained to it. On reset, all blocks are merged
+ *          into a single one, large enough for the peak usage, so that an arena used in a loop
+ *          stops touching the heap after the first iterations.
+ *
+ * @var arena::first
+ *   First block of the list
+ * @var arena::block
+ *   Block where allocations are currently made. Blocks after it are empty, and are reused before
+ *   new ones are allocated.
+ * @var arena::used
+ *   Bytes used in ::arena::block
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	arena_block *first, *block;
+	size_t used;
+} arena;
+
+/**
+ * @struct arena_mark
+ * @brief A position in an ::arena, to which it can go back (see ::arena_restore)
+ *
+ * @var arena_mark::block
+ *   Block that was in use
+ * @var arena_mark::used
+ *   Bytes used in ::arena_mark::block
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	arena_block *block;
+	size_t used;
+} arena_mark;
+
+/**
+ * @brief Creates an ::arena
+ * @param capacity Initial capacity in bytes
+ * @returns An arena with a `NULL` ::arena::block on allocation failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+arena arena_create(size_t capacity);
+
+/**
+ * @brief Frees all memory of an ::arena
+ * @author A104348 Humberto Gomes
+ */
+void arena_free(arena *a);
+
+/**
+ * @brief Allocates memory from an ::arena
+ * @details Memory is suitably aligned for any type, and is uninitialized.
+ * @returns `NULL` on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+void *arena_alloc(arena *a, size_t size);
+
+/**
+ * @brief Frees all allocations made from an ::arena
+ * @details Pointers obtained from the arena become invalid.
+ * @author A104348 Humberto Gomes
+ */
+void arena_reset(arena *a);
+
+/**
+ * @brief Gets the current position of an ::arena (see ::arena_restore)
+ * @author A104348 Humberto Gomes
+ */
+arena_mark arena_get_mark(const arena *a);
+
+/**
+ * @brief   Frees the allocations made since @p mark was obtained
+ * @details Lets a function use an arena for temporary data without consuming it, even when that
+ *          arena is also used by its caller.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void arena_restore(arena *a, arena_mark mark);
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file batch.h
+ * @brief Simulation of many games in parallel (Monte Carlo), for balancing and benchmarking
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <entities.h>
+#include <headless.h>
+
+/**
+ * @struct batch_result
+ * @brief Aggregated results of ::batch_run
+ *
+ * @var batch_result::games
+ *   Number of games played
+ * @var batch_result::threads
+ *   Number of threads the games were played on
+ * @var batch_result::wall_time
+ *   Real time (in seconds) taken to play all games
+ *
+ * @var batch_result::deaths
+ *   Number of games where the player died before the turn limit
+ * @var batch_result::total_turns
+ *   Sum of the number of turns survived in each game
+ * @var batch_result::min_turns
+ *   Smallest number of turns survived in a game
+ * @var batch_result::max_turns
+ *   Largest number of turns survived in a game
+ *
+ * @var batch_result::total_score
+ *   Sum of the final scores of all games
+ * @var batch_result::max_score
+ *   Highest final score
+ *
+ * @var batch_result::kills
+ *   Number of entities of each ::entity_type killed, in all games
+ * @var batch_result::timers
+ *   CPU time spent on each ::headless_phase, in all games
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	unsigned int games;
+	size_t threads;
+	double wall_time;
+
+	unsigned int deaths;
+	unsigned long long total_turns;
+	unsigned int min_turns, max_turns;
+
+	long long total_score;
+	int max_score;
+
+	unsigned long long kills[ENTITY_TYPE_COUNT];
+	headless_timer timers[HEADLESS_PHASE_COUNT];
+} batch_result;
+
+/**
+ * @brief   Plays many independent headless games (see ::headless_run) in parallel
+ * @details Game `i` uses seed `seed + i`, so results don't depend on the number of threads.
+ *
+ * @param games   Number of games to play
+ * @param threads Number of threads (`0` for the number of CPUs)
+ * @param seed    Seed of the first game
+ * @param turns   Maximum number of turns per game
+ *
+ * @author A104348 Humberto Gomes
+ */
+batch_result batch_run(unsigned int games, size_t threads, unsigned int seed, unsigned int turns);
+
+/**
+ * @brief Prints the results of ::batch_run in a human readable format
+ * @author A104348 Humberto Gomes
+ */
+void batch_print_result(FILE *out, const batch_result *result);
+
+#endif
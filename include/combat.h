@@ -26,46 +26,153 @@
 #include <combat_types.h>
 #include <map.h>
 #include <entities.h>
+#include <random.h>
 
 /**
  * @brief Function that is called when an entity is killed. Used for scoring purposes
- * @param ent  The entity killed
- * @param data Custom data passed to the callback
+ * @param entities The set of entities the killed entity is in
+ * @param index    The index of the entity killed
+ * @param data     Custom data passed to the callback
  *
  * @author A104348 Humberto Gomes
  */
-typedef void (*entity_kill_callback)(const entity *ent, void *data);
+typedef void (*entity_kill_callback)(entity_set entities, size_t index, void *data);
+
+/**
+ * @struct combat_overlay_cell
+ * @brief A character drawn on top of the map during combat animations
+ *
+ * @var combat_overlay_cell::x
+ *   Horizontal position (in map coordinates)
+ * @var combat_overlay_cell::y
+ *   Vertical position (in map coordinates)
+ * @var combat_overlay_cell::chr
+ *   Character to be drawn
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	int x, y;
+	ncurses_char chr;
+} combat_overlay_cell;
+
+/**
+ * @struct combat_overlay
+ * @brief   An overlay on top of the map, for drawing combat elements like bombs and arrows.
+ * @details Only the drawn cells are stored, so that the cost of drawing and clearing the overlay
+ *          depends on the number of combat effects, not on the size of the screen.
+ *
+ * @var combat_overlay::cells
+ *   The cells drawn in this overlay, in order of drawing
+ * @var combat_overlay::length
+ *   The number of cells in ::combat_overlay::cells
+ * @var combat_overlay::capacity
+ *   The maximum number of cells that ::combat_overlay::cells can hold
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	combat_overlay_cell *cells;
+	size_t length, capacity;
+} combat_overlay;
+
+#define COMBAT_OVERLAY_STARTING_CAPACITY 16
+
+/**
+ * @brief Creates an empty ::combat_overlay
+ * @author A104348 Humberto Gomes
+ */
+combat_overlay combat_overlay_create(void);
+
+/**
+ * @brief Frees memory for a ::combat_overlay
+ * @author A104348 Humberto Gomes
+ */
+void combat_overlay_free(combat_overlay overlay);
+
+/**
+ * @brief Removes all cells from a ::combat_overlay (keeping its memory for the next frame)
+ * @author A104348 Humberto Gomes
+ */
+void combat_overlay_clear(combat_overlay *overlay);
+
+/**
+ * @brief   Draws a character on a ::combat_overlay, in map coordinates
+ * @details If the overlay can't grow, the character isn't drawn.
+ * @author  A104348 Humberto Gomes
+ */
+void combat_overlay_add(combat_overlay *overlay, int x, int y, ncurses_char chr);
 
 /**
  * @brief Based on the equiped weapon, detect whether an entity can attack another
  *
+ * @param entities
+ *   The set both entities are in
+ * @param attacker
+ *   The index of the entity that will attack the @p attacked
+ * @param attacked
+ *   The index of the entity that will be attacked by @p attacker
+ * @param map
+ *   The game map (for light and collision information)
+ *
+ * @author A104348 Humberto Gomes
+ */
+int combat_can_attack(entity_set entities, size_t attacker, size_t attacked, const map *map);
+
+/**
+ * @brief   Like ::combat_can_attack, but with the attacker in another position
+ * @details Doesn't move the attacker, so it can be called by many threads on the same set.
+ *
+ * @param entities
+ *   The set both entities are in
  * @param attacker
- *   The entity that will attack the @p attacked
+ *   The index of the entity that will attack the @p attacked
+ * @param from
+ *   Position the @p attacker would attack from
  * @param attacked
- *   The entity that will be attacked by @p attacker
+ *   The index of the entity that will be attacked by @p attacker
  * @param map
  *   The game map (for light and collision information)
  *
  * @author A104348 Humberto Gomes
  */
-int combat_can_attack(const entity *attacker, const entity *attacked, const map *map);
+int combat_can_attack_from(entity_set entities, size_t attacker, animation_step from,
+                           size_t attacked, const map *map);
 
 /**
- * @brief Set the ::entity::combat_target of the @p attacker.
+ * @brief Sets the ::entity_cold::combat_target (or ::entity_cold::melee_target) of the @p attacker.
  * @details Call ::combat_can_attack before, or this may lead to invalid attacks.
  *          Also, no damage will be dealt (that is done while updating, see
  *          ::combat_animation_update).
  *
+ * @param entities
+ *   The set both entities are in
  * @param attacker
- *   The entity that will attack the @p attacked
+ *   The index of the entity that will attack the @p attacked
  * @param attacked
- *   The entity that will be attacked by @p attacker
+ *   The index of the entity that will be attacked by @p attacker
  * @param map
  *   The game map (for light and collision information)
  *
  * @author A104348 Humberto Gomes
  */
-void combat_attack(entity *attacker, const entity *attacked, const map *map);
+void combat_attack(entity_set entities, size_t attacker, size_t attacked, const map *map);
+
+/**
+ * @brief Deals random damage to all entities in a location, based on the strength of @p w
+ *
+ * @param w        The weapon used
+ * @param entities The entities that may be in the location
+ * @param x        Horizontal position of the location
+ * @param y        Vertical position of the location
+ * @param onkill   Function that gets called when an entity is killed. Can be `NULL`.
+ * @param cb_data  Data passed to the @p onkill callback
+ * @param rng      Random number generator (for the damage dealt)
+ *
+ * @author A104348 Humberto Gomes
+ */
+void combat_deal_damage_position(weapon w, entity_set entities, int x, int y,
+                                 entity_kill_callback onkill, void *cb_data, rng *rng);
 
 /**
  * @brief Causes the consequences of the @p step_index -th step of an animation
@@ -77,6 +184,7 @@ void combat_attack(entity *attacker, const entity *attacked, const map *map);
  * @param onkill     Function that gets called when an entity is killed. Can be `NULL` for no
  *                   action.
  * @param cb_data    Data passed to the @p onkill callback
+ * @param rng        Random number generator (for the damage dealt)
  *
  * @return 1 if incrementing @p step_index would cause nothing to happen (end of combat
  *         animations), 0 otherwise.
@@ -85,7 +193,7 @@ void combat_attack(entity *attacker, const entity *attacked, const map *map);
  * @author A104082 Pedro Pereira
  */
 int combat_animation_update(entity_set all, entity_set entity_set, size_t step_index,
-                            entity_kill_callback onkill, void *cb_data);
+                            entity_kill_callback onkill, void *cb_data, rng *rng);
 
 /**
  * @brief Animates all combat actions in an entity set.
@@ -94,13 +202,12 @@ int combat_animation_update(entity_set all, entity_set entity_set, size_t step_i
  * @param entity_set The set to be animated
  * @param step_index The index of the current animation step. If some entities' combat animations
  *                   have less than this number of steps, they just won't be animated.
- * @param overlay Overlay on top of the map for animation rendering
- * @param wnd The visible map window
+ * @param overlay Overlay on top of the map for animation rendering (cells are added to it)
  *
  * @author A104348 Humberto Gomes
  */
-void combat_entity_set_animate(entity_set entity_set, size_t step_index, ncurses_char *overlay,
-                               const map_window *wnd);
+void combat_entity_set_animate(entity_set entity_set, size_t step_index,
+                               combat_overlay *overlay);
 
 #endif
 
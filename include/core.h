@@ -79,6 +79,8 @@ typedef struct {
  *   The height of the map window (map and screen dimensions are the same)
  * @var map_window::width
  *   The width of the map window (map and screen dimensions are the same)
+ * @var map_window::win
+ *   The ncurses window the map is drawn to (terminal coordinates are relative to it)
  *
  * @author A104348 Humberto Gomes
  */
@@ -86,23 +88,24 @@ typedef struct {
 	int map_top , map_left;
 	int term_top, term_left;
 	int height  , width;
+	WINDOW *win;
 } map_window;
 
 /* Define the functions if they are inline or in the core.c file (CORE_H_DEFINITIONS) */
 #if defined(CORE_H_DEFINITIONS) || !defined(__NO_INLINE__)
 
 	/**
-	 * @brief Prints an ::ncurses_char to ::stdscr
+	 * @brief Prints an ::ncurses_char to an ncurses window
  	 * @author A104348 Humberto Gomes
 	 */
-	INLINE void ncurses_char_print(ncurses_char chr) {
-		attron(chr.attr);
-		addch(chr.chr);
-		attroff(chr.attr);
+	INLINE void ncurses_char_print(WINDOW *win, ncurses_char chr) {
+		wattron(win, chr.attr);
+		waddch(win, chr.chr);
+		wattroff(win, chr.attr);
 	}
 
 #else
-	INLINE void ncurses_char_print(ncurses_char chr);
+	INLINE void ncurses_char_print(WINDOW *win, ncurses_char chr);
 #endif
 
 /**
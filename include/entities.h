@@ -23,6 +23,7 @@
 #define ENTITIES_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <combat_types.h>
 #include <animation.h>
@@ -44,88 +45,248 @@ typedef enum {
 	ENTITY_CRISTINO, /**< A mob of high difficulty */
 } entity_type;
 
+#define ENTITY_TYPE_COUNT 4 /**< @brief Number of values in ::entity_type */
+
 /**
  * @brief Gets the human-readable name of an entity type
  * @author A104348 Humberto Gomes
  */
 const char *entity_get_name(entity_type t);
 
+/** @brief Energy needed for an entity to act (see ::entity_get_speed) */
+#define ENTITY_ACTION_ENERGY 100
+
 /**
- * @struct entity
- * @brief Struct that represents a game entity.
+ * @brief   Gets the speed of an entity type
+ * @details Entities gain this much energy every turn, and act when they have
+ *          ::ENTITY_ACTION_ENERGY. Entities as fast as the player act on every turn.
  *
- * @var entity::x
- *   X coordinate of the entity on the map
- * @var entity::y
- *   Y coordinate of the entity on the map
+ * @author A104348 Humberto Gomes
+ */
+int entity_get_speed(entity_type t);
+
+/**
+ * @brief   A reference to an entity in an ::entity_set that detects when the entity is gone
+ * @details The lower ::ENTITY_HANDLE_INDEX_BITS bits are the index of the entity, and the
+ *          remaining ones are the generation of that slot when the handle was created. A slot's
+ *          generation changes when its entity dies, so old handles become stale instead of
+ *          referring to whatever is stored in that slot next. Get handles with
+ *          ::entity_set_get_handle and resolve them with ::entity_set_resolve.
  *
- * @var entity::type
- *   The type of the entity
+ * @author A104348 Humberto Gomes
+ */
+typedef uint32_t entity_handle;
+
+/** @brief Number of bits of an ::entity_handle used for the index of the entity */
+#define ENTITY_HANDLE_INDEX_BITS 20
+
+/** @brief Mask of the index in an ::entity_handle */
+#define ENTITY_HANDLE_INDEX_MASK ((UINT32_C(1) << ENTITY_HANDLE_INDEX_BITS) - 1)
+
+/** @brief Mask of a slot generation (after shifting it out of an ::entity_handle) */
+#define ENTITY_HANDLE_GENERATION_MASK (UINT32_MAX >> ENTITY_HANDLE_INDEX_BITS)
+
+/**
+ * @struct entity_cold
+ * @brief Fields of an entity that aren't needed when scanning over all entities
+ * @details The hot fields (position, health and type) are stored in separate arrays of an
+ *          ::entity_set, so that scans over many entities only read the memory they need.
  *
- * @var entity::health
- *   Entity's current health points
- * @var entity::max_health
+ * @var entity_cold::max_health
  *   Entity's maximum health
  *
- * @var entity::weapon
+ * @var entity_cold::weapon
  *   Weapon equipped by the entity
  *
- * @var entity::data
+ * @var entity_cold::data
  *   Pointer to additional data (specific to each entity type)
  *
- * @var entity::animation
+ * @var entity_cold::animation
  *   Animation sequence for an entity.
- * @var entity::combat_target
- *   - `NULL` if an entity won't perform an attack during the current turn
- *   - ::combat_bomb_info* if ::entity::weapon is ::WEAPON_BOMB
- *   - ::combat_arrow_info* if ::entity::weapon is ::WEAPON_ARROW
- *   - ::entity* (target entity) for other values of ::entity::weapon
+ * @var entity_cold::attacking
+ *   Whether the entity will perform an attack during the current turn
+ * @var entity_cold::combat_target
+ *   - ::combat_bomb_info* if ::entity_cold::weapon is ::WEAPON_BOMB
+ *   - ::combat_arrow_info* if ::entity_cold::weapon is ::WEAPON_ARROW
+ *   - `NULL` for other values of ::entity_cold::weapon, or if the entity isn't attacking
+ *   Both are allocated on the heap.
+ * @var entity_cold::melee_target
+ *   Entity attacked with a melee weapon (hand, dagger or iPad), that may die before the attack
+ *   happens. Only meaningful when ::entity_cold::attacking is set and ::entity_cold::combat_target
+ *   is `NULL`.
  *
- * @var entity::destroy
- *   Callback function to the destroy the entity (like in OOP). Must free ::entity::data, if
- *   applicable. If `NULL`, it won't be called.
+ * @var entity_cold::destroy
+ *   Callback function to the destroy the entity (like in OOP). Must free ::entity_cold::data,
+ *   if applicable. If `NULL`, it won't be called.
  *
  * @author A104100 Hélder Gomes
  * @author A104348 Humberto Gomes
  * @author A90817 Mariana Rocha
  * @author A104082 Pedro Pereira
  */
-typedef struct entity {
-	int x, y;
-	entity_type type;
-
-	int health, max_health;
+typedef struct entity_cold {
+	int max_health;
 	weapon weapon;
 
 	void *data;
 
 	animation_sequence animation;
+	int attacking;
 	void *combat_target;
+	entity_handle melee_target;
 
-	void (*destroy)(struct entity *ent);
-} entity;
+	void (*destroy)(struct entity_cold *ent);
+} entity_cold;
 
-/*
- * @brief Frees the combat target in an entity and sets it to `NULL`
+/**
+ * @struct entity
+ * @brief   Struct that represents a game entity, outside of an ::entity_set.
+ * @details Used to create entities, that are then stored with ::entity_set_spawn.
+ *
+ * @var entity::x
+ *   X coordinate of the entity on the map
+ * @var entity::y
+ *   Y coordinate of the entity on the map
+ *
+ * @var entity::type
+ *   The type of the entity
+ *
+ * @var entity::health
+ *   Entity's current health points
+ *
+ * @var entity::cold
+ *   Other fields of the entity
+ *
  * @author A104100 Hélder Gomes
  * @author A104348 Humberto Gomes
  * @author A90817 Mariana Rocha
  * @author A104082 Pedro Pereira
  */
-void entity_free_combat_target(entity *ent);
+typedef struct entity {
+	int x, y;
+	entity_type type;
+	int health;
+
+	entity_cold cold;
+} entity;
+
+/** @brief Log2 of the side (in tiles) of the square cells of an ::entity_grid */
+#define ENTITY_GRID_CELL_SHIFT 3
+
+/** @brief Marks the end of a list of slots in an ::entity_grid */
+#define ENTITY_GRID_NONE SIZE_MAX
+
+/**
+ * @struct entity_grid
+ * @brief   Spatial index of living entities, for area queries that don't look at all entities
+ * @details The map is divided in square cells of `1 << ENTITY_GRID_CELL_SHIFT` tiles, each with
+ *          a doubly linked list of the slots of the entities in it. Entities outside the map are
+ *          placed on the closest cell.
+ *
+ * @var entity_grid::head
+ *   First slot in each cell (::ENTITY_GRID_NONE if the cell is empty)
+ * @var entity_grid::next
+ *   Next slot in the same cell, for each slot
+ * @var entity_grid::prev
+ *   Previous slot in the same cell, for each slot
+ * @var entity_grid::cell
+ *   Cell of each slot in the grid (only meaningful for slots of living entities)
+ * @var entity_grid::width
+ *   Number of columns of cells
+ * @var entity_grid::height
+ *   Number of rows of cells
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	size_t *head;
+	size_t *next, *prev, *cell;
+	unsigned width, height;
+} entity_grid;
+
+/**
+ * @struct entity_set_lists
+ * @brief Lists of slots of an ::entity_set, shared by all copies and slices of the set
+ *
+ * @var entity_set_lists::live
+ *   Dense list of the slots with living entities (in no particular order, except that the first
+ *   entity to be spawned stays first)
+ * @var entity_set_lists::live_position
+ *   Position of each slot in ::entity_set_lists::live (only meaningful for listed slots)
+ * @var entity_set_lists::live_count
+ *   Number of slots in ::entity_set_lists::live
+ * @var entity_set_lists::free_slots
+ *   Stack of slots that can be used for new entities
+ * @var entity_set_lists::free_count
+ *   Number of slots in ::entity_set_lists::free_slots
+ * @var entity_set_lists::dead
+ *   Slots of entities killed since the last ::entity_set_compact (still in
+ *   ::entity_set_lists::live)
+ * @var entity_set_lists::dead_count
+ *   Number of slots in ::entity_set_lists::dead
+ * @var entity_set_lists::grid
+ *   Positions of living entities (see ::entity_set_move)
+ * @var entity_set_lists::animations
+ *   Storage for the animations of the entities (see ::entity_set_get_animation_pool)
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	size_t *live, *live_position;
+	size_t live_count;
+
+	size_t *free_slots;
+	size_t free_count;
+
+	size_t *dead;
+	size_t dead_count;
+
+	entity_grid grid;
+	animation_pool animations;
+} entity_set_lists;
 
 /**
  * @struct entity_set
  * @brief Struct that represents a set of entities in the game.
- * @details To avoid list resizing, not all entities are valid. If `entity::health <= 0`, it is
- *          invalid.
+ * @details Entities are stored as a structure of arrays: the entity in slot `i` is at `x[i]`,
+ *          `y[i]`, `health[i]`, `type[i]` and `cold[i]`. `generation[i]` is used to detect stale
+ *          handles to that slot (see ::entity_handle).
+ *
+ *          Living entities are iterated through with ::entity_set_get_live, so that the cost of
+ *          loops depends on the number of living entities, not on the capacity of the set.
+ *          Killed entities stay listed (with `health[i] <= 0`) until ::entity_set_compact is
+ *          called, so that killing entities while iterating is safe.
+ *
+ *          Entities must be moved with ::entity_set_move, to keep the spatial index used by
+ *          ::entity_set_get_in_area up to date.
  *
- *          The first entity should always be the player.
+ *          The first entity to be spawned should always be the player.
  *
- * @var entity_set::entities
- *   Pointer to the contiguous list of entities.
- * @var entity_set::count
- *   Number of entities in the set
+ * @var entity_set::x
+ *   Horizontal positions of the entities
+ * @var entity_set::y
+ *   Vertical positions of the entities
+ * @var entity_set::health
+ *   Current health points of the entities
+ * @var entity_set::type
+ *   Types of the entities
+ * @var entity_set::cold
+ *   Remaining fields of the entities
+ * @var entity_set::generation
+ *   Generation of each slot (see ::entity_handle)
+ * @var entity_set::capacity
+ *   Number of slots in the set
+ * @var entity_set::lists
+ *   Which slots are in use (see ::entity_set_lists)
+ * @var entity_set::first
+ *   First position in ::entity_set_lists::live covered by this set (see ::entity_set_slice)
+ * @var entity_set::max
+ *   Maximum number of living entities covered by this set (see ::entity_set_slice)
+ * @var entity_set::indices
+ *   If not `NULL`, list of slots covered by this set, instead of ::entity_set_lists::live (see
+ *   ::entity_set_view)
+ * @var entity_set::index_count
+ *   Number of slots in ::entity_set::indices
  *
  * @author A104100 Hélder Gomes
  * @author A104348 Humberto Gomes
@@ -133,21 +294,36 @@ void entity_free_combat_target(entity *ent);
  * @author A104082 Pedro Pereira
  */
 typedef struct entity_set {
-	entity *entities;
-	size_t count;
+	int *x, *y, *health;
+	entity_type *type;
+	entity_cold *cold;
+	uint16_t *generation;
+	size_t capacity;
+
+	entity_set_lists *lists;
+	size_t first, max;
+
+	const size_t *indices;
+	size_t index_count;
 } entity_set;
 
 /**
- * @brief Allocates an ::entity_set with @p count entities. Those will be **unitialized**.
+ * @brief Allocates an empty ::entity_set with space for @p capacity entities
+ *
+ * @param capacity Maximum number of entities in the set
+ * @param width    Width of the map the entities will be on (for the spatial index)
+ * @param height   Height of the map the entities will be on
+ *
  * @author A104100 Hélder Gomes
  * @author A104348 Humberto Gomes
  * @author A90817 Mariana Rocha
  * @author A104082 Pedro Pereira
  */
-entity_set entity_set_allocate(size_t count);
+entity_set entity_set_allocate(size_t capacity, unsigned width, unsigned height);
 
 /**
  * @brief Frees memory in an ::entity_set.
+ * @details Must not be called on sets returned by ::entity_set_slice.
  *
  * @author A104100 Hélder Gomes
  * @author A104348 Humberto Gomes
@@ -157,18 +333,196 @@ entity_set entity_set_allocate(size_t count);
 void entity_set_free(entity_set entities);
 
 /**
- * @brief Gets the entities closest another entity
- * @details The distance criterion is the Manhattan distance
+ * @brief   Stores a new entity in a free slot of an ::entity_set
+ * @details Slots are handed out in increasing order, and then reused after being freed by
+ *          ::entity_set_compact.
+ * @returns The slot of the entity, or `entities.capacity` if the set is full
+ *
+ * @author A104348 Humberto Gomes
+ */
+size_t entity_set_spawn(entity_set entities, entity ent);
+
+/**
+ * @brief Changes the position of the entity in slot @p index
+ * @author A104348 Humberto Gomes
+ */
+void entity_set_move(entity_set entities, size_t index, int x, int y);
+
+/**
+ * @brief   Gets the ::animation_pool of the animations of the entities in a set
+ * @details It's shared by all copies and slices of the set, and freed by ::entity_set_free, so
+ *          it must only be used by the thread that owns the set.
+ *
+ * @author A104348 Humberto Gomes
+ */
+animation_pool *entity_set_get_animation_pool(entity_set entities);
+
+/**
+ * @brief Cancels the attack of the entity in slot @p index, freeing its combat target
+ * @author A104100 Hélder Gomes
+ * @author A104348 Humberto Gomes
+ * @author A90817 Mariana Rocha
+ * @author A104082 Pedro Pereira
+ */
+void entity_free_combat_target(entity_set entities, size_t index);
+
+/**
+ * @brief Gets an ::entity_handle to the entity with index @p index
+ * @author A104348 Humberto Gomes
+ */
+entity_handle entity_set_get_handle(entity_set entities, size_t index);
+
+/**
+ * @brief Gets the index of the entity referred to by an ::entity_handle
+ *
+ * @param entities The set @p handle was created from (or a slice of it)
+ * @param handle   The handle to be resolved
+ * @param index    Where to write the index of the entity (only written on success)
+ *
+ * @return 1 on success, 0 if the handle is stale (the entity has died) or invalid
+ *
+ * @author A104348 Humberto Gomes
+ */
+int entity_set_resolve(entity_set entities, entity_handle handle, size_t *index);
+
+/**
+ * @brief   Marks the end of an entity's life, making all handles to it stale
+ * @details Frees the cold data of the entity, but doesn't change its health (that must be set to
+ *          `<= 0` by the caller). The slot is only reused after ::entity_set_compact.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void entity_set_kill(entity_set entities, size_t index);
+
+/**
+ * @brief   Removes killed entities from the list of living ones, freeing their slots
+ * @details O(1) for each entity killed (swap-remove). The first living entity (the player) is
+ *          never moved nor removed. Must not be called while iterating through the set.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void entity_set_compact(entity_set entities);
+
+/**
+ * @brief   Gets a set of (at most) @p count living entities of @p entities, starting at position
+ *          @p start of its list of living entities
+ * @details The returned ::entity_set shares its memory with @p entities, so it must **not** be
+ *          freed. Indices and handles are the same in both sets.
+ *
+ * @author A104348 Humberto Gomes
+ */
+entity_set entity_set_slice(entity_set entities, size_t start, size_t count);
+
+/**
+ * @brief   Gets a set of the entities in some slots of @p entities
+ * @details Like ::entity_set_slice, but for any list of entities (e.g.: the ones on lit tiles).
+ *          Spatial queries (::entity_set_find_at, ::entity_set_get_in_area, ...) must not be done
+ *          on views.
+ *
+ * @param entities The set of all entities
+ * @param indices  Slots of the entities in the view. Must be valid while the view is used.
+ * @param count    Number of slots in @p indices
+ *
+ * @author A104348 Humberto Gomes
+ */
+entity_set entity_set_view(entity_set entities, const size_t *indices, size_t count);
+
+/**
+ * @brief Gets the indices of the living entities of a set
+ *
+ * @param entities The set of entities
+ * @param count    Where to write the number of indices
+ *
+ * @return The list of indices. Entities killed since the last ::entity_set_compact may be in it.
+ *
+ * @author A104348 Humberto Gomes
+ */
+const size_t *entity_set_get_live(entity_set entities, size_t *count);
+
+/**
+ * @brief Finds the first living entity in a position
+ *
+ * @param entities The set of entities
+ * @param start    Position in the list of living entities (see ::entity_set_get_live) to start
+ *                 searching from
+ * @param x        Horizontal position
+ * @param y        Vertical position
+ *
+ * @returns The position of the entity in the list of living entities, or the length of that list
+ *          if there's none
+ *
+ * @author A104348 Humberto Gomes
+ */
+size_t entity_set_find_at(entity_set entities, size_t start, int x, int y);
+
+/**
+ * @brief   Finds all living entities in a rectangular area, in no particular order
+ * @details Like ::entity_set_get_in_area, but linear on the number of entities found.
+ * @author  A104348 Humberto Gomes
+ */
+size_t entity_set_get_in_area_unordered(entity_set entities, int x0, int y0, int x1, int y1,
+                                        size_t *out);
+
+/**
+ * @brief   Finds all living entities in a rectangular area
+ * @details Only the cells of the spatial index that overlap the area are looked through, so the
+ *          cost depends on the number of entities around the area, not on the size of the set.
+ *
+ * @param entities The entities to look through
+ * @param x0       Leftmost column of the area
+ * @param y0       Topmost row of the area
+ * @param x1       Rightmost column of the area (inclusive)
+ * @param y1       Bottom row of the area (inclusive)
+ * @param out      Where to write the indices of the entities found. Must have space for all living
+ *                 entities.
+ *
+ * @return The number of entities written to @p out, that are in the same order as in the list of
+ *         living entities (see ::entity_set_get_live)
+ *
+ * @author A104348 Humberto Gomes
+ */
+size_t entity_set_get_in_area(entity_set entities, int x0, int y0, int x1, int y1, size_t *out);
+
+/**
+ * @brief Finds all living entities on lit tiles of a map
+ *
+ * @param entities The entities to look through
+ * @param map      The map, for light information
+ * @param x        Horizontal position of the center of the lit area
+ * @param y        Vertical position of the center of the lit area
+ * @param radius   No tiles farther than this (in each axis) from the center may be lit
+ * @param out      Where to write the indices of the entities found. Must have space for all living
+ *                 entities.
+ *
+ * @return The number of entities written to @p out (ordered like in ::entity_set_get_in_area)
+ *
+ * @author A104348 Humberto Gomes
+ */
+size_t entity_set_get_lit(entity_set entities, const map *map, int x, int y, int radius,
+                          size_t *out);
+
+/**
+ * @brief Gets the entities closest a position
+ * @details The distance criterion is the Manhattan distance. No memory is allocated.
  *
- * @param ent The reference entity (e.g.: for the sidebar, get entities close to the player)
- * @param in  The set of all entities in the map
- * @param map If not `NULL`, only visible entities will be added to @p out
+ * @param x               Horizontal reference position (e.g.: for the sidebar, the player's
+ *                        position)
+ * @param y               Vertical reference position
+ * @param in              The set of all entities in the map
+ * @param candidates      Indices of the entities to choose from (e.g.: the entities on lit
+ *                        tiles). Killed entities are skipped.
+ * @param candidate_count Number of indices in @p candidates
+ * @param max_count       The maximum number of entities to be found
+ * @param out             Where to write handles to the entities found (in @p in), ordered by
+ *                        distance to the reference position. Must have space for @p max_count
+ *                        handles.
  *
- * @return A set with **a maximum of** @p max_count entities ordered by distance to @p ent.
+ * @return The number of entities written to @p out (**a maximum of** @p max_count).
  *
  * @author A104348 Humberto Gomes
  */
-entity_set entity_get_closeby(entity ent, entity_set in, size_t max_count, const map *map);
+size_t entity_get_closeby(int x, int y, entity_set in, const size_t *candidates,
+                          size_t candidate_count, size_t max_count, entity_handle *out);
 
 /**
  * @brief Renders a set of entities on the terminal, within some specified bounds.
@@ -23,6 +23,7 @@
 #define CRISTINO_H
 
 #include <entities.h>
+#include <random.h>
 
 /**
  * @brief   Creates a new entity type of type ENTITY_CRISTINO.
@@ -30,13 +31,14 @@
  * @param x The x coordinate of the entity on the map
  * @param y The y coordinate of the entity on the map
  * @param health The entity health points
+ * @param rng Random number generator (for choosing the weapon)
  * @return The newly created entity
  *
  * @author A90817 Mariana Rocha
  * @author A104082 Pedro Pereira
  * @author A104100 Hélder Gomes
  */
-entity entity_create_cristino(unsigned x, unsigned y, int health);
+entity entity_create_cristino(unsigned x, unsigned y, int health, rng *rng);
 
 #endif
 
@@ -23,6 +23,7 @@
 #define GOBLIN_H
 
 #include <entities.h>
+#include <random.h>
 
 /**
  * @brief   Creates a new entity type of type ENTITY_GOBLIN.
@@ -32,6 +33,7 @@
  * @param x The x coordinate of the entity on the map
  * @param y The y coordinate of the entity on the map
  * @param health The entity health points
+ * @param rng Random number generator (for choosing the weapon)
  * @return The newly created entity
  *
  * @author A90817 Mariana Rocha
@@ -39,7 +41,7 @@
  * @author A104100 Hélder Gomes
  * @author A104086 Pedro Pereira
  */
-entity entity_create_goblin(unsigned x, unsigned y, int health);
+entity entity_create_goblin(unsigned x, unsigned y, int health, rng *rng);
 
 #endif
 
@@ -26,6 +26,8 @@
 #include <animation.h>
 #include <map.h>
 #include <entities.h>
+#include <arena.h>
+#include <stdint.h>
 
 /**
  * @struct node
@@ -62,7 +64,7 @@ int is_valid_position(map *map, entity_type ent, unsigned x, unsigned y);
  *        node.
  *
  * @param end_node The final node in the path.
- * @return An animation sequence containing all positions.
+ * @return An animation sequence containing all positions (on the heap).
  *
  * @author A90817 Mariana Rocha
 */
@@ -70,29 +72,105 @@ animation_sequence calculate_path(node *end_node);
 
 /**
  * @brief Finds the nearest empty tile to the given position.
+ * @details Only tiles up to the distance of the nearest empty tile are looked at. Ties are broken
+ *          in favor of the topmost tile, and then of the leftmost one.
  *
  * @param map Pointer to the map struct.
  * @param pos The position to start searching from.
  * @return The nearest empty tile, or the same position if no empty tile was found.
  *
  * @author A90817 Mariana Rocha
+ * @author A104348 Humberto Gomes
 */
 animation_step find_nearest_empty_tile(map *map, animation_step pos);
 
+/**
+ * @struct path_search
+ * @brief   Breadth-first search from a position, kept between turns to be resumed
+ * @details The tree of the search only depends on where it starts, on the entity and on the map,
+ *          not on the destination. So, while a mob stays in place, later searches for any
+ *          destination reuse it: destinations already reached only need their path to be
+ *          followed back, and others continue the search from where it stopped. Moving the mob
+ *          starts a new search. Paths are the same as the ones of ::search_path.
+ *
+ * @var path_search::cells
+ *   Queue of the search: position (in a window around ::path_search::start) of each node
+ * @var path_search::parents
+ *   Position in the queue of the parent of each node
+ * @var path_search::order
+ *   Position in the queue of each cell of the window (`UINT16_MAX` if not reached yet)
+ * @var path_search::start
+ *   Where the search starts
+ * @var path_search::ent
+ *   Entity the search is for (see ::is_valid_position)
+ * @var path_search::tiles
+ *   Tiles of the map of the search (`NULL` before the first search)
+ * @var path_search::front
+ *   Next node in the queue to be expanded
+ * @var path_search::back
+ *   Number of nodes in the queue
+ * @var path_search::first_far
+ *   First node in the queue too far away from the start to be expanded (`UINT16_MAX` if none)
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint16_t *cells, *parents, *order;
+	animation_step start;
+	entity_type ent;
+	const tile *tiles;
+	uint16_t front, back, first_far;
+} path_search;
+
+/**
+ * @brief Creates a ::path_search
+ * @details This doesn't allocate any memory (that only happens on the first search).
+ *
+ * @author A104348 Humberto Gomes
+ */
+path_search path_search_create(void);
+
+/**
+ * @brief Frees memory allocated by a ::path_search, leaving it like a new one
+ * @author A104348 Humberto Gomes
+ */
+void path_search_free(path_search *search);
+
+/**
+ * @brief Finds a path like ::search_path, reusing (and then keeping) the state of @p search
+ *
+ * @param search The search. Must always be used with the same map.
+ * @param map    Map to find the path in
+ * @param ent    The entity whose path is being found
+ * @param start  Starting position of the path
+ * @param end    Ending position of the path
+ *
+ * @return The same path as ::search_path (on the heap). An empty path on allocation failure.
+ *
+ * @author A104348 Humberto Gomes
+ */
+animation_sequence path_search_find(path_search *search, map *map, entity_type ent,
+                                    animation_step start, animation_step end);
+
 /**
  * @brief Implements the Breadth-first search algorithm to find the shortest path between two
  * positions on the map.
+ * @details Nothing is kept between calls. See ::path_search to reuse searches.
  *
  * @param map A pointer to the map containing the dimensions and additional data.
  * @param ent The entity whose path is being found.
  * @param start The starting position of the path.
  * @param end The ending position of the path.
+ * @param scratch Arena for temporary data (left as it was found).
  * @return An animation sequence representing the path. If no path is found or an error occurs,
- * an empty animation sequence is returned.
+ * an empty animation sequence is returned. It's allocated on the heap (no ::animation_pool), as
+ * paths are found on multiple threads.
  *
  * @author A90817 Mariana Rocha
+ * @author A104348 Humberto Gomes
 */
-animation_sequence search_path(map *map, entity_type ent, animation_step start, animation_step end);
+animation_sequence search_path(map *map, entity_type ent, animation_step start, animation_step end,
+                               arena *scratch);
 
 #endif
 
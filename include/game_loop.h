@@ -22,6 +22,11 @@
 #ifndef GAME_LOOP_H
 #define GAME_LOOP_H
 
+#include <stdint.h>
+#include <ansi_term.h>
+#include <render_thread.h>
+#include <input_record.h>
+
 /**
  * @brief The return value of game loop callback functions. Indicates whether or to continue the
  *        game loop.
@@ -104,19 +109,118 @@ typedef struct {
 	game_loop_resize_callback onresize;
 } game_loop_callbacks;
 
+/**
+ * @brief How the game is output to the terminal
+ * @author A104348 Humberto Gomes
+ */
+typedef enum {
+	GAME_LOOP_BACKEND_NCURSES, /**< ncurses' own screen optimization and output */
+	GAME_LOOP_BACKEND_ANSI,    /**< ANSI escape sequences written directly (see ::ansi_term) */
+
+	/** Like ::GAME_LOOP_BACKEND_ANSI, but output on a separate thread (see ::render_thread) */
+	GAME_LOOP_BACKEND_ANSI_THREADED,
+} game_loop_backend;
+
 /**
  * @brief Intialize ncurses
  * @returns 0 on success, 1 on failure
  *
+ * @param backend How the screen is output to the terminal. Input is always read with ncurses.
+ *
  * More technically, this function performs the following actions:
  *
  * 1. Initialize ncurses and set the terminal mode;
  * 2. Configure the program to ignore `SIGINT`, `SIGSTOP` and `SIGTERM`;
- * 3. Create 8 color pairs (indices 1 to 8) for every ncurses `COLOR_*`.
+ * 3. Create 8 color pairs (indices 1 to 8) for every ncurses `COLOR_*`;
+ * 4. Create the ::ansi_term, for ::GAME_LOOP_BACKEND_ANSI and
+ *    ::GAME_LOOP_BACKEND_ANSI_THREADED (along with the ::render_thread for the latter).
+ *
+ * @author A104348 Humberto Gomes
+ */
+int game_loop_init_ncurses(game_loop_backend backend);
+
+/**
+ * @brief   Outputs the contents of `stdscr` to the terminal.
+ * @details Must be used by render callbacks instead of ncurses' `refresh()`, so that the chosen
+ *          ::game_loop_backend is respected.
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int game_loop_refresh(void);
+
+/**
+ * @brief   Outputs the virtual screen (`newscr`) to the terminal.
+ * @details Must be used instead of ncurses' `doupdate()`, after `wnoutrefresh()` is called for
+ *          every window that needs to be output.
+ * @returns 0 on success, 1 on failure
  *
  * @author A104348 Humberto Gomes
  */
-int game_loop_init_ncurses(void);
+int game_loop_doupdate(void);
+
+/**
+ * @brief   Gets the output statistics of the ANSI backend
+ * @details Only available after ::game_loop_terminate_ncurses, when the render thread (if any)
+ *          has already stopped.
+ * @returns 0 on success, 1 if the ANSI backend wasn't used
+ *
+ * @author A104348 Humberto Gomes
+ */
+int game_loop_ansi_stats(ansi_term_stats *out);
+
+/**
+ * @brief   Gets the statistics of the render thread
+ * @details Only available after ::game_loop_terminate_ncurses.
+ * @returns 0 on success, 1 if ::GAME_LOOP_BACKEND_ANSI_THREADED wasn't used
+ *
+ * @author A104348 Humberto Gomes
+ */
+int game_loop_render_thread_stats(render_thread_stats *out);
+
+/**
+ * @struct game_loop_frame_stats
+ * @brief Timing statistics of the frames run by ::game_loop_run
+ *
+ * @var game_loop_frame_stats::frames
+ *   Number of frames run
+ * @var game_loop_frame_stats::total_time
+ *   Time (in seconds) spent on frames, excluding the sleep to keep the frame rate
+ * @var game_loop_frame_stats::worst_time
+ *   Longest time (in seconds) spent on a single frame, excluding sleep
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint64_t frames;
+	double total_time, worst_time;
+} game_loop_frame_stats;
+
+/**
+ * @brief   Records all keys read by the game loop from now on
+ * @details The game loop starts using a fixed timestep (`1 / fps` of @p rec), so that replays are
+ *          deterministic. @p rec must remain open while the game loop runs.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void game_loop_record_input(input_record *rec);
+
+/**
+ * @brief   Replays the keys in a recording, instead of reading input from the terminal
+ * @details The game loop starts using the same fixed timestep as the recorded session, and each
+ *          key is fed to the input callback in the same frame it was recorded in, independently of
+ *          the frame rate. The game loop exits after the last key is replayed. @p rec must remain
+ *          open while the game loop runs.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void game_loop_replay_input(input_record *rec);
+
+/**
+ * @brief Gets the timing statistics of the frames run so far
+ * @author A104348 Humberto Gomes
+ */
+game_loop_frame_stats game_loop_get_frame_stats(void);
 
 /**
  * @brief Run the game loop with a set of callback function
@@ -23,6 +23,7 @@
 #define ILLUMINATION_H
 
 #include <map.h>
+#include <stdint.h>
 
 #define CIRCLE_RADIUS 15
 
@@ -53,4 +54,30 @@ void state_main_game_circle_light_map(map m, int x, int y, int r);
  */
 void state_main_game_circle_clean_light_map(map m, int x, int y, int r);
 
+/** @brief Number of bytes of a light mask (see ::state_main_game_circle_light_mask) */
+#define LIGHT_MASK_BYTES(r) (((2 * (r) + 1) * (2 * (r) + 1) + 7) / 8)
+
+/**
+ * @brief   Calculates the tiles that the player would see from a position, without lighting them
+ * @details Like ::state_main_game_circle_light_map, but the result is written to a bit mask of
+ *          the square around the position, to be applied later with
+ *          ::state_main_game_circle_apply_light_mask.
+ *
+ * @param m    The map containing the dimensions and obstacles.
+ * @param x    The X coordinate of the player.
+ * @param y    The Y coordinate of the player.
+ * @param r    The radius of the vision circle
+ * @param mask Where to write the mask (::LIGHT_MASK_BYTES bytes)
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_circle_light_mask(map m, int x, int y, int r, uint8_t *mask);
+
+/**
+ * @brief Lights a map with a mask from ::state_main_game_circle_light_mask (same result as
+ *        ::state_main_game_circle_light_map)
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_circle_apply_light_mask(map m, int x, int y, int r, const uint8_t *mask);
+
 #endif
@@ -0,0 +1,102 @@
+/**
+ * @file light_cache.h
+ * @brief Light of the player's planned path, calculated before the player moves
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef LIGHT_CACHE_H
+#define LIGHT_CACHE_H
+
+#include <animation.h>
+#include <map.h>
+#include <stdint.h>
+
+/**
+ * @struct light_cache
+ * @brief   Light masks (see ::state_main_game_circle_light_mask) of the steps of a path
+ * @details Filled in while the game waits for input (::light_cache_warm), and used while the path
+ *          is walked (::light_cache_apply). Entries are keyed by the position they were calculated
+ *          for, so changing the path only makes the entries of the changed steps useless.
+ *
+ * @var light_cache::x
+ *   Horizontal position of each entry
+ * @var light_cache::y
+ *   Vertical position of each entry
+ * @var light_cache::masks
+ *   Light mask of each entry (::LIGHT_MASK_BYTES bytes each)
+ * @var light_cache::count
+ *   Number of entries (entry `i` is for step `i` of the path)
+ * @var light_cache::capacity
+ *   Number of entries that fit in the cache before it needs to grow
+ * @var light_cache::radius
+ *   Radius of the light
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	int *x, *y;
+	uint8_t *masks;
+	size_t count, capacity;
+	int radius;
+} light_cache;
+
+/**
+ * @brief Creates an empty ::light_cache
+ * @param radius Radius of the light (e.g.: ::CIRCLE_RADIUS)
+ *
+ * @author A104348 Humberto Gomes
+ */
+light_cache light_cache_create(int radius);
+
+/**
+ * @brief Frees memory allocated by a ::light_cache
+ * @author A104348 Humberto Gomes
+ */
+void light_cache_free(light_cache cache);
+
+/**
+ * @brief Calculates the light of (some) steps of a path that aren't in the cache yet
+ *
+ * @param cache     The cache
+ * @param m         The map the path is on (only read)
+ * @param path      The path
+ * @param max_steps Maximum number of steps to calculate the light for (to limit the time spent)
+ *
+ * @return 1 if all steps of the path are now in the cache, 0 otherwise
+ *
+ * @author A104348 Humberto Gomes
+ */
+int light_cache_warm(light_cache *cache, map m, animation_sequence *path, size_t max_steps);
+
+/**
+ * @brief   Lights the map around a step of a path, if it's in the cache
+ * @details The result is the same as ::state_main_game_circle_light_map.
+ *
+ * @param cache The cache
+ * @param m     The map to light
+ * @param step  Index of the step in the path
+ * @param x     Horizontal position of the step
+ * @param y     Vertical position of the step
+ *
+ * @return 1 on success, 0 if the step isn't in the cache (and the map wasn't lit)
+ *
+ * @author A104348 Humberto Gomes
+ */
+int light_cache_apply(const light_cache *cache, map m, size_t step, int x, int y);
+
+#endif
@@ -23,10 +23,17 @@
 #define MAIN_GAME_H
 
 #include <game_states/main_game_renderer.h>
+#include <game_states/light_cache.h>
+#include <game_states/mob_lod.h>
+#include <game_states/mob_wake.h>
 #include <game_state.h>
 #include <map.h>
 #include <score.h>
 #include <entities.h>
+#include <entities_search.h>
+#include <combat.h>
+#include <random.h>
+#include <arena.h>
 
 /**
  * @brief Type of action during the game
@@ -41,6 +48,51 @@ typedef enum {
 	MAIN_GAME_ANIMATING_MOBS_COMBAT,    /**< Animating attacks of mobs */
 } state_main_game_action;
 
+/**
+ * @brief   Parts of the screen that need to be redrawn (bit flags)
+ * @details See ::state_main_game_data::needs_rerender.
+ * @author  A104348 Humberto Gomes
+ */
+typedef enum {
+	MAIN_GAME_REDRAW_SIDEBAR = 1 << 0, /**< Score, weapon and health bars */
+	MAIN_GAME_REDRAW_STATS   = 1 << 1, /**< FPS and number of renders (bottom of the sidebar) */
+	MAIN_GAME_REDRAW_MAP     = 1 << 2, /**< Map, entities, player path, overlay and cursor */
+	MAIN_GAME_REDRAW_TIPS    = 1 << 3, /**< Tips on how to play */
+	MAIN_GAME_REDRAW_LAYOUT  = 1 << 4, /**< Window (re)creation and static sidebar elements */
+	MAIN_GAME_REDRAW_ALL     = (1 << 5) - 1 /**< Everything (e.g.: after a message box) */
+} state_main_game_redraw;
+
+/**
+ * @struct state_main_game_windows
+ * @brief  ncurses windows the screen is divided in during the game
+ *
+ * @var state_main_game_windows::sidebar
+ *   Sidebar on the left of the screen (includes the vertical separation line)
+ * @var state_main_game_windows::map
+ *   Map viewport, on the right of the sidebar
+ * @var state_main_game_windows::tips
+ *   One window for each line of tips, on top of the map and only as wide as its text. `NULL` when
+ *   there's no text to show.
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	WINDOW *sidebar, *map, *tips[2];
+} state_main_game_windows;
+
+/**
+ * @brief   Deletes the ncurses windows of the game (if they were created)
+ * @details Implemented in `main_game_renderer.c`.
+ * @author  A104348 Humberto Gomes
+ */
+void state_main_game_free_windows(state_main_game_windows *windows);
+
+/**
+ * @brief AI of the visible mobs, planned in the background (defined in `mob_action.c`)
+ * @author A104348 Humberto Gomes
+ */
+typedef struct mob_ai_job mob_ai_job;
+
 /**
  * @struct state_main_game_data
  * @brief Data for the main game state
@@ -60,9 +112,13 @@ typedef enum {
  *   If the game should be exited of (after a message box prompt)
  *
  * @var state_main_game_data::needs_rerender
- *   If an update happened (e.g.: user input, window resize) requiring the game to be rendered
+ *   Parts of the screen that need to be rendered due to an update (e.g.: user input, window
+ *   resize). A combination of ::state_main_game_redraw flags.
+ * @var state_main_game_data::windows
+ *   Windows the screen is divided in (created when first rendered)
  * @var state_main_game_data::overlay
- *   Overlay on the top of the map (for drawing combat elements like bombs and arrows).
+ *   Overlay on the top of the map (for drawing combat elements like bombs and arrows). Cleared
+ *   every frame.
  *
  * @var state_main_game_data::action
  *   What is currently happening in the game (see ::state_main_game_action)
@@ -71,10 +127,50 @@ typedef enum {
  * @var state_main_game_data::time_since_last_animation
  *   The time (in seconds) since the last animation step
  *
+ * @var state_main_game_data::closeby
+ *   Cache of handles to the entities (in ::state_main_game_data::entities) whose health bars
+ *   are shown on the sidebar
+ * @var state_main_game_data::closeby_count
+ *   Number of entities in ::state_main_game_data::closeby
+ * @var state_main_game_data::closeby_capacity
+ *   Maximum number of entities in ::state_main_game_data::closeby (depends on the terminal's
+ *   height)
+ * @var state_main_game_data::closeby_valid
+ *   Whether ::state_main_game_data::closeby is up to date. Must be set to 0 when entities move,
+ *   die or when the light map changes.
+ *
  * @var state_main_game_data::map
  *   The game map
  * @var state_main_game_data::entities
  *   Entities in the map
+ * @var state_main_game_data::lit
+ *   Indices of the entities on lit tiles (the player included), in the order of the list of
+ *   living entities. Updated by ::state_main_game_light, so it may contain entities killed since
+ *   then. Mob AI, the sidebar and attacks only look at these entities.
+ * @var state_main_game_data::lit_count
+ *   Number of entities in ::state_main_game_data::lit
+ * @var state_main_game_data::acting
+ *   Indices of the mobs that move or attack in the current turn (set by
+ *   ::state_main_game_mobs_start_ai), the only ones animated
+ * @var state_main_game_data::acting_count
+ *   Number of mobs in ::state_main_game_data::acting
+ * @var state_main_game_data::ai
+ *   Plans of the visible mobs, made while the player's attack is animated (see
+ *   ::state_main_game_mobs_start_ai)
+ * @var state_main_game_data::paths
+ *   Path finding state of the mob in each slot of ::state_main_game_data::entities, kept between
+ *   turns so that mobs that don't move don't search again (`NULL` if it couldn't be allocated)
+ * @var state_main_game_data::lod
+ *   Coarse version of ::state_main_game_data::map, for moving mobs far from the player (see
+ *   ::state_main_game_mobs_run_lod)
+ * @var state_main_game_data::path_light
+ *   Light of each step of the player's planned path, calculated while waiting for input, so
+ *   that walking the path doesn't need to calculate it
+ * @var state_main_game_data::wake
+ *   Mobs woken up by the light, combat or deaths around them, scheduled to act when they have
+ *   enough energy. Mobs that aren't awake don't move.
+ * @var state_main_game_data::turn
+ *   Number of turns played
  *
  * @var state_main_game_data::score
  *   Player's score (increases by killing entities)
@@ -82,6 +178,14 @@ typedef enum {
  *   A weapon dropped by a mob. Will be ::WEAPON_INVALID if no drop happened.
  * @var state_main_game_data::dropped_food
  *   If the last mob killed dropped food
+ * @var state_main_game_data::kills
+ *   Number of entities of each ::entity_type killed during the game (by anyone)
+ *
+ * @var state_main_game_data::rng
+ *   Random number generator of this game (for map generation, combat, mob AI, ...)
+ * @var state_main_game_data::scratch
+ *   Arena for temporary data (e.g.: path finding), reset whenever the action changes (see
+ *   ::state_main_game_set_action)
  *
  * @var state_main_game_data::cursorx
  *   Horizontal position (on the map) of the cursor (to choose mob to attack)
@@ -100,31 +204,116 @@ typedef struct {
 	int must_leave;
 
 	int needs_rerender;
-	ncurses_char *overlay;
+	state_main_game_windows windows;
+	combat_overlay overlay;
 
 	state_main_game_action action;
 	size_t animation_step;
 	double time_since_last_animation;
 
+	entity_handle *closeby;
+	size_t closeby_count, closeby_capacity;
+	int closeby_valid;
+
 	map map;
 	entity_set entities;
+	size_t *lit;
+	size_t lit_count;
+	size_t *acting;
+	size_t acting_count;
+	mob_ai_job *ai;
+	path_search *paths;
+	mob_lod_grid lod;
+	light_cache path_light;
+	mob_wake_set wake;
+	unsigned int turn;
 
 	player_score score;
 	weapon dropped;
 	int dropped_food;
+	unsigned int kills[ENTITY_TYPE_COUNT];
+
+	rng rng;
+	arena scratch;
 
 	int cursorx, cursory;
 } state_main_game_data;
 
-/** @brief Returns the player (first entity) of a ::state_main_game_data pointer */
-#define PLAYER(state) ((state)->entities.entities[0])
+/** @brief Index of the player in ::state_main_game_data::entities (the first entity) */
+#define PLAYER_INDEX 0
+
+/** @brief Horizontal position of the player of a ::state_main_game_data pointer */
+#define PLAYER_X(state) ((state)->entities.x[PLAYER_INDEX])
+
+/** @brief Vertical position of the player of a ::state_main_game_data pointer */
+#define PLAYER_Y(state) ((state)->entities.y[PLAYER_INDEX])
+
+/** @brief Health of the player of a ::state_main_game_data pointer */
+#define PLAYER_HEALTH(state) ((state)->entities.health[PLAYER_INDEX])
+
+/** @brief Cold data (::entity_cold) of the player of a ::state_main_game_data pointer */
+#define PLAYER_COLD(state) ((state)->entities.cold[PLAYER_INDEX])
 
 /**
  * @brief Creates a state for the main game
+ *
+ * @param name Name of the player (for the leaderboard)
+ * @param seed Seed for the random generation of the map (e.g.: `time(NULL)`)
+ *
  * @author A104348 Humberto Gomes
  * @author A104100 Hélder Gomes
  */
-game_state state_main_game_create(char name[SCORE_NAME_MAX + 1]);
+game_state state_main_game_create(char name[SCORE_NAME_MAX + 1], unsigned int seed);
+
+/**
+ * @brief   Makes the maps of the following games be generated from fixed seeds
+ * @details The next game will use @p seed, the one after it `seed + 1`, and so on. Needed for
+ *          deterministic input replays. Without calling this function, seeds are time-based.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_set_seed(unsigned int seed);
+
+/**
+ * @brief Gets the seed for a new game (see ::state_main_game_set_seed)
+ * @author A104348 Humberto Gomes
+ */
+unsigned int state_main_game_next_seed(void);
+
+/**
+ * @brief Gets the human-readable name of a ::state_main_game_action
+ * @author A104348 Humberto Gomes
+ */
+const char *state_main_game_action_get_name(state_main_game_action action);
+
+/**
+ * @brief   Changes the current action of the game (::state_main_game_data::action)
+ * @details Always use this function (instead of assigning the action directly), so that every
+ *          action shows up in traces (see `trace.h`).
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_set_action(state_main_game_data *state, state_main_game_action action);
+
+/**
+ * @brief   Lights the area around the player
+ * @details Also updates the list of entities on lit tiles (::state_main_game_data::lit), which
+ *          costs as much as the number of entities around the player, and invalidates the list of
+ *          health bars on the sidebar. The light must have been removed from the previous
+ *          position of the player (::state_main_game_circle_clean_light_map).
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_light(state_main_game_data *state);
+
+/**
+ * @brief   Like ::state_main_game_light, but without changing the light
+ * @details For when the player hasn't moved. The map isn't written to, so this can be done while
+ *          mob AI is planned in the background (see ::state_main_game_mobs_start_ai).
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_update_lit(state_main_game_data *state);
 
 /**
  * @brief Destroys a state for the main game (frees `state->data`)
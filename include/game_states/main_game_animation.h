@@ -26,13 +26,25 @@
 #include <game_states/main_game.h>
 
 /**
- * @brief Choose what entities need to be animated (only the player or all but the player)
- * @details The returned ::entity_set must **not** be freed, as it's defined in relation to @p all
- *          (like a string view, for example).
+ * @brief Choose what entities need to be animated (only the player or the mobs acting this turn)
+ * @details The returned ::entity_set must **not** be freed, as it's defined in relation to
+ *          `state->entities` (like a string view, for example).
  *
  * @author A104348 Humberto Gomes
  */
-entity_set state_main_game_entities_to_animate(entity_set all, state_main_game_action act);
+entity_set state_main_game_entities_to_animate(const state_main_game_data *state);
+
+/**
+ * @brief   Advances the animation of the current action by one step, without any timing
+ * @details When the animation ends, the game moves to the next action. The light map isn't
+ *          updated, nor is the screen.
+ *
+ * @param state The game state (full game state is needed for the entity kill callback)
+ * @returns 1 if the animation of the current action ended, 0 otherwise
+ *
+ * @author A104348 Humberto Gomes
+ */
+int state_main_game_animation_advance(game_state *state);
 
 /**
  * @brief Does everything animation related for the main game
@@ -29,7 +29,9 @@
 /**
  * @brief   Renders the game on the screen, with an adjustable layout.
  * @details Rendering is only done when it needs to be done (after window resizes, user input,
- *          etc.)
+ *          etc.). The sidebar, the map and the tips are separate ncurses windows, and only the
+ *          ones whose contents changed (see ::state_main_game_data::needs_rerender) are redrawn
+ *          and composed into the screen.
  *
  * @param state
  *   Game state (see ::game_state)
@@ -45,7 +47,8 @@ game_loop_callback_return_value state_main_game_onrender(void *state, int width,
 
 /**
  * @brief   Responds to changes of the terminal window size.
- * @details Sets ::state_main_game_data::needs_rerender to 1.
+ * @details Sets ::state_main_game_data::needs_rerender to ::MAIN_GAME_REDRAW_ALL, so that windows
+ *          are recreated with the new layout.
  *
  * @param state
  *   Game state (see ::game_state)
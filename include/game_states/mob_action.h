@@ -24,9 +24,12 @@
 
 #include <game_states/main_game.h>
 
+/** @brief Default time budget of ::state_main_game_mobs_run_lod (microseconds per turn) */
+#define MOB_LOD_DEFAULT_BUDGET 500
+
 /**
  * @brief Animate the mob movement and the attack.
- * @param mob A pointer to the mob
+ * @param mob The index of the mob in ::state_main_game_data::entities
  * @param state A pointer to the main game state data.
  * @param distance_x The horizontal distance between the mob and the player
  * @param distance_y The vertical distance between the mob and the player
@@ -35,10 +38,16 @@
  * @author A90817 Mariana Rocha
  * @author A104082 Pedro Pereira
  */
-void state_main_game_mob_run_ai(entity *mob, state_main_game_data *state);
+void state_main_game_mob_run_ai(size_t mob, state_main_game_data *state,
+                                int distance_x, int distance_y);
 
 /**
  * @brief Animate all the visible mobs by the player.
+ * @details Mobs that aren't visible are then moved by ::state_main_game_mobs_run_lod. When many
+ *          mobs are visible, their paths are found in parallel (see
+ *          ::state_main_game_set_ai_threads), with the same results as on a single thread.
+ *          Equivalent to ::state_main_game_mobs_start_ai followed by
+ *          ::state_main_game_mobs_finish_ai.
  * @param state A pointer to the main game state data.
  *
  * @author A104100 Hélder Gomes
@@ -47,5 +56,90 @@ void state_main_game_mob_run_ai(entity *mob, state_main_game_data *state);
  */
 void state_main_game_mobs_run_ai(state_main_game_data *state);
 
+/**
+ * @brief   Starts planning what the visible mobs do in this turn, and moves the other mobs
+ * @details Only mobs due to act in this turn (see ::mob_schedule) do anything, so slower mobs act
+ *          less often. Random numbers for the plans are generated (and mobs that aren't visible
+ *          are moved) right away, so the game is the same whether plans are made in the
+ *          background or not.
+ *          Until ::state_main_game_mobs_finish_ai, the game can go on, as long as the map, the
+ *          player and the visible mobs don't move (e.g.: while the player's attack is animated).
+ *
+ * @param state      A pointer to the main game state data
+ * @param background Whether to make the plans on another thread, instead of before returning
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_mobs_start_ai(state_main_game_data *state, int background);
+
+/**
+ * @brief   Applies the plans made since ::state_main_game_mobs_start_ai to the visible mobs
+ * @details Waits for the plans to be made, if they're made in the background. Mobs killed in the
+ *          meantime don't act. Does nothing if there are no plans to apply.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_mobs_finish_ai(state_main_game_data *state);
+
+/**
+ * @brief Creates the data needed to plan the AI of mobs (::state_main_game_data::ai)
+ * @returns `NULL` on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+mob_ai_job *mob_ai_job_create(void);
+
+/**
+ * @brief Frees memory allocated by ::mob_ai_job_create, waiting for plans still being made
+ * @author A104348 Humberto Gomes
+ */
+void mob_ai_job_free(mob_ai_job *job);
+
+/**
+ * @brief   Moves mobs that aren't visible, with a level of detail that depends on their distance
+ *          to the player
+ * @details Called by ::state_main_game_mobs_start_ai, with the awake mobs (see
+ *          ::state_main_game_data::wake) that aren't lit and are due to act. They make a coarse
+ *          move (on ::state_main_game_data::lod), that costs as much energy as a few actions, so
+ *          they move every few turns. Sleeping mobs stay where they are. The cost is limited by a
+ *          time budget (see ::state_main_game_set_lod_budget): mobs left without time move in
+ *          the next turn.
+ *
+ * @param state A pointer to the main game state data
+ * @param mobs  Slots of the mobs to move, taken out of the schedule of
+ *              ::state_main_game_data::wake (they're scheduled again)
+ * @param count Number of mobs in @p mobs
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_mobs_run_lod(state_main_game_data *state, const size_t *mobs,
+                                  size_t count);
+
+/**
+ * @brief   Sets the time budget of ::state_main_game_mobs_run_lod for all games
+ * @details With a budget, the result of a game depends on how fast it's simulated, so `0` (no
+ *          limit) must be used when games need to be reproduced (e.g.: input recordings).
+ *
+ * @param microseconds Maximum time spent per turn, or `0` for no limit. The default is
+ *                     ::MOB_LOD_DEFAULT_BUDGET.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_set_lod_budget(unsigned int microseconds);
+
+/**
+ * @brief   Sets the number of threads the AI of mobs is planned on, for all games
+ * @details Only one game can be played at a time with more than one thread (the threads are
+ *          shared), so this must not be used for parallel games (e.g.: `--batch`).
+ *
+ * @param threads Number of threads (including the one the game runs on), `0` for the number of
+ *                CPUs. The default is `1` (no additional threads).
+ *
+ * @return 0 on success, 1 on failure (AI is then planned on a single thread)
+ *
+ * @author A104348 Humberto Gomes
+ */
+int state_main_game_set_ai_threads(size_t threads);
+
 #endif
 
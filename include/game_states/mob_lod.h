@@ -0,0 +1,90 @@
+/**
+ * @file mob_lod.h
+ * @brief Coarse passability grid, for cheap movement of mobs far from the player
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef MOB_LOD_H
+#define MOB_LOD_H
+
+#include <map.h>
+#include <stdint.h>
+
+/** @brief Log2 of the side (in tiles) of the square cells of a ::mob_lod_grid */
+#define MOB_LOD_CELL_SHIFT 2
+
+/** @brief Value of a cell of a ::mob_lod_grid that can't be walked through */
+#define MOB_LOD_BLOCKED UINT8_MAX
+
+/**
+ * @struct mob_lod_grid
+ * @brief   Downsampled version of a map, telling which areas mobs can walk through
+ * @details A cell is passable if at least half of its tiles are empty. Each passable cell stores
+ *          one of its empty tiles (the closest to its center), where mobs are placed when they
+ *          can't keep their position inside the cell.
+ *
+ * @var mob_lod_grid::cells
+ *   For each cell, the position of its representative tile in it (`(y << MOB_LOD_CELL_SHIFT) |
+ *   x`), or ::MOB_LOD_BLOCKED
+ * @var mob_lod_grid::width
+ *   Number of columns of cells
+ * @var mob_lod_grid::height
+ *   Number of rows of cells
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint8_t *cells;
+	unsigned width, height;
+} mob_lod_grid;
+
+/**
+ * @brief Creates the ::mob_lod_grid of a map
+ * @details The grid must be created again if walls or water are changed.
+ * @returns On error, a grid with a `NULL` `cells` pointer.
+ *
+ * @author A104348 Humberto Gomes
+ */
+mob_lod_grid mob_lod_grid_create(const map *map);
+
+/**
+ * @brief Frees memory allocated by ::mob_lod_grid_create
+ * @author A104348 Humberto Gomes
+ */
+void mob_lod_grid_free(mob_lod_grid grid);
+
+/**
+ * @brief Gets where a mob ends up after a coarse move to a neighbor cell
+ *
+ * @param grid The grid of @p map
+ * @param map  The map the mob is on
+ * @param x    Horizontal position of the mob
+ * @param y    Vertical position of the mob
+ * @param dx   Horizontal direction (`-1`, `0` or `1`)
+ * @param dy   Vertical direction (`-1`, `0` or `1`)
+ * @param tx   Where to write the horizontal position of the destination
+ * @param ty   Where to write the vertical position of the destination
+ *
+ * @return 1 on success, 0 if the neighbor cell is outside the map or not passable
+ *
+ * @author A104348 Humberto Gomes
+ */
+int mob_lod_grid_step(const mob_lod_grid *grid, const map *map, int x, int y, int dx, int dy,
+                      int *tx, int *ty);
+
+#endif
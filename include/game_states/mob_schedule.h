@@ -0,0 +1,154 @@
+/**
+ * @file mob_schedule.h
+ * @brief Timing wheel of the turns when awake mobs act next
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef MOB_SCHEDULE_H
+#define MOB_SCHEDULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Log2 of the number of buckets (turns) of a ::mob_schedule */
+#define MOB_SCHEDULE_WHEEL_SHIFT 4
+
+/** @brief Number of buckets (turns) of a ::mob_schedule */
+#define MOB_SCHEDULE_WHEEL_SIZE (1 << MOB_SCHEDULE_WHEEL_SHIFT)
+
+/** @brief End of a list of a ::mob_schedule */
+#define MOB_SCHEDULE_NONE SIZE_MAX
+
+/** @brief Value of ::mob_schedule::previous for slots that aren't scheduled */
+#define MOB_SCHEDULE_UNSCHEDULED (SIZE_MAX - 1)
+
+/**
+ * @struct mob_schedule
+ * @brief   Mobs waiting for their next action, bucketed by the turn it happens on
+ * @details Each bucket is a doubly linked list (stored in arrays indexed by slot), for mobs to be
+ *          scheduled, removed and taken out when due in constant time. The bucket of a turn is
+ *          `turn % MOB_SCHEDULE_WHEEL_SIZE`, so mobs scheduled for more than
+ *          ::MOB_SCHEDULE_WHEEL_SIZE turns ahead are looked at (and left in place) once per
+ *          revolution of the wheel.
+ *
+ *          Mobs gain energy every turn, as much as their speed (see ::entity_get_speed), and
+ *          actions cost energy. So, a mob twice as slow as another acts half as often.
+ *
+ * @var mob_schedule::next
+ *   Next slot in the list of each slot, or ::MOB_SCHEDULE_NONE
+ * @var mob_schedule::previous
+ *   Previous slot in the list of each slot, ::MOB_SCHEDULE_NONE for the first slot of a list, or
+ *   ::MOB_SCHEDULE_UNSCHEDULED
+ * @var mob_schedule::due
+ *   Turn of the next action of each scheduled slot
+ * @var mob_schedule::energy
+ *   Energy left to each slot after its last action
+ * @var mob_schedule::first
+ *   First slot of the list of each bucket, or ::MOB_SCHEDULE_NONE
+ * @var mob_schedule::last
+ *   Last slot of the list of each bucket, or ::MOB_SCHEDULE_NONE
+ * @var mob_schedule::count
+ *   Number of scheduled slots
+ * @var mob_schedule::now
+ *   First turn whose bucket hasn't been taken out (see ::mob_schedule_pop). Mobs can't be
+ *   scheduled before it.
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	size_t *next, *previous;
+	unsigned int *due;
+	int *energy;
+
+	size_t first[MOB_SCHEDULE_WHEEL_SIZE], last[MOB_SCHEDULE_WHEEL_SIZE];
+	size_t count;
+	unsigned int now;
+} mob_schedule;
+
+/**
+ * @brief Creates an empty ::mob_schedule
+ * @param capacity Capacity of the ::entity_set of the mobs
+ * @returns On error, a schedule with `NULL` pointers.
+ *
+ * @author A104348 Humberto Gomes
+ */
+mob_schedule mob_schedule_create(size_t capacity);
+
+/**
+ * @brief Frees memory allocated by ::mob_schedule_create
+ * @author A104348 Humberto Gomes
+ */
+void mob_schedule_free(mob_schedule schedule);
+
+/**
+ * @brief Checks if a mob is in a ::mob_schedule
+ * @author A104348 Humberto Gomes
+ */
+int mob_schedule_contains(const mob_schedule *schedule, size_t mob);
+
+/**
+ * @brief Schedules a mob that isn't in a ::mob_schedule
+ *
+ * @param schedule The schedule
+ * @param mob      Slot of the mob in its ::entity_set
+ * @param due      Turn of the next action of the mob (moved to ::mob_schedule::now if earlier)
+ * @param energy   Energy the mob has
+ *
+ * @author A104348 Humberto Gomes
+ */
+void mob_schedule_add(mob_schedule *schedule, size_t mob, unsigned int due, int energy);
+
+/**
+ * @brief Removes a mob from a ::mob_schedule (if it's in it)
+ * @author A104348 Humberto Gomes
+ */
+void mob_schedule_remove(mob_schedule *schedule, size_t mob);
+
+/**
+ * @brief   Schedules the next action of a mob that has just acted
+ * @details The mob waits as many turns as needed to gain the energy of the action. Energy left
+ *          after that is kept for later actions.
+ *
+ * @param schedule The schedule (the mob must not be in it)
+ * @param mob      Slot of the mob in its ::entity_set
+ * @param turn     Current turn
+ * @param speed    Energy gained by the mob per turn (see ::entity_get_speed)
+ * @param cost     Energy needed for the next action
+ *
+ * @author A104348 Humberto Gomes
+ */
+void mob_schedule_spend(mob_schedule *schedule, size_t mob, unsigned int turn, int speed,
+                        int cost);
+
+/**
+ * @brief   Takes out of a ::mob_schedule the mobs that act on a turn
+ * @details Only the bucket of @p turn is looked at. Mobs are written in the order they were
+ *          scheduled in, and must be scheduled again (e.g.: with ::mob_schedule_spend) to act
+ *          on later turns.
+ *
+ * @param schedule The schedule
+ * @param turn     Current turn (turns must be taken out in order, without skipping any)
+ * @param mobs     Where to write the slots of the mobs (with space for ::mob_schedule::count)
+ *
+ * @return The number of mobs written to @p mobs
+ *
+ * @author A104348 Humberto Gomes
+ */
+size_t mob_schedule_pop(mob_schedule *schedule, unsigned int turn, size_t *mobs);
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * @file mob_wake.h
+ * @brief Set of mobs woken up by events around them (light, combat noise and deaths)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef MOB_WAKE_H
+#define MOB_WAKE_H
+
+#include <arena.h>
+#include <entities.h>
+#include <game_states/mob_schedule.h>
+
+/** @brief Log2 of the side (in tiles) of the square cells woken up together */
+#define MOB_WAKE_CELL_SHIFT 4
+
+/** @brief Number of turns without events after which an awake mob falls asleep */
+#define MOB_WAKE_IDLE_TURNS 32
+
+/**
+ * @struct mob_wake_set
+ * @brief   Mobs that have been woken up by an event recently, the only ones that move while not
+ *          seen by the player
+ * @details Sleeping mobs aren't listed anywhere but in the spatial index of their ::entity_set.
+ *          Events (see ::mob_wake_set_wake) wake up all mobs in the cells of
+ *          `1 << MOB_WAKE_CELL_SHIFT` tiles they reach, and mobs go back to sleep after
+ *          ::MOB_WAKE_IDLE_TURNS turns without being woken up again. Awake mobs wait for their
+ *          next action in a ::mob_schedule, and only the ones due in a turn are looked at. So, the
+ *          cost of a turn depends on what happens around the player, not on the size of the
+ *          world.
+ *
+ * @var mob_wake_set::schedule
+ *   The awake mobs, by the turn they act next
+ * @var mob_wake_set::woken
+ *   Turn when each awake mob was last woken up
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	mob_schedule schedule;
+	unsigned int *woken;
+} mob_wake_set;
+
+/**
+ * @brief Creates a ::mob_wake_set with all mobs asleep
+ * @param capacity Capacity of the ::entity_set of the mobs
+ * @returns On error, a set with `NULL` pointers.
+ *
+ * @author A104348 Humberto Gomes
+ */
+mob_wake_set mob_wake_set_create(size_t capacity);
+
+/**
+ * @brief Frees memory allocated by ::mob_wake_set_create
+ * @author A104348 Humberto Gomes
+ */
+void mob_wake_set_free(mob_wake_set set);
+
+/**
+ * @brief   Wakes up all mobs in the cells that overlap a square area
+ * @details Costs as much as the number of living entities in those cells.
+ *
+ * @param set      The set of awake mobs
+ * @param entities The mobs (all of them, not a slice or a view)
+ * @param x        Horizontal position of the center of the area
+ * @param y        Vertical position of the center of the area
+ * @param radius   Distance (in each axis) from the center to the sides of the area
+ * @param turn     Current turn (see ::state_main_game_data::turn)
+ * @param scratch  Arena for temporary data (restored before returning)
+ *
+ * @author A104348 Humberto Gomes
+ */
+void mob_wake_set_wake(mob_wake_set *set, entity_set entities, int x, int y, int radius,
+                       unsigned int turn, arena *scratch);
+
+/**
+ * @brief Removes a mob from the set of awake ones (if it's awake)
+ * @author A104348 Humberto Gomes
+ */
+void mob_wake_set_sleep(mob_wake_set *set, size_t mob);
+
+/**
+ * @brief   Takes out of the schedule the mobs that act on a turn
+ * @details Mobs that are dead or that haven't been woken up for ::MOB_WAKE_IDLE_TURNS turns fall
+ *          asleep instead. The others must be scheduled again (see ::mob_schedule_spend).
+ *
+ * @param set    The set of awake mobs
+ * @param health Health of the entities in the set (see ::entity_set::health)
+ * @param turn   Current turn (see ::state_main_game_data::turn)
+ * @param mobs   Where to write the slots of the mobs (see ::mob_schedule_pop)
+ *
+ * @return The number of mobs written to @p mobs
+ *
+ * @author A104348 Humberto Gomes
+ */
+size_t mob_wake_set_pop(mob_wake_set *set, const int *health, unsigned int turn, size_t *mobs);
+
+#endif
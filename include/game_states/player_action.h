@@ -24,6 +24,17 @@
 
 #include <game_states/main_game.h>
 
+/**
+ * @brief Verifies if a player position is valid (inside the map, not a wall, ...)
+ * @param state A pointer to the main game state data.
+ * @param x The x coordinate of the player.
+ * @param y The y coordinate of the player.
+ * @return 1 if the position is valid, 0 otherwise.
+ *
+ * @author A90817 Mariana Rocha
+ */
+int state_main_game_verify_player_position(state_main_game_data *state, int x, int y);
+
 /**
  * @brief Responds to an arrow key to move the player (change its animation for the next turn).
  * @param state Game state
@@ -25,10 +25,49 @@
 #include <entities.h>
 #include <game_states/main_game.h>
 #include <map.h>
+#include <random.h>
+
+/**
+ * @brief Fills a map with natural-looking blobs of a certain tile type.
+ *
+ * @param scratch_map A map that will be used for intermediate computations (will be altered).
+ *                    Must be the same size as @p map.
+ * @param map Struct containing the map (for output)
+ * @param radius1 The radius used in the smoothing process for the walls
+ * @param radius2 The radius used in the smoothing process for the walls
+ * @param tile The type of tile to be placed in the empty map
+ * @param noise Random number generator for the initial noise (copied, so that maps generated
+ *              with the same generator state share their noise)
+ *
+ * @details
+ *
+ * 1. The function fills the map grid randomly with tiles of type @p tile and empty spaces.
+ * 2. The walls are smoothed by replacing the wall tile type of each cell with
+ *    the empty tile type if it has fewer than @p radius2 wall neighbors or more than radius1 wall
+ *    neighbors within a given radius.
+ * 3. This process is repeated again, but with a fixed internal radius.
+ *
+ * @author A104082 Pedro Pereira
+ * @author A104348 Humberto Gomes
+ */
+void generate_random(map scratch_map, map map, int radius1, int radius2, tile_type tile,
+                     rng noise);
+
+/** @brief Default number of entities (the player included) in generated maps */
+#define GENERATE_MAP_DEFAULT_ENTITIES 2500
+
+/**
+ * @brief Sets the number of entities (the player included) in maps generated from now on
+ * @details Limited to the number of entities an ::entity_handle can refer to.
+ * @author A104348 Humberto Gomes
+ */
+void generate_map_set_entity_count(size_t count);
 
 /**
  * @brief Creates a random map with the player, tiles and entities.
- * @param data Data for the main game state.
+ * @param data Data for the main game state. Its random number generator
+ *             (::state_main_game_data::rng) must be initialized (the same seed always generates
+ *             the same map).
  *
  * @author A104082 Pedro Pereira
  */
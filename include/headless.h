@@ -0,0 +1,120 @@
+/**
+ * @file headless.h
+ * @brief Simulation of the game without a terminal, for benchmarking
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <entities.h>
+
+/**
+ * @brief Parts of a turn timed separately in a headless simulation
+ * @author A104348 Humberto Gomes
+ */
+typedef enum {
+	HEADLESS_PHASE_MAP_GENERATION, /**< Map generation and initial lighting */
+	HEADLESS_PHASE_PLAYER,         /**< Scripted player choosing its path and target */
+	HEADLESS_PHASE_LIGHTING,       /**< Cleaning and radiating light around the player */
+	HEADLESS_PHASE_MOB_AI,         /**< Mob path finding and attack choice */
+	HEADLESS_PHASE_COMBAT,         /**< Combat animation steps (damage, projectiles, kills) */
+	HEADLESS_PHASE_ANIMATION,      /**< Movement animation steps */
+	HEADLESS_PHASE_COUNT           /**< Number of phases (not a phase) */
+} headless_phase;
+
+/**
+ * @struct headless_timer
+ * @brief Accumulated timing of a ::headless_phase
+ *
+ * @var headless_timer::calls
+ *   Number of times the phase was timed
+ * @var headless_timer::total
+ *   Total CPU time spent in the phase (seconds)
+ * @var headless_timer::max
+ *   Longest single CPU time spent in the phase (seconds)
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	size_t calls;
+	double total, max;
+} headless_timer;
+
+/**
+ * @struct headless_result
+ * @brief Outcome of a headless simulation
+ *
+ * @var headless_result::turns
+ *   Number of full turns played (fewer than requested if the player died)
+ * @var headless_result::score
+ *   Player's final score
+ * @var headless_result::health
+ *   Player's final health
+ * @var headless_result::kills
+ *   Number of entities of each ::entity_type killed
+ * @var headless_result::timers
+ *   Time spent in each ::headless_phase
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	unsigned int turns;
+	int score, health;
+	unsigned int kills[ENTITY_TYPE_COUNT];
+	headless_timer timers[HEADLESS_PHASE_COUNT];
+} headless_result;
+
+/**
+ * @brief   Plays a game without a terminal, with a scripted player
+ * @details A map is generated from @p seed and the game goes through its actions (see
+ *          ::state_main_game_action) until @p turns turns are done or the player dies. Animations
+ *          are advanced without waiting. The player walks in random directions, attacks the first
+ *          mob within range and accepts every drop.
+ *
+ *          Times are measured as CPU time of the calling thread, so that games can be run in
+ *          parallel without affecting each other's timings. This function is thread-safe.
+ *
+ * @param seed  Seed for the game's random number generator (map generation, combat, AI, ...)
+ * @param turns Maximum number of turns to play
+ *
+ * @author A104348 Humberto Gomes
+ */
+headless_result headless_run(unsigned int seed, unsigned int turns);
+
+/**
+ * @brief Gets the human-readable name of a ::headless_phase
+ * @author A104348 Humberto Gomes
+ */
+const char *headless_phase_get_name(headless_phase phase);
+
+/**
+ * @brief Adds the times of @p timer to @p total (maximum times are maximized)
+ * @author A104348 Humberto Gomes
+ */
+void headless_timer_merge(headless_timer *total, const headless_timer *timer);
+
+/**
+ * @brief Prints the results of ::headless_run in a human readable table
+ * @author A104348 Humberto Gomes
+ */
+void headless_print_result(FILE *out, const headless_result *result);
+
+#endif
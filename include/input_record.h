@@ -0,0 +1,118 @@
+/**
+ * @file input_record.h
+ * @brief Recording of user input to a file, for deterministic replays
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef INPUT_RECORD_H
+#define INPUT_RECORD_H
+
+#include <stdint.h>
+
+/**
+ * @struct input_record_event
+ * @brief A key press in an ::input_record
+ *
+ * @var input_record_event::frame
+ *   Index of the game loop frame in which the key was read
+ * @var input_record_event::time_us
+ *   Time (in microseconds) since the beginning of the recording when the key was read
+ * @var input_record_event::key
+ *   The key, as returned by ncurses
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint64_t frame, time_us;
+	int key;
+} input_record_event;
+
+/**
+ * @brief   A file with a stream of key presses, for recording or replaying.
+ * @details The file starts with a header (magic number `RGLR`, format version, frame rate, the
+ *          seed of the random number generator and the number of entities in each map), followed
+ *          by events. Each event is stored as three
+ *          unsigned LEB128 numbers: frame index and time deltas (relative to the previous event)
+ *          and the key. Most events take 4 to 6 bytes.
+ */
+typedef struct input_record input_record;
+
+/**
+ * @brief Creates a file for recording input
+ *
+ * @param path     Path to the file (overwritten if it exists)
+ * @param fps      Frame rate of the game loop (needed for the fixed timestep of replays)
+ * @param seed     Seed of the random number generator for the recorded session
+ * @param entities Number of entities in each map (see ::generate_map_set_entity_count)
+ *
+ * @returns `NULL` on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+input_record *input_record_create(const char *path, unsigned int fps, unsigned int seed,
+                                  unsigned int entities);
+
+/**
+ * @brief Opens a recording for replaying
+ * @returns `NULL` on failure (including invalid or unsupported files)
+ *
+ * @author A104348 Humberto Gomes
+ */
+input_record *input_record_open(const char *path);
+
+/**
+ * @brief Closes an ::input_record (writing any buffered data)
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int input_record_close(input_record *rec);
+
+/** @brief Gets the frame rate of the recorded session */
+unsigned int input_record_get_fps(const input_record *rec);
+
+/** @brief Gets the seed of the random number generator of the recorded session */
+unsigned int input_record_get_seed(const input_record *rec);
+
+/** @brief Gets the number of entities in each map of the recorded session */
+unsigned int input_record_get_entity_count(const input_record *rec);
+
+/**
+ * @brief Appends an event to a recording created with ::input_record_create
+ * @details Events must be written in chronological order.
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int input_record_write(input_record *rec, input_record_event event);
+
+/**
+ * @brief Gets the next event of a recording opened with ::input_record_open, without consuming it
+ * @returns 0 on success, 1 at the end of the recording (or on failure)
+ *
+ * @author A104348 Humberto Gomes
+ */
+int input_record_peek(input_record *rec, input_record_event *event);
+
+/**
+ * @brief Consumes the event returned by ::input_record_peek
+ * @author A104348 Humberto Gomes
+ */
+void input_record_next(input_record *rec);
+
+#endif
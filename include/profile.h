@@ -0,0 +1,191 @@
+/**
+ * @file profile.h
+ * @brief Hot-path counters and cycle timers (only compiled in with `PROFILE=1 make`)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Events counted by the profiler
+ * @author A104348 Humberto Gomes
+ */
+typedef enum {
+	PROFILE_COUNTER_PATH_SEARCHES,    /**< Calls to ::search_path */
+	PROFILE_COUNTER_PATH_NODES,       /**< Nodes expanded by ::search_path */
+	PROFILE_COUNTER_TILES_LIT,        /**< Tiles lit by ::state_main_game_circle_light_map */
+	PROFILE_COUNTER_CELLS_RENDERED,   /**< Cells output by ::map_render */
+	PROFILE_COUNTER_ENTITIES_SCANNED, /**< Entities checked by ::entity_get_closeby */
+	PROFILE_COUNTER_MALLOCS,          /**< Calls to `malloc`, `calloc` and `realloc` */
+	PROFILE_COUNTER_LOD_MOVES,        /**< Coarse moves of mobs (::state_main_game_mobs_run_lod) */
+	PROFILE_COUNTER_LOD_DEFERRED,     /**< Mobs left unmoved for lack of time (LOD) */
+	PROFILE_COUNTER_MOBS_WOKEN,       /**< Mobs woken up by events (::mob_wake_set_wake) */
+	PROFILE_COUNTER_MOBS_DUE,         /**< Awake mobs with enough energy to act (::mob_schedule) */
+	PROFILE_COUNTER_LIGHT_MASKS,      /**< Light masks calculated ahead of time (::light_cache) */
+	PROFILE_COUNTER_LIGHT_CACHED,     /**< Steps lit with a precalculated mask */
+	PROFILE_COUNTER_COUNT             /**< Number of counters (not a counter) */
+} profile_counter;
+
+/**
+ * @brief Functions timed by the profiler
+ * @author A104348 Humberto Gomes
+ */
+typedef enum {
+	PROFILE_TIMER_SEARCH_PATH, /**< ::search_path */
+	PROFILE_TIMER_LIGHT,       /**< ::state_main_game_circle_light_map */
+	PROFILE_TIMER_MAP_RENDER,  /**< ::map_render */
+	PROFILE_TIMER_CLOSEBY,     /**< ::entity_get_closeby */
+	PROFILE_TIMER_LOD,         /**< ::state_main_game_mobs_run_lod */
+	PROFILE_TIMER_COUNT        /**< Number of timers (not a timer) */
+} profile_timer;
+
+/**
+ * @struct profile_timing
+ * @brief Accumulated measurements of a ::profile_timer
+ *
+ * @var profile_timing::calls
+ *   Number of timed calls
+ * @var profile_timing::cycles
+ *   Total number of CPU cycles (time stamp counter ticks) spent in the timed calls
+ * @var profile_timing::max_cycles
+ *   Largest number of cycles spent in a single call
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint64_t calls, cycles, max_cycles;
+} profile_timing;
+
+/**
+ * @struct profile_snapshot
+ * @brief Values of all counters and timers (since the start of the program or in a single turn)
+ *
+ * @var profile_snapshot::counters
+ *   Values of the counters, indexed by ::profile_counter
+ * @var profile_snapshot::timers
+ *   Values of the timers, indexed by ::profile_timer
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint64_t counters[PROFILE_COUNTER_COUNT];
+	profile_timing timers[PROFILE_TIMER_COUNT];
+} profile_snapshot;
+
+#ifdef PROFILE
+
+	/** @brief Adds @p n to a ::profile_counter */
+	#define PROFILE_COUNT(counter, n) profile_count((counter), (n))
+
+	/** @brief Starts timing a ::profile_timer (must be in the same scope as ::PROFILE_STOP) */
+	#define PROFILE_START(timer) uint64_t profile_start_##timer = profile_cycles()
+
+	/** @brief Stops timing a ::profile_timer started with ::PROFILE_START */
+	#define PROFILE_STOP(timer) profile_time((timer), profile_cycles() - profile_start_##timer)
+
+	/** @brief Marks the end of a game turn (see ::profile_end_turn) */
+	#define PROFILE_END_TURN() profile_end_turn()
+
+	/** @brief Makes the profiling results be written to a file on exit (see ::profile_init) */
+	#define PROFILE_INIT(path) profile_init(path)
+
+#else
+
+	/* @p n is still evaluated (and optimized away), so that local counters aren't unused */
+	#define PROFILE_COUNT(counter, n) ((void) (n))
+	#define PROFILE_START(timer)
+	#define PROFILE_STOP(timer)       ((void) 0)
+	#define PROFILE_END_TURN()        ((void) 0)
+	#define PROFILE_INIT(path)        ((void) 0)
+
+#endif
+
+/**
+ * @brief Gets the value of the CPU's time stamp counter (or nanoseconds on other architectures)
+ * @author A104348 Humberto Gomes
+ */
+uint64_t profile_cycles(void);
+
+/**
+ * @brief   Adds @p n to a ::profile_counter
+ * @details Thread-safe. Use ::PROFILE_COUNT instead, so that nothing is done in release builds.
+ * @author  A104348 Humberto Gomes
+ */
+void profile_count(profile_counter counter, uint64_t n);
+
+/**
+ * @brief   Accounts a call that took @p cycles to a ::profile_timer
+ * @details Thread-safe. Use ::PROFILE_START and ::PROFILE_STOP instead.
+ * @author  A104348 Humberto Gomes
+ */
+void profile_time(profile_timer timer, uint64_t cycles);
+
+/**
+ * @brief   Marks the end of a game turn
+ * @details The values of all counters and timers during the turn are stored, and can be obtained
+ *          with ::profile_get_last_turn. Per-turn values are only meaningful when one game is
+ *          played at a time (not in `--batch` mode).
+ *
+ * @author A104348 Humberto Gomes
+ */
+void profile_end_turn(void);
+
+/**
+ * @brief Gets the values of all counters and timers since the start of the program
+ * @author A104348 Humberto Gomes
+ */
+profile_snapshot profile_get_total(void);
+
+/**
+ * @brief Gets the values of all counters and timers during the last turn
+ * @author A104348 Humberto Gomes
+ */
+profile_snapshot profile_get_last_turn(void);
+
+/**
+ * @brief Gets the name of a ::profile_counter
+ * @author A104348 Humberto Gomes
+ */
+const char *profile_counter_get_name(profile_counter counter);
+
+/**
+ * @brief Gets the name of a ::profile_timer
+ * @author A104348 Humberto Gomes
+ */
+const char *profile_timer_get_name(profile_timer timer);
+
+/**
+ * @brief Writes the profiling results (totals, per turn averages and maximums) to a file
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int profile_dump(const char *path);
+
+/**
+ * @brief Makes ::profile_dump be called (with @p path) when the program exits
+ * @param path Path of the output file. Must be valid until the end of the program.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void profile_init(const char *path);
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file random.h
+ * @brief Instance-local pseudo-random number generation
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+/**
+ * @struct rng
+ * @brief   State of a pseudo-random number generator (PCG32)
+ * @details Unlike `rand()`, every game has its own generator, so that games can be simulated in
+ *          parallel and each one is reproducible from its seed.
+ *
+ * @var rng::state
+ *   Internal state of the generator
+ * @var rng::increment
+ *   Stream selector (always odd)
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint64_t state, increment;
+} rng;
+
+/**
+ * @brief Creates a random number generator
+ *
+ * @param seed   Initial state (the same seed always generates the same sequence)
+ * @param stream Sequence selector: generators with different streams are independent, even with
+ *               the same seed
+ *
+ * @author A104348 Humberto Gomes
+ */
+rng rng_create(uint64_t seed, uint64_t stream);
+
+/**
+ * @brief Generates a uniformly distributed 32-bit random number
+ * @author A104348 Humberto Gomes
+ */
+uint32_t rng_next(rng *r);
+
+/**
+ * @brief   Generates a random number in `[0, n[`
+ * @details Like `rand() % n`, this has a negligible bias for the small @p n used in the game.
+ * @author  A104348 Humberto Gomes
+ */
+int rng_range(rng *r, int n);
+
+#endif
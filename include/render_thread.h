@@ -0,0 +1,93 @@
+/**
+ * @file render_thread.h
+ * @brief Terminal output on a dedicated thread, fed with immutable frame snapshots
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <stddef.h>
+#include <ncurses.h>
+#include <ansi_term.h>
+
+/**
+ * @struct render_thread_stats
+ * @brief Statistics of a ::render_thread
+ *
+ * @var render_thread_stats::published
+ *   Number of frames published by the simulation thread
+ * @var render_thread_stats::presented
+ *   Number of frames output to the terminal by the render thread
+ * @var render_thread_stats::dropped
+ *   Number of frames replaced by a newer one before the render thread got to output them
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	size_t published, presented, dropped;
+} render_thread_stats;
+
+/**
+ * @brief   A thread that outputs frames to the terminal with an ::ansi_term.
+ * @details The simulation thread publishes snapshots of the screen (resolved ncurses cells),
+ *          which are never modified after being published. They are exchanged through a
+ *          lock-free triple buffer: the simulation thread always has a buffer to write to, the
+ *          render thread always has a buffer to read from, and the third one holds the latest
+ *          published frame. Frames the render thread can't keep up with are dropped, so that a
+ *          slow terminal never blocks the simulation or input handling.
+ */
+typedef struct render_thread render_thread;
+
+/**
+ * @brief Creates and starts a render thread
+ *
+ * @param term The terminal backend. From now on, it must only be used by the render thread, until
+ *             ::render_thread_free is called.
+ * @returns `NULL` on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+render_thread *render_thread_create(ansi_term *term);
+
+/**
+ * @brief Outputs the last published frame (if needed), stops the render thread and frees it
+ * @details The ::ansi_term can be used by the calling thread again afterwards.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void render_thread_free(render_thread *rt);
+
+/**
+ * @brief   Takes a snapshot of an ncurses window (usually `newscr`) and publishes it.
+ * @details Never blocks waiting for the render thread. Must always be called from the same thread.
+ * @returns 0 on success, 1 on failure (including output errors in the render thread)
+ *
+ * @author A104348 Humberto Gomes
+ */
+int render_thread_publish_window(render_thread *rt, WINDOW *win);
+
+/**
+ * @brief Gets the statistics of a ::render_thread
+ * @details Must be called from the thread that publishes frames.
+ *
+ * @author A104348 Humberto Gomes
+ */
+render_thread_stats render_thread_get_stats(const render_thread *rt);
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ * @file thread_pool.h
+ * @brief A pool of worker threads for running independent tasks in parallel
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+/**
+ * @brief A task run by a ::thread_pool
+ *
+ * @param index  Index of the task (from `0` to the number of tasks, exclusive)
+ * @param worker Index of the thread running the task (from `0` to the number of threads,
+ *               exclusive). Useful for per-thread data that doesn't need synchronization.
+ * @param data   Data passed to ::thread_pool_run
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef void (*thread_pool_task)(size_t index, size_t worker, void *data);
+
+/**
+ * @brief   A fixed set of threads that run tasks in parallel (a parallel for loop).
+ * @details Threads are kept alive between runs, waiting for work. The thread that calls
+ *          ::thread_pool_run also runs tasks (as worker `0`).
+ */
+typedef struct thread_pool thread_pool;
+
+/**
+ * @brief Creates a thread pool
+ * @param threads Number of threads (including the calling thread). `0` for the number of CPUs.
+ * @returns `NULL` on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+thread_pool *thread_pool_create(size_t threads);
+
+/**
+ * @brief Stops the threads of a ::thread_pool and frees it
+ * @author A104348 Humberto Gomes
+ */
+void thread_pool_free(thread_pool *pool);
+
+/**
+ * @brief Gets the number of threads of a ::thread_pool (including the calling thread)
+ * @author A104348 Humberto Gomes
+ */
+size_t thread_pool_get_thread_count(const thread_pool *pool);
+
+/**
+ * @brief   Runs @p count tasks, returning when all of them are done
+ * @details Tasks are distributed dynamically (a thread takes the next task as soon as it's free),
+ *          in increasing order of index. Must not be called from inside a task.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void thread_pool_run(thread_pool *pool, size_t count, thread_pool_task task, void *data);
+
+#endif
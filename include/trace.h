@@ -0,0 +1,106 @@
+/**
+ * @file trace.h
+ * @brief Timeline of events in Chrome's Trace Event format (only compiled in with `TRACE=1 make`)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Number of events kept for each thread
+ * @details When a thread records more events than this, its oldest ones are overwritten.
+ */
+#define TRACE_BUFFER_EVENTS (1 << 18)
+
+/**
+ * @brief Types of events (values are the phase characters of the Trace Event format)
+ * @author A104348 Humberto Gomes
+ */
+typedef enum {
+	TRACE_EVENT_BEGIN       = 'B', /**< Start of a slice (slices nest in each thread) */
+	TRACE_EVENT_END         = 'E', /**< End of a slice */
+	TRACE_EVENT_ASYNC_BEGIN = 'b', /**< Start of a slice that may not nest (e.g.: spans frames) */
+	TRACE_EVENT_ASYNC_END   = 'e'  /**< End of an asynchronous slice */
+} trace_event_type;
+
+#ifdef TRACE_EVENTS
+
+	/** @brief Begins a slice named @p name (a string literal) in the current thread */
+	#define TRACE_BEGIN(name) trace_event_add(TRACE_EVENT_BEGIN, (name), 0, 0)
+
+	/** @brief Like ::TRACE_BEGIN, but an integer argument is shown with the slice */
+	#define TRACE_BEGIN_ARG(name, arg) trace_event_add(TRACE_EVENT_BEGIN, (name), (arg), 1)
+
+	/** @brief Ends the last slice begun in the current thread */
+	#define TRACE_END(name) trace_event_add(TRACE_EVENT_END, (name), 0, 0)
+
+	/** @brief Begins an asynchronous slice, identified by @p name and @p id */
+	#define TRACE_ASYNC_BEGIN(name, id) trace_event_add(TRACE_EVENT_ASYNC_BEGIN, (name), (id), 0)
+
+	/** @brief Ends an asynchronous slice started with ::TRACE_ASYNC_BEGIN */
+	#define TRACE_ASYNC_END(name, id) trace_event_add(TRACE_EVENT_ASYNC_END, (name), (id), 0)
+
+	/** @brief Makes the trace be written to a file on exit (see ::trace_init) */
+	#define TRACE_INIT(path) trace_init(path)
+
+#else
+
+	#define TRACE_BEGIN(name)           ((void) 0)
+	#define TRACE_BEGIN_ARG(name, arg)  ((void) 0)
+	#define TRACE_END(name)             ((void) 0)
+	#define TRACE_ASYNC_BEGIN(name, id) ((void) 0)
+	#define TRACE_ASYNC_END(name, id)   ((void) 0)
+	#define TRACE_INIT(path)            ((void) 0)
+
+#endif
+
+/**
+ * @brief   Records an event in the current thread's ring buffer
+ * @details Lock-free: each thread only writes to its own buffer. Use the `TRACE_*` macros instead,
+ *          so that nothing is done in release builds.
+ *
+ * @param type    Type of event
+ * @param name    Name of the event. Must be valid until the trace is written (string literal).
+ * @param value   Identifier of asynchronous events, or the argument of ::TRACE_BEGIN_ARG
+ * @param has_arg Whether @p value is an argument to be shown with the slice
+ *
+ * @author A104348 Humberto Gomes
+ */
+void trace_event_add(trace_event_type type, const char *name, uint64_t value, int has_arg);
+
+/**
+ * @brief   Writes all recorded events to a JSON file (that can be opened in Perfetto)
+ * @details Must only be called when no other thread is recording events.
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int trace_write(const char *path);
+
+/**
+ * @brief Makes ::trace_write be called (with @p path) when the program exits
+ * @param path Path of the output file. Must be valid until the end of the program.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void trace_init(const char *path);
+
+#endif
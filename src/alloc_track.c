@@ -0,0 +1,290 @@
+/**
+ * @file alloc_track.c
+ * @brief Accounting of memory allocations per subsystem (compiled in with `ALLOC_TRACK=1 make`)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <alloc_track.h>
+#include <profile.h>
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+/**
+ * @struct alloc_track_count
+ * @brief Number of allocations and of bytes allocated
+ *
+ * @var alloc_track_count::allocations
+ *   Number of calls to `malloc`, `calloc` and `realloc`
+ * @var alloc_track_count::bytes
+ *   Number of bytes requested in those calls
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint64_t allocations, bytes;
+} alloc_track_count;
+
+/**
+ * @struct alloc_track_period
+ * @brief Allocations in periods of time (frames or turns)
+ *
+ * @var alloc_track_period::periods
+ *   Number of periods that have ended
+ * @var alloc_track_period::start
+ *   Total allocations at the start of the current period
+ * @var alloc_track_period::last
+ *   Allocations in the last period
+ * @var alloc_track_period::max
+ *   Maximum allocations and bytes in a single period (not necessarily the same one)
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	uint64_t periods;
+	alloc_track_count start, last, max;
+} alloc_track_period;
+
+/**
+ * @brief Global state of the allocation tracker
+ *
+ * @var tags   Allocations attributed to each ::alloc_tag (updated atomically)
+ * @var frees  Number of calls to `free` (updated atomically)
+ * @var frames Allocations per frame
+ * @var turns  Allocations per turn
+ * @var path   Where to write the results on exit (see ::alloc_track_init)
+ * @var lock   Lock for ::frames and ::turns
+ *
+ * @author A104348 Humberto Gomes
+ */
+static struct {
+	alloc_track_count tags[ALLOC_TAG_COUNT];
+	uint64_t frees;
+	alloc_track_period frames, turns;
+	const char *path;
+	pthread_mutex_t lock;
+} alloc_track_state = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/** @brief Tag allocations of the current thread are attributed to */
+static __thread alloc_tag alloc_track_tag = ALLOC_TAG_OTHER;
+
+alloc_tag alloc_track_set_tag(alloc_tag tag) {
+	alloc_tag previous = alloc_track_tag;
+	alloc_track_tag = tag;
+	return previous;
+}
+
+const char *alloc_tag_get_name(alloc_tag tag) {
+	switch (tag) {
+		case ALLOC_TAG_OTHER:
+			return "other";
+		case ALLOC_TAG_MAP_GENERATION:
+			return "map_generation";
+		case ALLOC_TAG_ENTITIES:
+			return "entities";
+		case ALLOC_TAG_ANIMATION:
+			return "animation";
+		case ALLOC_TAG_PATH_FINDING:
+			return "path_finding";
+		case ALLOC_TAG_COMBAT:
+			return "combat";
+		case ALLOC_TAG_MSG_BOX:
+			return "msg_box";
+		case ALLOC_TAG_RENDERING:
+			return "rendering";
+		case ALLOC_TAG_LIGHTING:
+			return "lighting";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * @brief Accounts an allocation of @p bytes to the current thread's tag
+ * @author A104348 Humberto Gomes
+ */
+void alloc_track_add(uint64_t bytes) {
+	alloc_track_count *count = &alloc_track_state.tags[alloc_track_tag];
+	__atomic_fetch_add(&count->allocations, 1    , __ATOMIC_RELAXED);
+	__atomic_fetch_add(&count->bytes      , bytes, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Gets the allocations attributed to an ::alloc_tag
+ * @author A104348 Humberto Gomes
+ */
+alloc_track_count alloc_track_get_tag(alloc_tag tag) {
+	const alloc_track_count *count = &alloc_track_state.tags[tag];
+	return (alloc_track_count) {
+		.allocations = __atomic_load_n(&count->allocations, __ATOMIC_RELAXED),
+		.bytes       = __atomic_load_n(&count->bytes      , __ATOMIC_RELAXED)
+	};
+}
+
+/**
+ * @brief Gets the allocations attributed to all tags
+ * @author A104348 Humberto Gomes
+ */
+alloc_track_count alloc_track_get_total(void) {
+	alloc_track_count total = { 0, 0 };
+	for (int i = 0; i < ALLOC_TAG_COUNT; ++i) {
+		alloc_track_count count = alloc_track_get_tag(i);
+		total.allocations += count.allocations;
+		total.bytes       += count.bytes;
+	}
+	return total;
+}
+
+/**
+ * @brief Ends a period of time (frame or turn), updating its statistics
+ * @author A104348 Humberto Gomes
+ */
+void alloc_track_end_period(alloc_track_period *period) {
+	alloc_track_count total = alloc_track_get_total();
+
+	pthread_mutex_lock(&alloc_track_state.lock);
+	period->last = (alloc_track_count) {
+		.allocations = total.allocations - period->start.allocations,
+		.bytes       = total.bytes       - period->start.bytes
+	};
+
+	if (period->last.allocations > period->max.allocations)
+		period->max.allocations = period->last.allocations;
+	if (period->last.bytes > period->max.bytes)
+		period->max.bytes = period->last.bytes;
+
+	period->start = total;
+	period->periods++;
+	pthread_mutex_unlock(&alloc_track_state.lock);
+}
+
+void alloc_track_end_frame(void) {
+	alloc_track_end_period(&alloc_track_state.frames);
+}
+
+void alloc_track_end_turn(void) {
+	alloc_track_end_period(&alloc_track_state.turns);
+}
+
+/**
+ * @brief Writes the line of the results table of a tag (or of all tags)
+ * @author A104348 Humberto Gomes
+ */
+void alloc_track_dump_line(FILE *file, const char *name, alloc_track_count count,
+                           uint64_t frames, uint64_t turns) {
+
+	double per_frame = frames ? 1.0 / frames : 0.0, per_turn = turns ? 1.0 / turns : 0.0;
+	fprintf(file, "%s\t%" PRIu64 "\t%" PRIu64 "\t%.2f\t%.1f\t%.2f\t%.1f\n", name,
+	        count.allocations, count.bytes,
+	        count.allocations * per_frame, count.bytes * per_frame,
+	        count.allocations * per_turn , count.bytes * per_turn);
+}
+
+int alloc_track_dump(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (!file) return 1;
+
+	pthread_mutex_lock(&alloc_track_state.lock);
+	alloc_track_period frames = alloc_track_state.frames, turns = alloc_track_state.turns;
+	pthread_mutex_unlock(&alloc_track_state.lock);
+
+	struct rusage usage;
+	long peak_rss = getrusage(RUSAGE_SELF, &usage) ? -1 : usage.ru_maxrss;
+
+	fprintf(file, "peak_rss_kib\t%ld\n", peak_rss);
+	fprintf(file, "frees\t%" PRIu64 "\n",
+	        __atomic_load_n(&alloc_track_state.frees, __ATOMIC_RELAXED));
+	fprintf(file, "frames\t%" PRIu64 "\n", frames.periods);
+	fprintf(file, "turns\t%" PRIu64 "\n\n", turns.periods);
+
+	fprintf(file, "tag\tallocations\tbytes\tallocations_per_frame\tbytes_per_frame\t"
+	              "allocations_per_turn\tbytes_per_turn\n");
+	for (int i = 0; i < ALLOC_TAG_COUNT; ++i)
+		alloc_track_dump_line(file, alloc_tag_get_name(i), alloc_track_get_tag(i),
+		                      frames.periods, turns.periods);
+	alloc_track_dump_line(file, "total", alloc_track_get_total(), frames.periods, turns.periods);
+
+	fprintf(file, "\nperiod\tmax_allocations\tmax_bytes\n");
+	fprintf(file, "frame\t%" PRIu64 "\t%" PRIu64 "\n", frames.max.allocations, frames.max.bytes);
+	fprintf(file, "turn\t%" PRIu64 "\t%" PRIu64 "\n" , turns.max.allocations , turns.max.bytes);
+
+	return fclose(file) != 0;
+}
+
+/**
+ * @brief Writes the results on exit (registered with `atexit` by ::alloc_track_init)
+ * @author A104348 Humberto Gomes
+ */
+void alloc_track_dump_on_exit(void) {
+	if (alloc_track_dump(alloc_track_state.path))
+		fprintf(stderr, "Could not write allocation statistics to \"%s\"\n",
+		        alloc_track_state.path);
+}
+
+void alloc_track_init(const char *path) {
+	alloc_track_state.path = path;
+	atexit(alloc_track_dump_on_exit);
+}
+
+#ifdef ALLOC_TRACK
+
+/*
+ * Memory allocation functions are wrapped at link time (-Wl,--wrap=malloc), so that allocations
+ * done by the game (not by libraries) are accounted. When profiling is also enabled, these
+ * wrappers replace the ones in profile.c.
+ */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void  __real_free(void *ptr);
+
+/** @brief Accounted `malloc` */
+void *__wrap_malloc(size_t size) {
+	PROFILE_COUNT(PROFILE_COUNTER_MALLOCS, 1);
+	alloc_track_add(size);
+	return __real_malloc(size);
+}
+
+/** @brief Accounted `calloc` */
+void *__wrap_calloc(size_t count, size_t size) {
+	PROFILE_COUNT(PROFILE_COUNTER_MALLOCS, 1);
+	alloc_track_add((uint64_t) count * size);
+	return __real_calloc(count, size);
+}
+
+/** @brief Accounted `realloc` (counted as an allocation of the new size) */
+void *__wrap_realloc(void *ptr, size_t size) {
+	PROFILE_COUNT(PROFILE_COUNTER_MALLOCS, 1);
+	alloc_track_add(size);
+	return __real_realloc(ptr, size);
+}
+
+/** @brief Accounted `free` */
+void __wrap_free(void *ptr) {
+	if (ptr) __atomic_fetch_add(&alloc_track_state.frees, 1, __ATOMIC_RELAXED);
+	__real_free(ptr);
+}
+
+#endif
@@ -20,29 +20,185 @@
  */
 
 #include <animation.h>
+#include <alloc_track.h>
 #include <stdlib.h>
+#include <string.h>
 
+/** @brief Number of bytes requested from the heap when a pool runs out of blocks of a size */
+#define ANIMATION_POOL_SLAB_SIZE (16 * 1024)
+
+/**
+ * @brief A free block in a pool, whose memory is reused to link it to the next free block
+ * @author A104348 Humberto Gomes
+ */
+struct animation_pool_block {
+	animation_pool_block *next;
+};
+
+/**
+ * @brief Header of a slab, followed in memory by its blocks
+ * @author A104348 Humberto Gomes
+ */
+struct animation_pool_slab {
+	animation_pool_slab *next;
+};
+
+animation_pool animation_pool_create(void) {
+	animation_pool ret = { .slabs = NULL };
+	for (size_t i = 0; i < ANIMATION_POOL_CLASSES; ++i)
+		ret.free_blocks[i] = NULL;
+	return ret;
+}
+
+void animation_pool_free(animation_pool *pool) {
+	animation_pool_slab *slab = pool->slabs;
+	while (slab) {
+		animation_pool_slab *next = slab->next;
+		free(slab);
+		slab = next;
+	}
+	*pool = animation_pool_create();
+}
+
+/**
+ * @brief Gets the index of the smallest block size that holds @p capacity steps
+ * @returns ::ANIMATION_POOL_CLASSES if no block is large enough
+ *
+ * @author A104348 Humberto Gomes
+ */
+size_t animation_pool_get_class(size_t capacity) {
+	size_t class = 0;
+	while (class < ANIMATION_POOL_CLASSES &&
+	       ((size_t) ANIMATION_POOL_MINIMUM_STEPS << class) < capacity)
+		class++;
+	return class;
+}
+
+/**
+ * @brief Takes a block of a given size from @p pool, allocating a new slab when needed
+ * @details Without a pool, the block is allocated directly from the heap.
+ * @returns `NULL` on allocation failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+animation_step *animation_pool_alloc(animation_pool *pool, size_t class) {
+	size_t block_size = (ANIMATION_POOL_MINIMUM_STEPS << class) * sizeof(animation_step);
+
+	if (!pool) {
+		ALLOC_TAG_BEGIN(ALLOC_TAG_ANIMATION);
+		animation_step *ret = malloc(block_size);
+		ALLOC_TAG_END();
+		return ret;
+	}
+
+	if (!pool->free_blocks[class]) {
+		size_t blocks = ANIMATION_POOL_SLAB_SIZE / block_size;
+		if (blocks == 0) blocks = 1;
+
+		ALLOC_TAG_BEGIN(ALLOC_TAG_ANIMATION);
+		animation_pool_slab *slab = malloc(sizeof(animation_pool_slab) + blocks * block_size);
+		ALLOC_TAG_END();
+
+		if (!slab) return NULL;
+		slab->next = pool->slabs;
+		pool->slabs = slab;
+
+		char *slab_blocks = (char *) (slab + 1);
+		for (size_t i = 0; i < blocks; ++i) {
+			animation_pool_block *block = (animation_pool_block *) (slab_blocks + i * block_size);
+			block->next = pool->free_blocks[class];
+			pool->free_blocks[class] = block;
+		}
+	}
+
+	animation_pool_block *ret = pool->free_blocks[class];
+	pool->free_blocks[class] = ret->next;
+	return (animation_step *) ret;
+}
+
+/**
+ * @brief Returns the storage of a sequence with capacity @p capacity to where it came from
+ * @author A104348 Humberto Gomes
+ */
+void animation_storage_release(animation_pool *pool, animation_step *steps, size_t capacity) {
+	if (capacity <= ANIMATION_SEQUENCE_INLINE_STEPS) return;
+
+	size_t class = animation_pool_get_class(capacity);
+	if (!pool || class == ANIMATION_POOL_CLASSES) {
+		free(steps);
+	} else {
+		animation_pool_block *block = (animation_pool_block *) steps;
+		block->next = pool->free_blocks[class];
+		pool->free_blocks[class] = block;
+	}
+}
 
 animation_sequence animation_sequence_create(void) {
 	animation_sequence ret = {
-		.steps = malloc(ANIMATION_SEQUENCE_STARTING_CAPACITY * sizeof(animation_step)),
 		.length = 0,
-		.capacity = ANIMATION_SEQUENCE_STARTING_CAPACITY
+		.capacity = ANIMATION_SEQUENCE_INLINE_STEPS
 	};
 	return ret;
 }
 
-void animation_sequence_free(animation_sequence s) {
-	free(s.steps);
+void animation_sequence_free(animation_pool *pool, animation_sequence s) {
+	if (s.capacity > ANIMATION_SEQUENCE_INLINE_STEPS)
+		animation_storage_release(pool, s.storage.pooled_steps, s.capacity);
+}
+
+animation_step *animation_sequence_get_steps(animation_sequence *sequence) {
+	if (sequence->capacity > ANIMATION_SEQUENCE_INLINE_STEPS)
+		return sequence->storage.pooled_steps;
+	else
+		return sequence->storage.inline_steps;
+}
+
+void animation_sequence_reserve(animation_pool *pool, animation_sequence *sequence,
+                                size_t capacity) {
+	if (capacity <= sequence->capacity) return;
+
+	size_t class = animation_pool_get_class(capacity);
+	animation_step *steps;
+	if (class == ANIMATION_POOL_CLASSES) {
+		/* Very long sequences (not expected in the game) grow like a dynamic array */
+		if (capacity < sequence->capacity * 2) capacity = sequence->capacity * 2;
+
+		ALLOC_TAG_BEGIN(ALLOC_TAG_ANIMATION);
+		steps = malloc(capacity * sizeof(animation_step));
+		ALLOC_TAG_END();
+	} else {
+		capacity = ANIMATION_POOL_MINIMUM_STEPS << class;
+		steps = animation_pool_alloc(pool, class);
+	}
+
+	if (!steps) return; /* Allocation failure: keep the old storage */
+
+	animation_step *old_steps = animation_sequence_get_steps(sequence);
+	memcpy(steps, old_steps, sequence->length * sizeof(animation_step));
+	animation_storage_release(pool, old_steps, sequence->capacity);
+
+	sequence->storage.pooled_steps = steps;
+	sequence->capacity = capacity;
 }
 
-void animation_sequence_add_step(animation_sequence *sequence, animation_step add) {
+void animation_sequence_add_step(animation_pool *pool, animation_sequence *sequence,
+                                 animation_step add) {
 	if (sequence->length >= sequence->capacity) {
-		sequence->capacity *= 2;
-		sequence->steps = realloc(sequence->steps, sequence->capacity * sizeof(animation_step));
+		animation_sequence_reserve(pool, sequence, sequence->length + 1);
+		if (sequence->length >= sequence->capacity) return; /* Allocation failure */
 	}
 
-	sequence->steps[sequence->length] = add;
+	animation_sequence_get_steps(sequence)[sequence->length] = add;
 	sequence->length++;
 }
 
+animation_sequence animation_sequence_copy(animation_pool *pool, animation_sequence *sequence) {
+	animation_sequence ret = animation_sequence_create();
+	animation_sequence_reserve(pool, &ret, sequence->length);
+	if (ret.capacity < sequence->length) return ret; /* Allocation failure */
+
+	memcpy(animation_sequence_get_steps(&ret), animation_sequence_get_steps(sequence),
+	       sequence->length * sizeof(animation_step));
+	ret.length = sequence->length;
+	return ret;
+}
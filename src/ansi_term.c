@@ -0,0 +1,475 @@
+/**
+ * @file ansi_term.c
+ * @brief Implementation of the ANSI escape sequence terminal backend
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <ansi_term.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ANSI_TERM_PAIRS 64 /**< @brief Number of color pairs whose SGR parameters are cached */
+
+/** @brief Size of the output buffer on creation (grows if needed) */
+#define ANSI_TERM_STARTING_CAPACITY 16384
+
+/**
+ * @brief   Maximum number of unchanged cells that are rewritten instead of skipped
+ * @details Skipping cells costs at least 3 bytes (`ESC [ C`), so rewriting up to 3 cells with the
+ *          current attributes is never worse.
+ */
+#define ANSI_TERM_MAX_GAP 3
+
+/** @brief ncurses attributes that are translated into SGR parameters */
+#define ANSI_TERM_ATTRIBUTES \
+	(A_BOLD | A_DIM | A_UNDERLINE | A_BLINK | A_REVERSE | A_STANDOUT | A_INVIS)
+
+/**
+ * @struct ansi_term
+ * @brief State of the ANSI terminal backend
+ *
+ * @var ansi_term::fd
+ *   File descriptor of the terminal
+ * @var ansi_term::buffer
+ *   Output of the frame being generated
+ * @var ansi_term::length
+ *   Number of bytes in ::ansi_term::buffer
+ * @var ansi_term::capacity
+ *   Maximum number of bytes ::ansi_term::buffer can hold
+ *
+ * @var ansi_term::shadow
+ *   What is known to be on the screen
+ * @var ansi_term::frame
+ *   Storage for frames read from ncurses windows
+ * @var ansi_term::width
+ *   Width of ::ansi_term::shadow
+ * @var ansi_term::height
+ *   Height of ::ansi_term::shadow
+ * @var ansi_term::valid
+ *   Whether ::ansi_term::shadow reflects the contents of the screen
+ *
+ * @var ansi_term::cursor_x
+ *   Horizontal position of the terminal's cursor (`-1` if unknown)
+ * @var ansi_term::cursor_y
+ *   Vertical position of the terminal's cursor (`-1` if unknown)
+ * @var ansi_term::attr
+ *   Current attributes and color pair of the terminal
+ *
+ * @var ansi_term::pair_sgr
+ *   SGR color parameters for each color pair
+ * @var ansi_term::stats
+ *   Output statistics
+ *
+ * @author A104348 Humberto Gomes
+ */
+struct ansi_term {
+	int fd;
+	char *buffer;
+	size_t length, capacity;
+
+	chtype *shadow, *frame;
+	int width, height;
+	int valid;
+
+	int cursor_x, cursor_y;
+	chtype attr;
+
+	char pair_sgr[ANSI_TERM_PAIRS][16];
+	ansi_term_stats stats;
+};
+
+/**
+ * @brief   Appends bytes to the output buffer of an ::ansi_term, growing it if needed
+ * @details If the buffer can't grow, the bytes are dropped and the terminal is invalidated, so
+ *          that the current frame is discarded and the next one fully redrawn.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void ansi_term_append(ansi_term *term, const char *str, size_t len) {
+	if (term->length + len > term->capacity) {
+		size_t capacity = term->capacity;
+		while (term->length + len > capacity) capacity *= 2;
+
+		char *buffer = realloc(term->buffer, capacity);
+		if (!buffer) {
+			term->valid = 0;
+			return;
+		}
+		term->buffer   = buffer;
+		term->capacity = capacity;
+	}
+
+	memcpy(term->buffer + term->length, str, len);
+	term->length += len;
+}
+
+/**
+ * @brief Appends a NUL-terminated string to the output buffer of an ::ansi_term
+ * @author A104348 Humberto Gomes
+ */
+void ansi_term_puts(ansi_term *term, const char *str) {
+	ansi_term_append(term, str, strlen(str));
+}
+
+/**
+ * @brief Appends a control sequence (`ESC [ n c`) to the output buffer
+ * @details The parameter is omitted if it is 1 (the default for cursor movements).
+ * @author A104348 Humberto Gomes
+ */
+void ansi_term_csi(ansi_term *term, int n, char c) {
+	char seq[16];
+	int len = (n == 1) ? sprintf(seq, "\x1b[%c", c) : sprintf(seq, "\x1b[%d%c", n, c);
+	ansi_term_append(term, seq, len);
+}
+
+/**
+ * @brief Number of decimal digits of a positive number
+ * @author A104348 Humberto Gomes
+ */
+int ansi_term_digits(int n) {
+	int digits = 1;
+	for (; n >= 10; n /= 10) digits++;
+	return digits;
+}
+
+/** @brief Number of bytes needed by ::ansi_term_csi */
+#define ansi_term_csi_cost(n) (((n) == 1) ? 3 : 3 + ansi_term_digits(n))
+
+/**
+ * @brief Writes the whole output buffer to the terminal and clears it
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int ansi_term_flush(ansi_term *term) {
+	size_t written = 0;
+	while (written < term->length) {
+		ssize_t ret = write(term->fd, term->buffer + written, term->length - written);
+		if (ret < 0) {
+			if (errno == EINTR) continue;
+			term->length = 0;
+			return 1;
+		}
+		written += ret;
+	}
+
+	term->length = 0;
+	return 0;
+}
+
+/**
+ * @brief Calculates the SGR color parameters of an ncurses color
+ * @param base 30 for foreground colors, 40 for background colors
+ *
+ * @author A104348 Humberto Gomes
+ */
+int ansi_term_color_sgr(char *out, short color, int base) {
+	if (color < 0)
+		return sprintf(out, "%d", base + 9); /* Terminal's default color */
+	else if (color < 8)
+		return sprintf(out, "%d", base + color);
+	else if (color < 16)
+		return sprintf(out, "%d", base + 60 + color - 8); /* Bright colors */
+	else
+		return sprintf(out, "%d;5;%d", base + 8, color); /* 256 color palette */
+}
+
+ansi_term *ansi_term_create(int fd) {
+	ansi_term *term = malloc(sizeof(ansi_term));
+	if (!term) return NULL;
+
+	term->fd = fd;
+	term->capacity = ANSI_TERM_STARTING_CAPACITY;
+	term->buffer = malloc(term->capacity);
+	term->length = 0;
+	if (!term->buffer) {
+		free(term);
+		return NULL;
+	}
+
+	term->shadow = term->frame = NULL;
+	term->width = term->height = 0;
+	term->valid = 0;
+
+	term->cursor_x = term->cursor_y = -1;
+	term->attr = A_NORMAL;
+
+	memset(&term->stats, 0, sizeof(ansi_term_stats));
+
+	/* Pair 0 always has the terminal's default colors */
+	strcpy(term->pair_sgr[0], "39;49");
+	for (short pair = 1; pair < ANSI_TERM_PAIRS; ++pair) {
+		short fg = -1, bg = -1;
+		if (pair >= COLOR_PAIRS || pair_content(pair, &fg, &bg) == ERR) {
+			strcpy(term->pair_sgr[pair], "39;49");
+			continue;
+		}
+
+		int len = ansi_term_color_sgr(term->pair_sgr[pair], fg, 30);
+		term->pair_sgr[pair][len++] = ';';
+		ansi_term_color_sgr(term->pair_sgr[pair] + len, bg, 40);
+	}
+
+	return term;
+}
+
+void ansi_term_free(ansi_term *term) {
+	/* Leave the terminal with default attributes */
+	ansi_term_puts(term, "\x1b[0m");
+	ansi_term_flush(term);
+
+	free(term->buffer);
+	free(term->shadow);
+	free(term->frame);
+	free(term);
+}
+
+void ansi_term_invalidate(ansi_term *term) {
+	term->valid = 0;
+}
+
+/**
+ * @brief Changes the terminal's attributes and color, outputting as few bytes as possible
+ * @details If any attribute needs to be turned off, all attributes are reset (SGR 0), as there's
+ *          no portable way of turning off some of them individually.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void ansi_term_set_attr(ansi_term *term, chtype attr) {
+	attr &= ANSI_TERM_ATTRIBUTES | A_COLOR;
+	if (attr == term->attr) return;
+
+	char params[64];
+	int len = 0;
+
+	chtype old_attrs = term->attr & ANSI_TERM_ATTRIBUTES, new_attrs = attr & ANSI_TERM_ATTRIBUTES;
+	int old_pair = PAIR_NUMBER(term->attr), new_pair = PAIR_NUMBER(attr);
+
+	chtype add = new_attrs;
+	if (old_attrs & ~new_attrs) {
+		/* Reset everything. Colors go back to the defaults (pair 0) */
+		len += sprintf(params + len, "0;");
+		old_pair = 0;
+	} else {
+		add &= ~old_attrs; /* Only turn on what's missing */
+	}
+
+	if (add & A_BOLD)                     len += sprintf(params + len, "1;");
+	if (add & A_DIM)                      len += sprintf(params + len, "2;");
+	if (add & A_UNDERLINE)                len += sprintf(params + len, "4;");
+	if (add & A_BLINK)                    len += sprintf(params + len, "5;");
+	if (add & (A_REVERSE | A_STANDOUT))   len += sprintf(params + len, "7;");
+	if (add & A_INVIS)                    len += sprintf(params + len, "8;");
+
+	if (new_pair != old_pair)
+		len += sprintf(params + len, "%s;",
+			term->pair_sgr[new_pair < ANSI_TERM_PAIRS ? new_pair : 0]);
+
+	if (len > 0) {
+		params[len - 1] = 'm'; /* Replace last separator */
+		ansi_term_append(term, "\x1b[", 2);
+		ansi_term_append(term, params, len);
+	}
+
+	term->attr = attr;
+}
+
+/**
+ * @brief Moves the terminal cursor, choosing the shortest possible sequence
+ *
+ * @param term  The terminal backend
+ * @param cells The frame being output (for rewriting unchanged cells instead of skipping them)
+ * @param x     Destination column
+ * @param y     Destination line
+ *
+ * @author A104348 Humberto Gomes
+ */
+void ansi_term_move(ansi_term *term, const chtype *cells, int x, int y) {
+	int cx = term->cursor_x, cy = term->cursor_y;
+	if (cx == x && cy == y) return;
+
+	/* Small forward gaps on the same line: rewrite the cells if they have the same attributes */
+	if (cy == y && x > cx && cx >= 0 && x - cx <= ANSI_TERM_MAX_GAP) {
+		const chtype *gap = cells + y * term->width + cx;
+
+		int same_attributes = 1;
+		for (int i = 0; i < x - cx; ++i)
+			if ((gap[i] & (ANSI_TERM_ATTRIBUTES | A_COLOR)) != term->attr)
+				same_attributes = 0;
+
+		if (same_attributes) {
+			for (int i = 0; i < x - cx; ++i) {
+				char chr = gap[i] & A_CHARTEXT;
+				ansi_term_append(term, chr ? &chr : " ", 1);
+			}
+
+			term->cursor_x = x;
+			return;
+		}
+	}
+
+	/* Cost of an absolute movement: ESC [ line ; column H (defaults can be omitted) */
+	int absolute_cost = 3 + (y ? ansi_term_digits(y + 1) : 0) +
+	                        (x ? 1 + ansi_term_digits(x + 1) : 0);
+
+	/* Cost of relative movement (only possible if the position of the cursor is known) */
+	int relative_cost = absolute_cost + 1, carriage_return = 0;
+	if (cx >= 0 && cy >= 0) {
+		relative_cost = (y == cy) ? 0 : ansi_term_csi_cost(abs(y - cy));
+
+		if (x != cx) {
+			int horizontal = ansi_term_csi_cost(abs(x - cx));
+			int from_start = (x == 0) ? 1 : 1 + ansi_term_csi_cost(x); /* \r + forward */
+
+			if (from_start < horizontal) {
+				carriage_return = 1;
+				horizontal = from_start;
+			}
+			relative_cost += horizontal;
+		}
+	}
+
+	if (relative_cost < absolute_cost) {
+		if      (y > cy) ansi_term_csi(term, y - cy, 'B');
+		else if (y < cy) ansi_term_csi(term, cy - y, 'A');
+
+		if (carriage_return) {
+			ansi_term_append(term, "\r", 1);
+			if (x > 0) ansi_term_csi(term, x, 'C');
+		}
+		else if (x > cx) ansi_term_csi(term, x - cx, 'C');
+		else if (x < cx) ansi_term_csi(term, cx - x, 'D');
+	} else {
+		char seq[32];
+		int len;
+		if (x == 0 && y == 0) len = sprintf(seq, "\x1b[H");
+		else if (x == 0)      len = sprintf(seq, "\x1b[%dH", y + 1);
+		else if (y == 0)      len = sprintf(seq, "\x1b[;%dH", x + 1);
+		else                  len = sprintf(seq, "\x1b[%d;%dH", y + 1, x + 1);
+		ansi_term_append(term, seq, len);
+	}
+
+	term->cursor_x = x;
+	term->cursor_y = y;
+}
+
+/**
+ * @brief   Clears the screen and resets the shadow buffer, after a resize or invalidation
+ * @details On allocation failure, the terminal is left invalid (see ::ansi_term::valid).
+ * @author  A104348 Humberto Gomes
+ */
+void ansi_term_reset_screen(ansi_term *term, int width, int height) {
+	if (term->width != width || term->height != height) {
+		free(term->shadow);
+		free(term->frame);
+
+		term->shadow = malloc(width * height * sizeof(chtype));
+		term->frame  = malloc((width * height + 1) * sizeof(chtype)); /* +1: see present_window */
+		if (!term->shadow || !term->frame) {
+			free(term->shadow);
+			free(term->frame);
+			term->shadow = term->frame = NULL;
+			term->width  = term->height = 0; /* Try again on the next frame */
+			term->valid  = 0;
+			return;
+		}
+		term->width = width; term->height = height;
+	}
+
+	/* Set first, so that a failure to output the following sequence invalidates the terminal */
+	term->valid = 1;
+
+	/* Default attributes, home cursor, clear screen */
+	ansi_term_puts(term, "\x1b[0m\x1b[H\x1b[2J");
+	term->attr = A_NORMAL;
+	term->cursor_x = term->cursor_y = 0;
+
+	for (int i = 0; i < width * height; ++i)
+		term->shadow[i] = ' ';
+}
+
+int ansi_term_present(ansi_term *term, const chtype *cells, int width, int height) {
+	if (!term->valid || term->width != width || term->height != height)
+		ansi_term_reset_screen(term, width, height);
+	if (!term->valid) {
+		term->length = 0; /* Out of memory. Drop the frame */
+		return 0;
+	}
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			chtype c = cells[y * width + x];
+			if ((c & A_CHARTEXT) == 0) c |= ' ';
+
+			if (c == term->shadow[y * width + x]) continue;
+
+			ansi_term_move(term, cells, x, y);
+			ansi_term_set_attr(term, c);
+
+			char chr = c & A_CHARTEXT;
+			ansi_term_append(term, &chr, 1);
+			term->shadow[y * width + x] = c;
+
+			/* After writing on the last column, the cursor's position is terminal dependent */
+			if (++term->cursor_x >= width)
+				term->cursor_x = term->cursor_y = -1;
+		}
+	}
+
+	if (!term->valid) {
+		/* Out of memory for the output. Drop the frame, and redraw everything in the next one */
+		term->length = 0;
+		return 0;
+	}
+
+	size_t bytes = term->length;
+	term->stats.frames++;
+	term->stats.last_frame_bytes = bytes;
+	term->stats.total_bytes += bytes;
+	if (bytes > term->stats.max_frame_bytes)
+		term->stats.max_frame_bytes = bytes;
+
+	return ansi_term_flush(term);
+}
+
+int ansi_term_present_window(ansi_term *term, WINDOW *win) {
+	int width, height;
+	getmaxyx(win, height, width);
+
+	if (term->width != width || term->height != height)
+		ansi_term_reset_screen(term, width, height);
+	if (!term->frame) return 0; /* Out of memory. Drop the frame */
+
+	/*
+	 * winchnstr adds a terminating 0 after the last cell of each line. That overwrites the first
+	 * cell of the next line, which is read afterwards. The frame has an extra cell for the
+	 * terminator of the last line.
+	 */
+	for (int y = 0; y < height; ++y)
+		mvwinchnstr(win, y, 0, term->frame + y * width, width);
+
+	return ansi_term_present(term, term->frame, width, height);
+}
+
+ansi_term_stats ansi_term_get_stats(const ansi_term *term) {
+	return term->stats;
+}
@@ -0,0 +1,150 @@
+/**
+ * @file arena.c
+ * @brief Bump-pointer allocator for short-lived data
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <arena.h>
+#include <core.h>
+
+#include <stdlib.h>
+
+/**
+ * @brief A type with the strictest alignment requirement of the basic types
+ * @details C99 has no `max_align_t`.
+ */
+typedef union {
+	long double ld;
+	long long ll;
+	void *p;
+	void (*f)(void);
+} arena_align;
+
+/**
+ * @struct arena_block
+ * @brief A block of memory of an ::arena
+ *
+ * @var arena_block::next
+ *   Next block in the list
+ * @var arena_block::capacity
+ *   Size of ::arena_block::data in bytes
+ * @var arena_block::data
+ *   Memory given out by the arena
+ *
+ * @author A104348 Humberto Gomes
+ */
+struct arena_block {
+	struct arena_block *next;
+	size_t capacity;
+	arena_align data[];
+};
+
+/**
+ * @brief Allocates an empty ::arena_block
+ * @author A104348 Humberto Gomes
+ */
+arena_block *arena_block_create(size_t capacity) {
+	arena_block *block = malloc(sizeof(arena_block) + capacity);
+	if (!block) return NULL;
+
+	block->next     = NULL;
+	block->capacity = capacity;
+	return block;
+}
+
+/**
+ * @brief Frees a block and all blocks after it
+ * @author A104348 Humberto Gomes
+ */
+void arena_block_free_list(arena_block *block) {
+	while (block) {
+		arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+}
+
+arena arena_create(size_t capacity) {
+	arena_block *block = arena_block_create(capacity);
+	arena ret = {
+		.first = block,
+		.block = block,
+		.used  = 0
+	};
+	return ret;
+}
+
+void arena_free(arena *a) {
+	arena_block_free_list(a->first);
+	a->first = a->block = NULL;
+	a->used  = 0;
+}
+
+void *arena_alloc(arena *a, size_t size) {
+	/* Keep all allocations aligned */
+	size = (size + sizeof(arena_align) - 1) / sizeof(arena_align) * sizeof(arena_align);
+	if (!a->block) return NULL;
+
+	while (a->used + size > a->block->capacity) {
+		arena_block *next = a->block->next;
+
+		if (!next || next->capacity < size) {
+			/* Replace the following blocks (too small or nonexistent) with a larger one */
+			arena_block_free_list(next);
+			next = arena_block_create(max(2 * a->block->capacity, size));
+			a->block->next = next;
+			if (!next) return NULL;
+		}
+
+		a->block = next;
+		a->used  = 0;
+	}
+
+	void *ret = (char *) a->block->data + a->used;
+	a->used += size;
+	return ret;
+}
+
+void arena_reset(arena *a) {
+	if (a->first && a->first->next) {
+		/* Merge all blocks into one, so that the peak usage fits without chaining */
+		size_t capacity = 0;
+		for (arena_block *block = a->first; block; block = block->next)
+			capacity += block->capacity;
+
+		arena_block_free_list(a->first);
+		a->first = arena_block_create(capacity);
+	}
+
+	a->block = a->first;
+	a->used  = 0;
+}
+
+arena_mark arena_get_mark(const arena *a) {
+	arena_mark ret = {
+		.block = a->block,
+		.used  = a->used
+	};
+	return ret;
+}
+
+void arena_restore(arena *a, arena_mark mark) {
+	/* Blocks after the mark's one are kept (empty) for reuse */
+	a->block = mark.block;
+	a->used  = mark.used;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file batch.c
+ * @brief Simulation of many games in parallel (Monte Carlo), for balancing and benchmarking
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <batch.h>
+#include <thread_pool.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @struct batch_task_data
+ * @brief Data shared by all games of a batch (see ::batch_play_game)
+ *
+ * @var batch_task_data::results
+ *   Results of each game
+ * @var batch_task_data::seed
+ *   Seed of the first game
+ * @var batch_task_data::turns
+ *   Maximum number of turns per game
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	headless_result *results;
+	unsigned int seed, turns;
+} batch_task_data;
+
+/**
+ * @brief Task of the ::thread_pool that plays a single game
+ * @author A104348 Humberto Gomes
+ */
+void batch_play_game(size_t index, size_t worker, void *data) {
+	(void) worker;
+
+	batch_task_data *task = data;
+	task->results[index] = headless_run(task->seed + index, task->turns);
+}
+
+/**
+ * @brief Adds the result of a game to the aggregated results of a batch
+ * @author A104348 Humberto Gomes
+ */
+void batch_add_result(batch_result *batch, const headless_result *game) {
+	if (game->health <= 0) batch->deaths++;
+
+	batch->total_turns += game->turns;
+	if (game->turns < batch->min_turns) batch->min_turns = game->turns;
+	if (game->turns > batch->max_turns) batch->max_turns = game->turns;
+
+	batch->total_score += game->score;
+	if (game->score > batch->max_score) batch->max_score = game->score;
+
+	for (int i = 0; i < ENTITY_TYPE_COUNT; ++i)
+		batch->kills[i] += game->kills[i];
+
+	for (int i = 0; i < HEADLESS_PHASE_COUNT; ++i)
+		headless_timer_merge(&batch->timers[i], &game->timers[i]);
+}
+
+batch_result batch_run(unsigned int games, size_t threads, unsigned int seed, unsigned int turns) {
+	batch_result result;
+	memset(&result, 0, sizeof(batch_result));
+	result.min_turns = turns;
+
+	batch_task_data task = {
+		.results = malloc(games * sizeof(headless_result)),
+		.seed = seed, .turns = turns
+	};
+
+	thread_pool *pool = thread_pool_create(threads);
+	if (!task.results || !pool) {
+		free(task.results);
+		if (pool) thread_pool_free(pool);
+		return result; /* No games played */
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	thread_pool_run(pool, games, batch_play_game, &task);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	result.games = games;
+	result.threads = thread_pool_get_thread_count(pool);
+	result.wall_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+	/* Aggregate in order, so that results don't depend on scheduling */
+	for (unsigned int i = 0; i < games; ++i)
+		batch_add_result(&result, &task.results[i]);
+
+	thread_pool_free(pool);
+	free(task.results);
+	return result;
+}
+
+void batch_print_result(FILE *out, const batch_result *result) {
+	if (result->games == 0) {
+		fprintf(out, "No games played\n");
+		return;
+	}
+
+	double games = result->games;
+	fprintf(out, "Games: %u on %zu threads, %.3f s (%.2f games/s)\n\n", result->games,
+	        result->threads, result->wall_time, games / result->wall_time);
+
+	fprintf(out, "Survival: %.2f turns on average (min: %u, max: %u), died in %u games (%.1f%%)\n",
+	        result->total_turns / games, result->min_turns, result->max_turns, result->deaths,
+	        100.0 * result->deaths / games);
+	fprintf(out, "Score: %.2f on average (max: %d)\n\n", result->total_score / games,
+	        result->max_score);
+
+	fprintf(out, "%-16s %12s %12s\n", "Kills", "Total", "Per game");
+	for (int i = 0; i < ENTITY_TYPE_COUNT; ++i)
+		fprintf(out, "%-16s %12llu %12.3f\n", entity_get_name(i), result->kills[i],
+		        result->kills[i] / games);
+
+	double cpu_time = 0;
+	fprintf(out, "\n%-16s %12s %12s %12s %12s\n",
+	        "Phase (CPU)", "Calls", "Total (s)", "Per game (ms)", "Max (us)");
+	for (int i = 0; i < HEADLESS_PHASE_COUNT; ++i) {
+		const headless_timer *t = &result->timers[i];
+		cpu_time += t->total;
+
+		fprintf(out, "%-16s %12zu %12.3f %12.3f %12.3f\n", headless_phase_get_name(i),
+		        t->calls, t->total, t->total * 1e3 / games, t->max * 1e6);
+	}
+
+	fprintf(out, "\nCPU time: %.3f s (%.2fx parallel speedup)\n", cpu_time,
+	        cpu_time / result->wall_time);
+}
@@ -21,61 +21,87 @@
 
 #include <stdlib.h>
 #include <combat.h>
+#include <alloc_track.h>
 
 /**
- * @brief  Calculates the movement of an arrow for an attack
- * @return Will return an empty animation if the movement is impossible (wall collision or no
- *         light), or the arrow animation in case of success
+ * @brief  Calculates the number of steps of the movement of an arrow for an attack
+ * @return 0 if the movement is impossible (wall collision or no light), or the number of steps
+ *         of the arrow animation in case of success. No memory is allocated.
  *
- * @param attacker The entity that attacks @p attacked
- * @param attacked The entity attacked by @attacker
- * @param map      The map, for arrow-wall collision information
+ * @param from Position of the attacker
+ * @param to   Position of the attacked entity
+ * @param map  The map, for arrow-wall collision information
  *
  * @author A104348 Humberto Gomes
  */
-animation_sequence combat_arrow_movement
-	(const entity *attacker, const entity *attacked, const map *map) {
-
-	animation_sequence ret = animation_sequence_create();
-
+size_t combat_arrow_length(animation_step from, animation_step to, const map *map) {
 	/* Entities must be aligned horizontally or vertically with line of sight */
-	if (!(attacker->x == attacked->x || attacker->y == attacked->y)) return ret;
+	if (!(from.x == to.x || from.y == to.y)) return 0;
 
 	/* Movement vector of the arrow (each animation frame) */
-	int dx = sgn(attacked->x - attacker->x), dy = sgn(attacked->y - attacker->y);
-
-	animation_step pos = {
-		.x = attacker->x, .y = attacker->y
-	};
+	int dx = sgn(to.x - from.x), dy = sgn(to.y - from.y);
+	animation_step pos = from;
 
 	/* Check for walls and unlit spots in the middle of the path */
-	while (!(attacked->x == pos.x && attacked->y == pos.y)) {
+	size_t length = 0;
+	while (!(to.x == pos.x && to.y == pos.y)) {
 
 		if (!(pos.x >= 0                    && pos.y >= 0 &&
-		      (unsigned) pos.x < map->width && (unsigned) pos.y < map->height)) {
-
-			ret.length = 0;
-			return ret; /* Out of bounds arrow */
-		}
+		      (unsigned) pos.x < map->width && (unsigned) pos.y < map->height))
+			return 0; /* Out of bounds arrow */
 
 		if (map->data[pos.y * map->width + pos.x].type == TILE_WALL ||
-		    map->data[pos.y * map->width + pos.x].light == 0) {
+		    map->data[pos.y * map->width + pos.x].light == 0)
+			return 0; /* Wall in the middle of the path or unlit area */
 
-			ret.length = 0;
-			return ret; /* Wall in the middle of the path or unlit area */
-		}
+		pos.x += dx; pos.y += dy;
+		length++;
+	}
+
+	return length;
+}
+
+/**
+ * @brief  Calculates the movement of an arrow for an attack
+ * @return Will return an empty animation if the movement is impossible (wall collision or no
+ *         light), or the arrow animation in case of success
+ *
+ * @param pool Where to allocate the animation from (see ::entity_set_get_animation_pool)
+ * @param from Position of the attacker
+ * @param to   Position of the attacked entity
+ * @param map  The map, for arrow-wall collision information
+ *
+ * @author A104348 Humberto Gomes
+ */
+animation_sequence combat_arrow_movement(animation_pool *pool, animation_step from,
+                                         animation_step to, const map *map) {
+	animation_sequence ret = animation_sequence_create();
 
+	/* The path is only built when known to be valid */
+	size_t length = combat_arrow_length(from, to, map);
+	int dx = sgn(to.x - from.x), dy = sgn(to.y - from.y);
+	animation_step pos = from;
+
+	for (size_t i = 0; i < length; ++i) {
 		pos.x += dx; pos.y += dy;
-		animation_sequence_add_step(&ret, pos);
+		animation_sequence_add_step(pool, &ret, pos);
 	}
 
 	return ret;
 }
 
-int combat_can_attack(const entity *attacker, const entity *attacked, const map *map) {
-	int dist = manhattan_distance(attacker->x, attacker->y, attacked->x, attacked->y);
+int combat_can_attack(entity_set entities, size_t attacker, size_t attacked, const map *map) {
+	animation_step from = { .x = entities.x[attacker], .y = entities.y[attacker] };
+	return combat_can_attack_from(entities, attacker, from, attacked, map);
+}
+
+int combat_can_attack_from(entity_set entities, size_t attacker, animation_step from,
+                           size_t attacked, const map *map) {
 
-	switch (attacker->weapon) {
+	animation_step to = { .x = entities.x[attacked], .y = entities.y[attacked] };
+	int dist = manhattan_distance(from.x, from.y, to.x, to.y);
+
+	switch (entities.cold[attacker].weapon) {
 		/* Simple range-based weapons */
 		case WEAPON_HAND:
 			return dist <= 2;
@@ -86,40 +112,49 @@ int combat_can_attack(const entity *attacker, const entity *attacked, const map
 
 		/*
 		 * Arrows: if the attacked entity is aligned with and in sight of the attacker
-		 * (i.e., the animation sequence can be formed).
+		 * (i.e., the animation sequence can be formed, which is checked without forming it).
 		 */
-		case WEAPON_ARROW: {
-			animation_sequence seq = combat_arrow_movement(attacker, attacked, map);
-			int ret = seq.length > 0;
-			animation_sequence_free(seq);
-			return ret;
-		}
+		case WEAPON_ARROW:
+			return combat_arrow_length(from, to, map) > 0;
 
 		case WEAPON_BOMB:
 			/* Bombs can only be thrown to lit map spots (in-bounds) */
-			return attacked->x >= 0                   && attacked->y >= 0 &&
-				(unsigned) attacked->x < map->width && (unsigned) attacked->y < map->width
-				&& map->data[attacked->y * map->width + attacked->x].light;
+			return to.x >= 0                   && to.y >= 0 &&
+				(unsigned) to.x < map->width && (unsigned) to.y < map->width
+				&& map->data[to.y * map->width + to.x].light;
 		default:
 			/* Unknown weapon can't attack */
 			return 0;
 	}
 }
 
-void combat_attack(entity *attacker, const entity *attacked, const map *map) {
-	switch (attacker->weapon) {
+void combat_attack(entity_set entities, size_t attacker, size_t attacked, const map *map) {
+	ALLOC_TAG_BEGIN(ALLOC_TAG_COMBAT);
+
+	animation_step from = { .x = entities.x[attacker], .y = entities.y[attacker] };
+	animation_step to   = { .x = entities.x[attacked], .y = entities.y[attacked] };
+	entity_cold *cold = &entities.cold[attacker];
+
+	switch (cold->weapon) {
 		case WEAPON_ARROW: {
 			combat_arrow_info *t = malloc(sizeof(combat_arrow_info));
-			t->animation = combat_arrow_movement(attacker, attacked, map);
-			attacker->combat_target = t;
+			if (!t) break; /* Allocation failure: the attack is missed */
+
+			t->animation = combat_arrow_movement(entity_set_get_animation_pool(entities), from, to,
+			                                      map);
+			cold->combat_target = t;
+			cold->attacking = 1;
 		}
 		break;
 
 		case WEAPON_BOMB: {
 			combat_bomb_info *t = malloc(sizeof(combat_bomb_info));
-			t->x = attacked->x;
-			t->y = attacked->y;
-			attacker->combat_target = t;
+			if (!t) break; /* Allocation failure: the attack is missed */
+
+			t->x = to.x;
+			t->y = to.y;
+			cold->combat_target = t;
+			cold->attacking = 1;
 		}
 		break;
 
@@ -127,9 +162,13 @@ void combat_attack(entity *attacker, const entity *attacked, const map *map) {
 		case WEAPON_DAGGER:
 		case WEAPON_IPAD:
 		default:
-			attacker->combat_target = (entity *) attacked;
+			/* The target is stored inline, as melee attacks are too frequent to allocate */
+			cold->melee_target = entity_set_get_handle(entities, attacked);
+			cold->attacking = 1;
 			break;
 	}
+
+	ALLOC_TAG_END();
 }
 
 #define BOMB_EXPLOSION_LENGTH 4
@@ -138,24 +177,27 @@ void combat_attack(entity *attacker, const entity *attacked, const map *map) {
  * @brief Deals random damage to @p target based on the strength of @w
  * @author A104348 Humberto Gomes
  */
-void combat_deal_damage(weapon w, entity *target, entity_kill_callback onkill, void *cb_data) {
-	if (target->health > 0) {
+void combat_deal_damage(weapon w, entity_set entities, size_t target,
+                        entity_kill_callback onkill, void *cb_data, rng *rng) {
+	int *health = &entities.health[target];
+
+	if (*health > 0) {
 		switch (w) {
 			case WEAPON_HAND:
-				target->health--;
+				(*health)--;
 				break;
 
 			case WEAPON_DAGGER:
 			case WEAPON_ARROW:
-				target->health -= (rand() % 3) + 1; /* 1 <= damage <= 3 */
+				*health -= (rng_range(rng, 3)) + 1; /* 1 <= damage <= 3 */
 				break;
 
 			case WEAPON_BOMB:
-				target->health -= (rand() % 2) + 2; /* 2 <= damage <= 3 */
+				*health -= (rng_range(rng, 2)) + 2; /* 2 <= damage <= 3 */
 				break;
 
 			case WEAPON_IPAD:
-				target->health -= (rand() % 3) + 3; /* 3 <= damage <= 5 */
+				*health -= (rng_range(rng, 3)) + 3; /* 3 <= damage <= 5 */
 				break;
 
 			default:
@@ -163,40 +205,38 @@ void combat_deal_damage(weapon w, entity *target, entity_kill_callback onkill, v
 		}
 
 		/* Check if the entity has been killed to destroy it */
-		if (target->health <= 0) {
+		if (*health <= 0) {
 			if (onkill)
-				onkill(target, cb_data);
+				onkill(entities, target, cb_data);
 
-			animation_sequence_free(target->animation);
-			entity_free_combat_target(target);
-
-			if (target->destroy)
-				target->destroy(target);
+			entity_set_kill(entities, target);
 		}
 	}
 }
 
-/**
- * @brief Deals random damage to all entities in a location, based on the strength of @p w
- * @author A104348 Humberto Gomes
- */
 void combat_deal_damage_position(weapon w, entity_set entities, int x, int y,
-                                 entity_kill_callback onkill, void *cb_data) {
+                                 entity_kill_callback onkill, void *cb_data, rng *rng) {
+
+	size_t count;
+	const size_t *live = entity_set_get_live(entities, &count);
 
-	for (size_t i = 0; i < entities.count; ++i)
-		/* No need to check health >= 0, as combat_deal_damage does that */
-		if (entities.entities[i].x == x && entities.entities[i].y == y)
-			combat_deal_damage(w, &entities.entities[i], onkill, cb_data);
+	/* Killed entities stay listed until compaction, so positions don't change */
+	for (size_t k = entity_set_find_at(entities, 0, x, y); k < count;
+	     k = entity_set_find_at(entities, k + 1, x, y))
+		combat_deal_damage(w, entities, live[k], onkill, cb_data, rng);
 }
 
 int combat_animation_update(entity_set all, entity_set entity_set, size_t step_index,
-                            entity_kill_callback onkill, void *cb_data) {
+                            entity_kill_callback onkill, void *cb_data, rng *rng) {
 
-	for (size_t i = 0; i < entity_set.count; ++i) {
-		entity cur = entity_set.entities[i];
+	size_t count;
+	const size_t *live = entity_set_get_live(entity_set, &count);
+	for (size_t k = 0; k < count; ++k) {
+		size_t i = live[k];
 
 		/* Skip dead and inactive entities */
-		if (cur.health <= 0 || cur.combat_target == NULL) continue;
+		if (entity_set.health[i] <= 0 || !entity_set.cold[i].attacking) continue;
+		entity_cold cur = entity_set.cold[i];
 
 		size_t length = 0;
 		if (cur.weapon == WEAPON_ARROW) {
@@ -205,9 +245,9 @@ int combat_animation_update(entity_set all, entity_set entity_set, size_t step_i
 
 			/* Don't attack entities in the middle of the path */
 			if (length != 0 && length - 1 == step_index) {
-				animation_step last = anim.steps[length - 1];
+				animation_step last = animation_sequence_get_steps(&anim)[length - 1];
 				combat_deal_damage_position(cur.weapon, all, last.x, last.y,
-					onkill, cb_data);
+					onkill, cb_data, rng);
 			}
 
 		} else if (cur.weapon == WEAPON_BOMB) {
@@ -218,10 +258,13 @@ int combat_animation_update(entity_set all, entity_set entity_set, size_t step_i
 				for (int y = bomb.y - 1; y <= bomb.y + 1; ++y)
 					for (int x = bomb.x - 1; x <= bomb.x + 1; ++x)
 						combat_deal_damage_position(cur.weapon, all, x, y,
-							onkill, cb_data);
+							onkill, cb_data, rng);
 
 		} else if (step_index == 0) {
-			combat_deal_damage(cur.weapon, cur.combat_target, onkill, cb_data);
+			/* The target is in the set of all entities, and may have already been killed */
+			size_t target;
+			if (entity_set_resolve(all, cur.melee_target, &target))
+				combat_deal_damage(cur.weapon, all, target, onkill, cb_data, rng);
 
 		}
 
@@ -231,26 +274,58 @@ int combat_animation_update(entity_set all, entity_set entity_set, size_t step_i
 	return 1;
 }
 
-/*
- * @brief If in-bounds, place a character in map coordinates in the overlay
- * @author A104348 Humberto Gomes
- */
-void combat_overlay_write(ncurses_char chr, int x, int y, ncurses_char *overlay,
-                          const map_window *wnd) {
+combat_overlay combat_overlay_create(void) {
+	ALLOC_TAG_BEGIN(ALLOC_TAG_COMBAT);
+	combat_overlay ret = {
+		.cells = malloc(COMBAT_OVERLAY_STARTING_CAPACITY * sizeof(combat_overlay_cell)),
+		.length = 0,
+		.capacity = COMBAT_OVERLAY_STARTING_CAPACITY
+	};
+	ALLOC_TAG_END();
+
+	if (!ret.cells) ret.capacity = 0; /* Allocated again when a cell is added */
+	return ret;
+}
 
-	if (map_window_visible(x, y, wnd)) {
-		overlay[(y - wnd->map_top) * wnd->width + (x - wnd->map_left)] = chr;
+void combat_overlay_free(combat_overlay overlay) {
+	free(overlay.cells);
+}
+
+void combat_overlay_clear(combat_overlay *overlay) {
+	overlay->length = 0;
+}
+
+void combat_overlay_add(combat_overlay *overlay, int x, int y, ncurses_char chr) {
+	if (overlay->length >= overlay->capacity) {
+		size_t capacity = overlay->capacity ? 2 * overlay->capacity :
+		                                      COMBAT_OVERLAY_STARTING_CAPACITY;
+
+		ALLOC_TAG_BEGIN(ALLOC_TAG_COMBAT);
+		combat_overlay_cell *cells =
+			realloc(overlay->cells, capacity * sizeof(combat_overlay_cell));
+		ALLOC_TAG_END();
+		if (!cells) return; /* Not drawn */
+
+		overlay->cells    = cells;
+		overlay->capacity = capacity;
 	}
+
+	combat_overlay_cell cell = { .x = x, .y = y, .chr = chr };
+	overlay->cells[overlay->length] = cell;
+	overlay->length++;
 }
 
 void combat_entity_set_animate(entity_set entity_set, size_t step_index,
-                               ncurses_char *overlay, const map_window *wnd) {
+                               combat_overlay *overlay) {
 
-	for (size_t i = 0; i < entity_set.count; ++i) {
-		entity cur = entity_set.entities[i];
+	size_t count;
+	const size_t *live = entity_set_get_live(entity_set, &count);
+	for (size_t k = 0; k < count; ++k) {
+		size_t i = live[k];
 
 		/* Skip dead and inactive entities */
-		if (cur.health <= 0 || cur.combat_target == NULL) continue;
+		if (entity_set.health[i] <= 0 || !entity_set.cold[i].attacking) continue;
+		entity_cold cur = entity_set.cold[i];
 
 		/* Draw arrows and bombs (only visible animations) */
 		if (cur.weapon == WEAPON_ARROW) {
@@ -259,8 +334,8 @@ void combat_entity_set_animate(entity_set entity_set, size_t step_index,
 			/* Draw a slash in the position of the arrow */
 			if (step_index < seq.length) {
 				ncurses_char chr = { .attr = COLOR_PAIR(COLOR_WHITE), .chr = '/' };
-				combat_overlay_write(chr, seq.steps[step_index].x, seq.steps[step_index].y,
-					overlay, wnd);
+				animation_step step = animation_sequence_get_steps(&seq)[step_index];
+				combat_overlay_add(overlay, step.x, step.y, chr);
 			}
 
 		} else if (cur.weapon == WEAPON_BOMB && step_index % 2 == 0) { /* mod 2 for blinking */
@@ -270,7 +345,7 @@ void combat_entity_set_animate(entity_set entity_set, size_t step_index,
 			ncurses_char chr = { .attr = COLOR_PAIR(COLOR_RED), .chr = '@' };
 			for (int y = bomb.y - 1; y <= bomb.y + 1; ++y)
 				for (int x = bomb.x - 1; x <= bomb.x + 1; ++x)
-					combat_overlay_write(chr, x, y, overlay, wnd);
+					combat_overlay_add(overlay, x, y, chr);
 		}
 	}
 }
@@ -24,6 +24,8 @@
 
 #include <core.h>
 #include <entities.h>
+#include <profile.h>
+#include <alloc_track.h>
 
 const char *entity_get_name(entity_type t) {
 	switch (t) {
@@ -41,120 +43,434 @@ const char *entity_get_name(entity_type t) {
 	}
 }
 
+int entity_get_speed(entity_type t) {
+	switch (t) {
+		case ENTITY_PLAYER:
+		case ENTITY_RAT:
+			return ENTITY_ACTION_ENERGY;
+		case ENTITY_GOBLIN:
+			return 80;
+		case ENTITY_CRISTINO:
+			return 50;
+		default:
+			/* Not supposed to happen */
+			return ENTITY_ACTION_ENERGY;
+	}
+}
+
 /**
- * @brief Frees memory of an entity's combat target and sets it to NULL
- * @details That is done depending on the entity's weapon, that determines the type of the data
- *
+ * @brief Gets the cell of an ::entity_grid that contains a position (clamped to the grid)
  * @author A104348 Humberto Gomes
  */
-void entity_free_combat_target(entity *ent) {
-	if (ent->combat_target) {
-		if (ent->weapon == WEAPON_ARROW) {
-			animation_sequence_free(((combat_arrow_info *)ent->combat_target)->animation);
-			free(ent->combat_target);
-		} else if (ent->weapon == WEAPON_BOMB) {
-			free(ent->combat_target);
-		}
-	}
-	ent->combat_target = NULL;
+size_t entity_grid_get_cell(const entity_grid *grid, int x, int y) {
+	int cx = max(0, min(x >> ENTITY_GRID_CELL_SHIFT, (int) grid->width  - 1));
+	int cy = max(0, min(y >> ENTITY_GRID_CELL_SHIFT, (int) grid->height - 1));
+	return (size_t) cy * grid->width + cx;
 }
 
-entity_set entity_set_allocate(size_t count) {
+/**
+ * @brief Adds a slot to the front of the list of a cell of an ::entity_grid
+ * @author A104348 Humberto Gomes
+ */
+void entity_grid_link(entity_grid *grid, size_t index, size_t cell) {
+	size_t head = grid->head[cell];
+	grid->cell[index] = cell;
+	grid->prev[index] = ENTITY_GRID_NONE;
+	grid->next[index] = head;
+	if (head != ENTITY_GRID_NONE)
+		grid->prev[head] = index;
+	grid->head[cell] = index;
+}
+
+/**
+ * @brief Removes a slot from the list of its cell of an ::entity_grid
+ * @author A104348 Humberto Gomes
+ */
+void entity_grid_unlink(entity_grid *grid, size_t index) {
+	size_t prev = grid->prev[index], next = grid->next[index];
+	if (prev == ENTITY_GRID_NONE)
+		grid->head[grid->cell[index]] = next;
+	else
+		grid->next[prev] = next;
+
+	if (next != ENTITY_GRID_NONE)
+		grid->prev[next] = prev;
+}
+
+entity_set entity_set_allocate(size_t capacity, unsigned width, unsigned height) {
+	unsigned cell_size = 1 << ENTITY_GRID_CELL_SHIFT;
+	unsigned grid_width  = max(1u, (width  + cell_size - 1) >> ENTITY_GRID_CELL_SHIFT);
+	unsigned grid_height = max(1u, (height + cell_size - 1) >> ENTITY_GRID_CELL_SHIFT);
+
+	ALLOC_TAG_BEGIN(ALLOC_TAG_ENTITIES);
 	entity_set ret = {
-		.entities = malloc(count * sizeof(entity)),
-		.count = count
+		.x          = malloc(capacity * sizeof(int)),
+		.y          = malloc(capacity * sizeof(int)),
+		.health     = calloc(capacity, sizeof(int)), /* Unused slots have no health */
+		.type       = malloc(capacity * sizeof(entity_type)),
+		.cold       = malloc(capacity * sizeof(entity_cold)),
+		.generation = calloc(capacity, sizeof(uint16_t)),
+		.capacity   = capacity,
+
+		.lists      = malloc(sizeof(entity_set_lists)),
+		.first      = 0,
+		.max        = SIZE_MAX,
+
+		.indices     = NULL,
+		.index_count = 0
+	};
+
+	*ret.lists = (entity_set_lists) {
+		.live          = malloc(capacity * sizeof(size_t)),
+		.live_position = malloc(capacity * sizeof(size_t)),
+		.live_count    = 0,
+		.free_slots    = malloc(capacity * sizeof(size_t)),
+		.free_count    = capacity,
+		.dead          = malloc(capacity * sizeof(size_t)),
+		.dead_count    = 0,
+
+		.grid = {
+			.head   = malloc((size_t) grid_width * grid_height * sizeof(size_t)),
+			.next   = malloc(capacity * sizeof(size_t)),
+			.prev   = malloc(capacity * sizeof(size_t)),
+			.cell   = malloc(capacity * sizeof(size_t)),
+			.width  = grid_width,
+			.height = grid_height
+		},
+
+		.animations = animation_pool_create()
 	};
+	ALLOC_TAG_END();
+
+	/* Lower slots on the top of the stack, to be used first */
+	for (size_t i = 0; i < capacity; ++i)
+		ret.lists->free_slots[i] = capacity - 1 - i;
+
+	for (size_t i = 0; i < (size_t) grid_width * grid_height; ++i)
+		ret.lists->grid.head[i] = ENTITY_GRID_NONE;
+
 	return ret;
 }
 
 void entity_set_free(entity_set entities) {
-	for (size_t i = 0; i < entities.count; ++i) {
-		if (entities.entities[i].health <= 0) continue; /* Skip invalid entities */
+	size_t count;
+	const size_t *live = entity_set_get_live(entities, &count);
+	for (size_t k = 0; k < count; ++k)
+		if (entities.health[live[k]] > 0) /* Skip entities that have already been killed */
+			entity_set_kill(entities, live[k]);
+
+	free(entities.x);
+	free(entities.y);
+	free(entities.health);
+	free(entities.type);
+	free(entities.cold);
+	free(entities.generation);
+
+	free(entities.lists->live);
+	free(entities.lists->live_position);
+	free(entities.lists->free_slots);
+	free(entities.lists->dead);
+	free(entities.lists->grid.head);
+	free(entities.lists->grid.next);
+	free(entities.lists->grid.prev);
+	free(entities.lists->grid.cell);
+	animation_pool_free(&entities.lists->animations);
+	free(entities.lists);
+}
+
+size_t entity_set_spawn(entity_set entities, entity ent) {
+	entity_set_lists *lists = entities.lists;
+	if (lists->free_count == 0) return entities.capacity;
+
+	size_t index = lists->free_slots[--lists->free_count];
+	entities.x[index]      = ent.x;
+	entities.y[index]      = ent.y;
+	entities.health[index] = ent.health;
+	entities.type[index]   = ent.type;
+	entities.cold[index]   = ent.cold;
+
+	lists->live_position[index] = lists->live_count;
+	lists->live[lists->live_count++] = index;
+
+	entity_grid_link(&lists->grid, index, entity_grid_get_cell(&lists->grid, ent.x, ent.y));
+	return index;
+}
+
+void entity_set_move(entity_set entities, size_t index, int x, int y) {
+	entities.x[index] = x;
+	entities.y[index] = y;
+
+	entity_grid *grid = &entities.lists->grid;
+	size_t cell = entity_grid_get_cell(grid, x, y);
+	if (cell != grid->cell[index]) {
+		entity_grid_unlink(grid, index);
+		entity_grid_link(grid, index, cell);
+	}
+}
+
+animation_pool *entity_set_get_animation_pool(entity_set entities) {
+	return &entities.lists->animations;
+}
+
+/*
+ * The combat target is freed depending on the entity's weapon, that determines the type of the
+ * data.
+ */
+void entity_free_combat_target(entity_set entities, size_t index) {
+	entity_cold *ent = &entities.cold[index];
+	if (ent->combat_target) {
+		if (ent->weapon == WEAPON_ARROW)
+			animation_sequence_free(entity_set_get_animation_pool(entities),
+			                        ((combat_arrow_info *)ent->combat_target)->animation);
+		free(ent->combat_target);
+	}
+	ent->combat_target = NULL;
+	ent->attacking     = 0;
+}
+
+entity_handle entity_set_get_handle(entity_set entities, size_t index) {
+	return ((entity_handle) entities.generation[index] << ENTITY_HANDLE_INDEX_BITS) |
+	       (entity_handle) index;
+}
+
+int entity_set_resolve(entity_set entities, entity_handle handle, size_t *index) {
+	size_t i = handle & ENTITY_HANDLE_INDEX_MASK;
+	if (i >= entities.capacity || entities.health[i] <= 0 ||
+	    entities.generation[i] != handle >> ENTITY_HANDLE_INDEX_BITS)
+		return 0;
+
+	*index = i;
+	return 1;
+}
+
+void entity_set_kill(entity_set entities, size_t index) {
+	entity_cold *cold = &entities.cold[index];
+	animation_sequence_free(entity_set_get_animation_pool(entities), cold->animation);
+	entity_free_combat_target(entities, index);
+
+	if (cold->destroy)
+		cold->destroy(cold);
+
+	entities.generation[index] = (entities.generation[index] + 1) & ENTITY_HANDLE_GENERATION_MASK;
+
+	entity_set_lists *lists = entities.lists;
+	lists->dead[lists->dead_count++] = index;
+	entity_grid_unlink(&lists->grid, index);
+}
+
+void entity_set_compact(entity_set entities) {
+	entity_set_lists *lists = entities.lists;
 
-		animation_sequence_free(entities.entities[i].animation);
-		entity_free_combat_target(&entities.entities[i]);
+	for (size_t i = 0; i < lists->dead_count; ++i) {
+		size_t index = lists->dead[i], pos = lists->live_position[index];
+		if (pos == 0) continue; /* Keep the player first, even if dead */
 
-		if (entities.entities[i].destroy)
-			entities.entities[i].destroy(&entities.entities[i]);
+		/* Swap-remove from the list of living entities */
+		size_t last = lists->live[--lists->live_count];
+		lists->live[pos] = last;
+		lists->live_position[last] = pos;
+
+		lists->free_slots[lists->free_count++] = index;
 	}
+	lists->dead_count = 0;
+}
+
+entity_set entity_set_slice(entity_set entities, size_t start, size_t count) {
+	size_t available;
+	entity_set_get_live(entities, &available);
+
+	entity_set ret = entities;
+	ret.first = entities.first + min(start, available);
+	ret.max   = min(count, available - min(start, available));
+	return ret;
+}
+
+entity_set entity_set_view(entity_set entities, const size_t *indices, size_t count) {
+	entity_set ret = entities;
+	ret.first       = 0;
+	ret.max         = SIZE_MAX;
+	ret.indices     = indices;
+	ret.index_count = count;
+	return ret;
+}
+
+const size_t *entity_set_get_live(entity_set entities, size_t *count) {
+	const size_t *list = entities.indices ? entities.indices : entities.lists->live;
+	size_t list_count  = entities.indices ? entities.index_count : entities.lists->live_count;
+	size_t first = min(entities.first, list_count);
 
-	free(entities.entities);
+	*count = min(entities.max, list_count - first);
+	return list + first;
 }
 
 /**
- * @brief Inserts an entity in an ordered entity list
+ * @brief Gets the position of a slot in the list of living entities of a (possibly sliced) set
+ * @returns A value larger than the number of living entities in the set if the slot isn't in it
+ *
+ * @author A104348 Humberto Gomes
+ */
+size_t entity_set_get_position(entity_set entities, size_t index) {
+	return entities.lists->live_position[index] - entities.first; /* Wraps around if before */
+}
+
+size_t entity_set_find_at(entity_set entities, size_t start, int x, int y) {
+	const entity_grid *grid = &entities.lists->grid;
+	const int *ex = entities.x, *ey = entities.y, *health = entities.health;
+
+	size_t count;
+	entity_set_get_live(entities, &count);
+
+	/* Only entities in the cell of the position can be there */
+	size_t found = count;
+	size_t i = grid->head[entity_grid_get_cell(grid, x, y)];
+	for (; i != ENTITY_GRID_NONE; i = grid->next[i]) {
+		size_t pos = entity_set_get_position(entities, i);
+		if (ex[i] == x && ey[i] == y && health[i] > 0 && start <= pos && pos < found)
+			found = pos;
+	}
+	return found;
+}
+
+size_t entity_set_get_in_area_unordered(entity_set entities, int x0, int y0, int x1, int y1,
+                                        size_t *out) {
+	const entity_grid *grid = &entities.lists->grid;
+	const int *x = entities.x, *y = entities.y, *health = entities.health;
+
+	size_t count;
+	entity_set_get_live(entities, &count);
+
+	size_t first_cell = entity_grid_get_cell(grid, x0, y0);
+	size_t last_cell  = entity_grid_get_cell(grid, x1, y1);
+	size_t cx0 = first_cell % grid->width, cy0 = first_cell / grid->width;
+	size_t cx1 = last_cell  % grid->width, cy1 = last_cell  / grid->width;
+
+	size_t found = 0;
+	for (size_t cy = cy0; cy <= cy1; ++cy) {
+		for (size_t cx = cx0; cx <= cx1; ++cx) {
+			size_t i = grid->head[cy * grid->width + cx];
+			for (; i != ENTITY_GRID_NONE; i = grid->next[i]) {
+				if (x0 <= x[i] && x[i] <= x1 && y0 <= y[i] && y[i] <= y1 && health[i] > 0 &&
+				    entity_set_get_position(entities, i) < count)
+					out[found++] = i;
+			}
+		}
+	}
+
+	return found;
+}
+
+size_t entity_set_get_in_area(entity_set entities, int x0, int y0, int x1, int y1, size_t *out) {
+	size_t found = entity_set_get_in_area_unordered(entities, x0, y0, x1, y1, out);
+
+	/* Insertion sort by position in the list of living entities (few entities are found) */
+	for (size_t k = 1; k < found; ++k) {
+		size_t index = out[k], pos = entity_set_get_position(entities, index);
+
+		size_t j = k;
+		for (; j > 0 && entity_set_get_position(entities, out[j - 1]) > pos; --j)
+			out[j] = out[j - 1];
+		out[j] = index;
+	}
+
+	return found;
+}
+
+/**
+ * @brief Checks if a valid entity is on a lit tile (bounds-checked)
+ * @author A104348 Humberto Gomes
+ */
+int entity_is_lit(int x, int y, int health, const map *map) {
+	return health > 0 && x >= 0 && y >= 0 &&
+	       (unsigned) x < map->width && (unsigned) y < map->height &&
+	       map->data[y * map->width + x].light;
+}
+
+size_t entity_set_get_lit(entity_set entities, const map *map, int x, int y, int radius,
+                          size_t *out) {
+	size_t count = entity_set_get_in_area(entities, x - radius, y - radius, x + radius, y + radius,
+	                                      out);
+
+	size_t lit = 0;
+	for (size_t k = 0; k < count; ++k) {
+		size_t i = out[k];
+		if (entity_is_lit(entities.x[i], entities.y[i], entities.health[i], map))
+			out[lit++] = i;
+	}
+	return lit;
+}
+
+/**
+ * @brief Manhattan distance between the entity of a (valid) handle in @p in and (@p x, @p y)
+ * @author A104348 Humberto Gomes
+ */
+int entity_index_distance(entity_set in, entity_handle handle, int x, int y) {
+	size_t index = handle & ENTITY_HANDLE_INDEX_MASK;
+	return manhattan_distance(in.x[index], in.y[index], x, y);
+}
+
+/**
+ * @brief Inserts an entity handle in a list of handles ordered by distance to a reference position
  * @details Auxiliary function for ::entity_get_closeby
- * @param ent          The entity to be inserted
- * @param dist         The distance of @p ent to the reference entity
- * @param chg          The entity list to be changed
- * @param dists        The list of distances of each entity to the reference entity
+ * @param handle       The handle of the entity to be inserted
+ * @param dist         The distance of the entity to the reference position
+ * @param x            Horizontal reference position
+ * @param y            Vertical reference position
+ * @param in           The set of all entities (to calculate distances of listed entities)
+ * @param chg          The list of indices to be changed
  * @param count        The current number of elements
  * @param can_increase Whether the size of the list can be increased
  *
  * @author A104348 Humberto Gomes
  */
-void entity_insert(entity ent, int dist, entity *chg, int *dists, size_t count, int can_increase) {
+void entity_insert(entity_handle handle, int dist, int x, int y, entity_set in,
+                   entity_handle *chg, size_t count, int can_increase) {
 	if (can_increase) {
 		/* Regular insertion */
 		int i;
-		for (i = count - 1; i >= 0 && dist < dists[i]; --i) {
-			chg[i + 1] = chg[i]; dists[i + 1] = dists[i];
-		}
-		chg [i + 1] = ent; dists[i + 1] = dist;
+		for (i = count - 1; i >= 0 && dist < entity_index_distance(in, chg[i], x, y); --i)
+			chg[i + 1] = chg[i];
+		chg[i + 1] = handle;
 	} else {
 		/* Find insertion position */
 		size_t pos = count;
-		for (int i = count - 1; i >= 0 && dist < dists[i]; --i)
+		for (int i = count - 1; i >= 0 && dist < entity_index_distance(in, chg[i], x, y); --i)
 			pos = i;
 
 		if (pos < count) {
 			/* Discard last element, moving others forward */
-			for (size_t i = count - 1; i > pos; --i) {
-				chg[i] = chg[i - 1]; dists[i] = dists[i - 1];
-			}
+			for (size_t i = count - 1; i > pos; --i)
+				chg[i] = chg[i - 1];
 
 			/* Add current entity */
-			chg[pos] = ent; dists[pos] = dist;
+			chg[pos] = handle;
 		}
 	}
 }
 
-entity_set entity_get_closeby(entity ent, entity_set in, size_t max_count, const map *map) {
-	entity *out = malloc(max_count * sizeof(entity));
-	/* Distances of each outputted entity to the player (for sorting purposes) */
-	int *dists = malloc(max_count * sizeof(int));
+size_t entity_get_closeby(int x, int y, entity_set in, const size_t *candidates,
+                          size_t candidate_count, size_t max_count, entity_handle *out) {
+	PROFILE_START(PROFILE_TIMER_CLOSEBY);
 	size_t out_count = 0;
 
-	for (size_t i = 0; i < in.count; ++i) {
-		entity cur = in.entities[i];
-
-		if (cur.health <= 0) continue;
+	for (size_t k = 0; k < candidate_count; ++k) {
+		size_t i = candidates[k];
+		if (in.health[i] <= 0) continue; /* Killed since the candidates were listed */
 
-		if (map) {
-			/* Ignore out-of-bounds entities */
-			if (cur.x < 0                      || cur.y < 0                        ||
-			    (unsigned) cur.x >= map->width || (unsigned) cur.y >= map->height) continue;
-
-			/* Ignore unlit entities */
-			if (map->data[cur.y * map->width + cur.x].light == 0) continue;
-		}
-
-		int dist = manhattan_distance(cur.x, cur.y, ent.x, ent.y);
+		int dist = manhattan_distance(in.x[i], in.y[i], x, y);
 
 		/* Insert the entity on the output list. */
+		entity_handle handle = entity_set_get_handle(in, i);
 		if (out_count < max_count) {
-			entity_insert(cur, dist, out, dists, out_count, 1);
+			entity_insert(handle, dist, x, y, in, out, out_count, 1);
 			out_count++;
 		} else {
-			entity_insert(cur, dist, out, dists, out_count, 0);
+			entity_insert(handle, dist, x, y, in, out, out_count, 0);
 		}
 	}
 
-	entity_set ret = {
-		.entities = out, .count = out_count
-	};
-	free(dists);
-	return ret;
+	PROFILE_COUNT(PROFILE_COUNTER_ENTITIES_SCANNED, candidate_count);
+	PROFILE_STOP(PROFILE_TIMER_CLOSEBY);
+	return out_count;
 }
 
 /**
@@ -202,20 +518,20 @@ ncurses_char entity_get_render_info(entity_type t) {
 }
 
 void entity_set_render(entity_set entity_set, map map, const map_window *wnd) {
+	const int *x = entity_set.x, *y = entity_set.y, *health = entity_set.health;
 
-	for (size_t i = 0; i < entity_set.count; ++i){
-		entity ent = entity_set.entities[i];
-
-		if (ent.health <= 0) continue; /* Skip invalid entities */
-
-		if (map_window_visible(ent.x, ent.y, wnd) &&
-		    map.data[ent.y * map.width + ent.x].light) {
+	size_t count;
+	const size_t *live = entity_set_get_live(entity_set, &count);
+	for (size_t k = 0; k < count; ++k) {
+		size_t i = live[k];
+		if (health[i] <= 0) continue; /* Skip entities killed this turn */
 
+		if (map_window_visible(x[i], y[i], wnd) && map.data[y[i] * map.width + x[i]].light) {
 			int screenx, screeny;
-			map_window_to_screen(wnd, ent.x, ent.y, &screenx, &screeny);
+			map_window_to_screen(wnd, x[i], y[i], &screenx, &screeny);
 
-			move(screeny, screenx);
-			ncurses_char_print(entity_get_render_info(ent.type));
+			wmove(wnd->win, screeny, screenx);
+			ncurses_char_print(wnd->win, entity_get_render_info(entity_set.type[i]));
 		}
 	}
 }
@@ -223,22 +539,22 @@ void entity_set_render(entity_set entity_set, map map, const map_window *wnd) {
 int entity_set_animate(entity_set entity_set, size_t step_index) {
 	int stop = 1; /* Return value, whether all animations are finished */
 
-	for (size_t i = 0; i < entity_set.count; ++i) {
+	size_t count;
+	const size_t *live = entity_set_get_live(entity_set, &count);
+	for (size_t k = 0; k < count; ++k) {
+		size_t i = live[k];
+		if (entity_set.health[i] <= 0) continue; /* Skip entities killed this turn */
 
-		entity *ent = &entity_set.entities[i];
-
-		if (ent->health <= 0) continue; /* Skip invalid entities */
-
-		if (step_index < ent->animation.length) {
-			ent->x = ent->animation.steps[step_index].x;
-			ent->y = ent->animation.steps[step_index].y;
+		animation_sequence *animation = &entity_set.cold[i].animation;
+		if (step_index < animation->length) {
+			animation_step step = animation_sequence_get_steps(animation)[step_index];
+			entity_set_move(entity_set, i, step.x, step.y);
 		}
 
-		if (step_index + 1 < ent->animation.length) { /* Unfinished animation */
+		if (step_index + 1 < animation->length) { /* Unfinished animation */
 			stop = 0;
 		}
 	}
 
 	return stop;
 }
-
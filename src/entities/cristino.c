@@ -19,8 +19,6 @@
  *   limitations under the License.
  */
 
-#include <stdlib.h>
-#include <time.h>
 #include <entities/cristino.h>
 
 /**
@@ -29,22 +27,27 @@
  * @author A104082 Pedro Pereira
  * @author A104100 Hélder Gomes
 */
-entity entity_create_cristino(unsigned x, unsigned y, int health) {
-	int weapon_index = rand() % 5;
+entity entity_create_cristino(unsigned x, unsigned y, int health, rng *rng) {
+	int weapon_index = rng_range(rng, 5);
 
 	entity cristino = {
 		.x = x,
 		.y = y,
 		.type = ENTITY_CRISTINO,
 
-		.health = health, .max_health = health,
-		.weapon = weapon_index,
+		.health = health,
 
-		.animation = animation_sequence_create(),
-		.combat_target = NULL,
+		.cold = {
+			.max_health = health,
+			.weapon = weapon_index,
 
-		.data = NULL,
-		.destroy = NULL
+			.animation = animation_sequence_create(),
+			.attacking = 0,
+			.combat_target = NULL,
+
+			.data = NULL,
+			.destroy = NULL
+		}
 	};
 
 	return cristino;
@@ -19,8 +19,6 @@
  *   limitations under the License.
  */
 
-#include <stdlib.h>
-#include <time.h>
 #include <entities/goblin.h>
 
 /**
@@ -30,22 +28,27 @@
  * @author A104100 Hélder Gomes
  * @author A104348 Humberto Gomes
 */
-entity entity_create_goblin(unsigned x, unsigned y, int health) {
-	int weapon_index = rand() % 3;
+entity entity_create_goblin(unsigned x, unsigned y, int health, rng *rng) {
+	int weapon_index = rng_range(rng, 3);
 
 	entity goblin = {
 		.x = x,
 		.y = y,
 		.type = ENTITY_GOBLIN,
 
-		.health = health, .max_health = health,
-		.weapon = weapon_index,
+		.health = health,
 
-		.animation = animation_sequence_create(),
-		.combat_target = NULL,
+		.cold = {
+			.max_health = health,
+			.weapon = weapon_index,
 
-		.data = NULL,
-		.destroy = NULL
+			.animation = animation_sequence_create(),
+			.attacking = 0,
+			.combat_target = NULL,
+
+			.data = NULL,
+			.destroy = NULL
+		}
 	};
 
 	return goblin;
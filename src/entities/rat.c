@@ -35,14 +35,19 @@ entity entity_create_rat(unsigned x, unsigned y, int health) {
 		.y = y,
 		.type = ENTITY_RAT,
 
-		.health = health, .max_health = health,
-		.weapon = WEAPON_HAND,
+		.health = health,
 
-		.animation = animation_sequence_create(),
-		.combat_target = NULL,
+		.cold = {
+			.max_health = health,
+			.weapon = WEAPON_HAND,
 
-		.data = NULL,
-		.destroy = NULL
+			.animation = animation_sequence_create(),
+			.attacking = 0,
+			.combat_target = NULL,
+
+			.data = NULL,
+			.destroy = NULL
+		}
 	};
 
 	return rat;
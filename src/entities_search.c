@@ -24,14 +24,35 @@
 #include <core.h>
 #include <game_states/main_game.h>
 #include <entities_search.h>
+#include <profile.h>
+#include <alloc_track.h>
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <ncurses.h>
 
 #define PATH_FINDING_MAXIMUM_DISTANCE 20 /**< This constant defines the maximum distance that can
 be considered during path finding.*/
 
+/** @brief Side of the square around the start of a path that path finding can visit */
+#define PATH_FINDING_WINDOW (2 * (PATH_FINDING_MAXIMUM_DISTANCE + 1) + 1)
+
+/** @brief Number of tiles in the square around the start of a path that path finding can visit */
+#define PATH_FINDING_WINDOW_CELLS (PATH_FINDING_WINDOW * PATH_FINDING_WINDOW)
+
+/** @brief Memory needed by the arrays of a ::path_search (all in the same allocation) */
+#define PATH_SEARCH_BYTES (3 * PATH_FINDING_WINDOW_CELLS * sizeof(uint16_t))
+
+/** @brief Cell not reached by a ::path_search, or no node too far away from its start */
+#define PATH_SEARCH_NONE UINT16_MAX
+
+/**
+ * @brief ::find_nearest_empty_tile scans the whole map after looking at rings with more than
+ *        `2 / NEAREST_EMPTY_TILE_RING_RATIO` times as many tiles as the map
+ */
+#define NEAREST_EMPTY_TILE_RING_RATIO 16
+
 int is_valid_position(map *map, entity_type ent, unsigned x, unsigned y) {
 	if (x < map->width && y < map->height) {
 		tile_type type = map->data[y * map->width + x].type;
@@ -51,7 +72,12 @@ animation_sequence calculate_path(node *end_node) {
 		current_node = current_node->parent;
 	}
 
-	animation_step *path = malloc(sizeof(animation_step) * length);
+	animation_sequence ret = animation_sequence_create();
+	animation_sequence_reserve(NULL, &ret, length);
+	if (ret.capacity < (size_t) length) return ret; /* Allocation failure */
+
+	animation_step *path = animation_sequence_get_steps(&ret);
+	ret.length = length;
 
 	current_node = end_node;
 	int i = length - 1;
@@ -61,16 +87,16 @@ animation_sequence calculate_path(node *end_node) {
 		current_node = current_node->parent;
 	}
 
-	animation_sequence ret = {
-		.steps = path,
-		.length = length,
-		.capacity = length
-	};
-
 	return ret;
 }
 
-animation_step find_nearest_empty_tile(map *map, animation_step pos) {
+/**
+ * @brief Finds the nearest empty tile to a position by scanning the whole map
+ * @details Used by ::find_nearest_empty_tile when the empty tile is far away.
+ *
+ * @author A90817 Mariana Rocha
+ */
+animation_step find_nearest_empty_tile_scan(map *map, animation_step pos) {
 	float min_distance = INFINITY;
 	animation_step nearest_empty_tile = {pos.x,pos.y};
 
@@ -88,84 +114,260 @@ animation_step find_nearest_empty_tile(map *map, animation_step pos) {
 	return nearest_empty_tile;
 }
 
-animation_sequence search_path(map *map, entity_type ent, animation_step start, animation_step end) {
+animation_step find_nearest_empty_tile(map *map, animation_step pos) {
+	/*
+	 * Tiles are looked at in rings of increasing distance around pos. In each ring, they're
+	 * visited from top to bottom and from left to right, so that ties are broken like in a scan
+	 * of the whole map, in row-major order. When the rings get too large, scanning the map
+	 * becomes cheaper.
+	 */
+	int width = map->width, height = map->height;
+	int max_x = pos.x > width  - 1 - pos.x ? pos.x : width  - 1 - pos.x;
+	int max_y = pos.y > height - 1 - pos.y ? pos.y : height - 1 - pos.y;
+
+	for (int distance = 0; distance <= max_x + max_y; distance++) {
+		if ((long) distance * distance > (long) width * height / NEAREST_EMPTY_TILE_RING_RATIO)
+			return find_nearest_empty_tile_scan(map, pos);
+
+		for (int dy = -distance; dy <= distance; dy++) {
+			int y = pos.y + dy;
+			if (y < 0 || y >= height) continue;
+
+			int dx = distance - abs(dy);
+			int xs[2] = { pos.x - dx, pos.x + dx };
+			for (int i = 0; i < (dx ? 2 : 1); i++) {
+				if (xs[i] >= 0 && xs[i] < width &&
+				    map->data[y * width + xs[i]].type == TILE_EMPTY)
+					return (animation_step) { xs[i], y };
+			}
+		}
+	}
+
+	return pos;
+}
 
-	tile_type type = map->data[end.y * map->width + end.x].type;
+/**
+ * @brief   Changes the destination of a path to the nearest tile an entity can be on, if needed
+ * @returns 1 on success, 0 if there's no such tile
+ *
+ * @author A90817 Mariana Rocha
+ * @author A104348 Humberto Gomes
+ */
+int search_path_get_destination(map *map, entity_type ent, animation_step *end) {
+	tile_type type = map->data[end->y * map->width + end->x].type;
 	if ((ent != ENTITY_CRISTINO && type == TILE_WATER) || type == TILE_WALL) {
-		animation_step aux = end;
-		end = find_nearest_empty_tile(map, end);
+		animation_step aux = *end;
+		*end = find_nearest_empty_tile(map, *end);
 		/* TILE_EMPTY not found near */
-		if (end.y == aux.y && end.x == aux.x) {
-			return animation_sequence_create();
-		}
+		if (end->y == aux.y && end->x == aux.x)
+			return 0;
+	}
+	return 1;
+}
+
+path_search path_search_create(void) {
+	path_search ret = {
+		.cells     = NULL,
+		.parents   = NULL,
+		.order     = NULL,
+		.tiles     = NULL,
+		.front     = 0,
+		.back      = 0,
+		.first_far = PATH_SEARCH_NONE
+	};
+	return ret;
+}
+
+void path_search_free(path_search *search) {
+	free(search->cells); /* All arrays are in the same allocation */
+	*search = path_search_create();
+}
+
+/**
+ * @brief Points the arrays of a ::path_search to @p memory (::PATH_SEARCH_BYTES long)
+ * @author A104348 Humberto Gomes
+ */
+void path_search_set_memory(path_search *search, void *memory) {
+	search->cells   = memory;
+	search->parents = search->cells   + PATH_FINDING_WINDOW_CELLS;
+	search->order   = search->parents + PATH_FINDING_WINDOW_CELLS;
+}
+
+/**
+ * @brief Starts a new search from @p start, forgetting the previous one
+ * @author A104348 Humberto Gomes
+ */
+void path_search_restart(path_search *search, map *map, entity_type ent, animation_step start) {
+	if (search->tiles) {
+		/* Only the cells reached by the previous search need to be cleared */
+		for (size_t i = 0; i < search->back; ++i)
+			search->order[search->cells[i]] = PATH_SEARCH_NONE;
+	} else {
+		for (size_t i = 0; i < PATH_FINDING_WINDOW_CELLS; ++i)
+			search->order[i] = PATH_SEARCH_NONE;
 	}
 
+	search->start = start;
+	search->ent   = ent;
+	search->tiles = map->data;
+
+	uint16_t cell = (PATH_FINDING_WINDOW / 2) * PATH_FINDING_WINDOW + PATH_FINDING_WINDOW / 2;
+	search->cells[0]    = cell;
+	search->parents[0]  = 0;
+	search->order[cell] = 0;
+
+	search->front     = 0;
+	search->back      = 1;
+	search->first_far = PATH_SEARCH_NONE;
+}
+
+/**
+ * @brief   Expands nodes of a ::path_search until cell @p goal is reached
+ * @details Stops earlier when no more nodes can be expanded. Nodes are expanded in the same order
+ *          as a search from scratch would, and nodes after the first one too far away from the
+ *          start are never expanded.
+ *
+ * @author A90817 Mariana Rocha
+ * @author A104348 Humberto Gomes
+ */
+void path_search_expand(path_search *search, map *map, size_t goal) {
 	/* Possible directions. */
 	int dx[] = {0, 0, -1, 1};
 	int dy[] = {-1, 1, 0, 0};
 	int width = map->width;
 	int height = map->height;
 
+	animation_step start = search->start;
+	int left = start.x - PATH_FINDING_WINDOW / 2, top = start.y - PATH_FINDING_WINDOW / 2;
 
-	/* Allocate memory for the visited matrix. */
-	int **visited = calloc(height, sizeof(int *));
-	for (int i = 0; i < height; i++) {
-		visited[i] = calloc(width, sizeof(int));
-	}
+	size_t expanded = 0;
+	while (search->order[goal] == PATH_SEARCH_NONE &&
+	       search->front < search->back && search->front != search->first_far) {
 
-	node start_node;
-	start_node.pos = start;
-	start_node.parent = NULL;
+		uint16_t cell = search->cells[search->front];
+		int x = left + cell % PATH_FINDING_WINDOW, y = top + cell / PATH_FINDING_WINDOW;
 
-	node *queue = malloc(sizeof(node) * width * height);
-	int front = 0, back = 0;
-	queue[back++] = start_node;
-	visited[start.y][start.x] = 1; /* If a node was visited it has the corresponding value to 1. */
+		for (int i = 0; i < 4; i++) {
+			int new_x = x + dx[i];
+			int new_y = y + dy[i];
+			uint16_t new_cell = cell + dy[i] * PATH_FINDING_WINDOW + dx[i];
 
-	animation_sequence path = animation_sequence_create();
+			if (new_x >= 0 && new_x < width &&
+			    new_y >= 0 && new_y < height &&
+			    search->order[new_cell] == PATH_SEARCH_NONE &&
+			    is_valid_position(map, search->ent, new_x, new_y)) {
+
+				if (search->first_far == PATH_SEARCH_NONE &&
+				    manhattan_distance(new_x, new_y, start.x, start.y) >
+				    PATH_FINDING_MAXIMUM_DISTANCE)
+					search->first_far = search->back;
+
+				search->order[new_cell]         = search->back;
+				search->cells[search->back]     = new_cell;
+				search->parents[search->back++] = search->front;
+			}
+		}
 
-	while (front < back) {
+		search->front++;
+		expanded++;
+	}
 
-		node current_node = queue[front++];
-		animation_step current_pos = current_node.pos;
+	PROFILE_COUNT(PROFILE_COUNTER_PATH_NODES, expanded);
+}
 
-		if (current_pos.x == end.x && current_pos.y == end.y) {
-			free(path.steps);
-			path = calculate_path(&current_node);
-			break;
-		}
+/**
+ * @brief Builds the path to node @p index of a ::path_search, following its parents
+ * @author A90817 Mariana Rocha
+ * @author A104348 Humberto Gomes
+ */
+animation_sequence path_search_get_path(const path_search *search, uint16_t index) {
+	size_t length = 1;
+	for (uint16_t i = index; i != 0; i = search->parents[i])
+		length++;
 
-		if (manhattan_distance(current_pos.x, current_pos.y, start.x, start.y) > PATH_FINDING_MAXIMUM_DISTANCE)
-			break;
+	animation_sequence ret = animation_sequence_create();
+	animation_sequence_reserve(NULL, &ret, length);
+	if (ret.capacity < length) return ret; /* Allocation failure */
+
+	animation_step *path = animation_sequence_get_steps(&ret);
+	ret.length = length;
+
+	int left = search->start.x - PATH_FINDING_WINDOW / 2;
+	int top  = search->start.y - PATH_FINDING_WINDOW / 2;
+	uint16_t i = index;
+	for (size_t j = length; j > 0; --j) {
+		uint16_t cell = search->cells[i];
+		path[j - 1].x = left + cell % PATH_FINDING_WINDOW;
+		path[j - 1].y = top  + cell / PATH_FINDING_WINDOW;
+		i = search->parents[i];
+	}
 
-		for (int i = 0; i < 4; i++) {
+	return ret;
+}
 
-			int new_x = current_pos.x + dx[i];
-			int new_y = current_pos.y + dy[i];
+/**
+ * @brief Does the work of ::path_search_find (without profiling)
+ * @author A104348 Humberto Gomes
+ */
+animation_sequence path_search_find_path(path_search *search, map *map, entity_type ent,
+                                         animation_step start, animation_step end) {
 
-			if (new_x >= 0 && new_x < width &&
-				  new_y >= 0 && new_y < height &&
-				  !visited[new_y][new_x] && is_valid_position(map, ent, new_x, new_y)) {
+	if (!search_path_get_destination(map, ent, &end))
+		return animation_sequence_create();
 
-				visited[new_y][new_x] = 1;
+	if (!search->cells) {
+		void *memory = malloc(PATH_SEARCH_BYTES);
+		if (!memory) return animation_sequence_create();
+		path_search_set_memory(search, memory);
+	}
 
-				node new_node;
-				new_node.pos.x = new_x;
-				new_node.pos.y = new_y;
+	/* The search only needs to start over if what its tree depends on changed */
+	if (search->tiles != map->data || search->ent != ent ||
+	    search->start.x != start.x || search->start.y != start.y)
+		path_search_restart(search, map, ent, start);
+
+	int goal_x = end.x - (start.x - PATH_FINDING_WINDOW / 2);
+	int goal_y = end.y - (start.y - PATH_FINDING_WINDOW / 2);
+	if (goal_x < 0 || goal_x >= PATH_FINDING_WINDOW || goal_y < 0 || goal_y >= PATH_FINDING_WINDOW)
+		return animation_sequence_create(); /* Never reached */
+
+	size_t goal = goal_y * PATH_FINDING_WINDOW + goal_x;
+	path_search_expand(search, map, goal);
+
+	/* Nodes after the first one too far away are reached, but never expanded */
+	uint16_t index = search->order[goal];
+	if (index != PATH_SEARCH_NONE && index <= search->first_far)
+		return path_search_get_path(search, index);
+	else
+		return animation_sequence_create();
+}
 
-				new_node.parent = &queue[front - 1];
-				queue[back++] = new_node;
-			}
-		}
-	}
+animation_sequence path_search_find(path_search *search, map *map, entity_type ent,
+                                    animation_step start, animation_step end) {
 
-	/* Free memory. */
-	for (int i = 0; i < height; i++) {
-		free(visited[i]);
-	}
-	free(visited);
-	free(queue);
+	PROFILE_START(PROFILE_TIMER_SEARCH_PATH);
+	PROFILE_COUNT(PROFILE_COUNTER_PATH_SEARCHES, 1);
+	ALLOC_TAG_BEGIN(ALLOC_TAG_PATH_FINDING);
 
+	animation_sequence path = path_search_find_path(search, map, ent, start, end);
+
+	PROFILE_STOP(PROFILE_TIMER_SEARCH_PATH);
+	ALLOC_TAG_END();
 	return path;
 }
 
+animation_sequence search_path(map *map, entity_type ent, animation_step start, animation_step end,
+                               arena *scratch) {
+
+	/* A search that isn't kept, with temporary data in the scratch arena */
+	arena_mark mark = arena_get_mark(scratch);
+	void *memory = arena_alloc(scratch, PATH_SEARCH_BYTES);
+	if (!memory) return animation_sequence_create();
+
+	path_search search = path_search_create();
+	path_search_set_memory(&search, memory);
+	animation_sequence path = path_search_find(&search, map, ent, start, end);
+
+	arena_restore(scratch, mark);
+	return path;
+}
@@ -20,13 +20,80 @@
  */
 
 #include <game_loop.h>
+#include <trace.h>
+#include <alloc_track.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 #include <signal.h>
 #include <ncurses.h>
 
+/**
+ * @struct game_loop_terminal
+ * @brief Terminal input and output configuration, set in ::game_loop_init_ncurses
+ *
+ * @var game_loop_terminal::backend
+ *   How the screen is output to the terminal
+ * @var game_loop_terminal::ansi
+ *   The ANSI backend (`NULL` when using ::GAME_LOOP_BACKEND_NCURSES)
+ * @var game_loop_terminal::render
+ *   The render thread (`NULL` unless using ::GAME_LOOP_BACKEND_ANSI_THREADED)
+ * @var game_loop_terminal::input
+ *   Window where input is read from. It's never drawn to, so that `wgetch()` never calls
+ *   `wrefresh()` implicitly (which would output `newscr` with ncurses).
+ *
+ * @var game_loop_terminal::ansi_stats
+ *   Output statistics of ::game_loop_terminal::ansi, saved when it's freed
+ * @var game_loop_terminal::render_stats
+ *   Statistics of ::game_loop_terminal::render, saved when it's freed
+ *
+ * @author A104348 Humberto Gomes
+ */
+static struct {
+	game_loop_backend backend;
+	ansi_term *ansi;
+	render_thread *render;
+	WINDOW *input;
+
+	ansi_term_stats ansi_stats;
+	render_thread_stats render_stats;
+} game_loop_terminal = {
+	.backend = GAME_LOOP_BACKEND_NCURSES,
+	.ansi = NULL, .render = NULL, .input = NULL
+};
+
+/**
+ * @struct game_loop_session
+ * @brief Input recording / replaying and frame statistics
+ *
+ * @var game_loop_session::record
+ *   Where input is recorded to or replayed from (`NULL` for neither)
+ * @var game_loop_session::replaying
+ *   Whether ::game_loop_session::record is being replayed (instead of recorded)
+ * @var game_loop_session::start
+ *   When recording started
+ * @var game_loop_session::fixed_timestep
+ *   Time passed to update callbacks every frame (`0` for the real elapsed time)
+ *
+ * @var game_loop_session::stats
+ *   Timing statistics (::game_loop_frame_stats::frames is also the index of the current frame)
+ *
+ * @author A104348 Humberto Gomes
+ */
+static struct {
+	input_record *record;
+	int replaying;
+	struct timespec start;
+	double fixed_timestep;
+
+	game_loop_frame_stats stats;
+} game_loop_session = {
+	.record = NULL, .replaying = 0, .fixed_timestep = 0,
+	.stats = { .frames = 0, .total_time = 0, .worst_time = 0 }
+};
+
 /**
  * @brief A game loop helper function to ignore a given signal.
  * @returns 0 on success, other value on error
@@ -42,7 +109,7 @@ int game_loop_ignore_signal(int signum) {
 	return sigaction(signum, &act, NULL);
 }
 
-int game_loop_init_ncurses(void) {
+int game_loop_init_ncurses(game_loop_backend backend) {
 	if (initscr()           == NULL) return 1;
 	if (start_color()        == ERR) return 1; /* Enable color support */
 	if (cbreak()             == ERR) return 1; /* Disable line buffering and control characters */
@@ -52,6 +119,12 @@ int game_loop_init_ncurses(void) {
 	if (keypad(stdscr, 1)    == ERR) return 1; /* Let ncurses parse escape sequences */
 	if (curs_set(0)          == ERR) return 1; /* Hide the cursor */
 
+	/* Input window (see game_loop_terminal) */
+	game_loop_terminal.input = newwin(1, 1, 0, 0);
+	if (game_loop_terminal.input                == NULL) return 1;
+	if (nodelay(game_loop_terminal.input, 1)    == ERR)  return 1;
+	if (keypad(game_loop_terminal.input, 1)     == ERR)  return 1;
+
 	/* Limit of 10ms for ncurses to give up on finding characters for escape sequences */
 	ESCDELAY = 10;
 
@@ -64,6 +137,48 @@ int game_loop_init_ncurses(void) {
 	for (int col = COLOR_BLACK; col <= COLOR_WHITE; ++col)
 		init_pair(col, col, COLOR_BLACK);
 
+	game_loop_terminal.backend = backend;
+	if (backend != GAME_LOOP_BACKEND_NCURSES) {
+		game_loop_terminal.ansi = ansi_term_create(STDOUT_FILENO);
+		if (!game_loop_terminal.ansi) return 1;
+	}
+
+	if (backend == GAME_LOOP_BACKEND_ANSI_THREADED) {
+		game_loop_terminal.render = render_thread_create(game_loop_terminal.ansi);
+		if (!game_loop_terminal.render) return 1;
+	}
+
+	return 0;
+}
+
+int game_loop_refresh(void) {
+	if (wnoutrefresh(stdscr) == ERR) return 1;
+	return game_loop_doupdate();
+}
+
+int game_loop_doupdate(void) {
+	switch (game_loop_terminal.backend) {
+		case GAME_LOOP_BACKEND_ANSI:
+			return ansi_term_present_window(game_loop_terminal.ansi, newscr);
+		case GAME_LOOP_BACKEND_ANSI_THREADED:
+			return render_thread_publish_window(game_loop_terminal.render, newscr);
+		default:
+			return doupdate() == ERR;
+	}
+}
+
+int game_loop_ansi_stats(ansi_term_stats *out) {
+	if (game_loop_terminal.backend == GAME_LOOP_BACKEND_NCURSES || game_loop_terminal.ansi)
+		return 1;
+	*out = game_loop_terminal.ansi_stats;
+	return 0;
+}
+
+int game_loop_render_thread_stats(render_thread_stats *out) {
+	if (game_loop_terminal.backend != GAME_LOOP_BACKEND_ANSI_THREADED ||
+	    game_loop_terminal.render)
+		return 1;
+	*out = game_loop_terminal.render_stats;
 	return 0;
 }
 
@@ -79,6 +194,23 @@ double timespec_dif(struct timespec start, struct timespec end) {
 	return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
 }
 
+void game_loop_record_input(input_record *rec) {
+	game_loop_session.record = rec;
+	game_loop_session.replaying = 0;
+	game_loop_session.fixed_timestep = 1.0 / input_record_get_fps(rec);
+	clock_gettime(CLOCK_MONOTONIC, &game_loop_session.start);
+}
+
+void game_loop_replay_input(input_record *rec) {
+	game_loop_session.record = rec;
+	game_loop_session.replaying = 1;
+	game_loop_session.fixed_timestep = 1.0 / input_record_get_fps(rec);
+}
+
+game_loop_frame_stats game_loop_get_frame_stats(void) {
+	return game_loop_session.stats;
+}
+
 /**
  * @brief Internal game loop function for keeping the terminal window size up to date.
  *
@@ -105,6 +237,54 @@ game_loop_callback_return_value game_loop_window_size(void *state, int *width, i
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
 
+/**
+ * @brief Internal game loop function for adding a key to the input being recorded
+ * @details Recording errors are ignored, so that they never interrupt the game.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void game_loop_record_key(int key) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	input_record_event event = {
+		.frame = game_loop_session.stats.frames,
+		.time_us = timespec_dif(game_loop_session.start, now) * 1e6,
+		.key = key
+	};
+	input_record_write(game_loop_session.record, event);
+}
+
+/**
+ * @brief Internal game loop function for feeding the keys recorded in this frame to the game
+ *
+ * @returns The return value of the input callback in case of a loop exit request, or
+ *          ::GAME_LOOP_CALLBACK_RETURN_BREAK when there are no more keys to replay. Otherwise,
+ *          ::GAME_LOOP_CALLBACK_RETURN_SUCCESS is returned.
+ *
+ * @author A104348 Humberto Gomes
+ */
+game_loop_callback_return_value game_loop_replay_frame_input
+	(void *state, game_loop_input_callback oninput) {
+
+	while (wgetch(game_loop_terminal.input) != ERR); /* Ignore the keyboard */
+
+	input_record_event event;
+	if (input_record_peek(game_loop_session.record, &event))
+		return GAME_LOOP_CALLBACK_RETURN_BREAK; /* End of the recording */
+
+	while (event.frame <= game_loop_session.stats.frames) {
+		input_record_next(game_loop_session.record);
+
+		int ret = oninput(state, event.key);
+		if (ret != GAME_LOOP_CALLBACK_RETURN_SUCCESS) return ret;
+
+		if (input_record_peek(game_loop_session.record, &event)) break;
+	}
+
+	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
+}
+
 /**
  * @brief Internal game loop function for reading input and calling the callback if needed
  *
@@ -117,12 +297,20 @@ game_loop_callback_return_value game_loop_handle_input
 	(void *state, game_loop_input_callback oninput) {
 
 	if (oninput) { /* Skip reading input if no input callback is defined */
-		int c = getch();
+		/* Resizes touch every window. Don't let wgetch() refresh the input window */
+		untouchwin(game_loop_terminal.input);
+
+		if (game_loop_session.replaying)
+			return game_loop_replay_frame_input(state, oninput);
+
+		int c = wgetch(game_loop_terminal.input);
 		while (c != ERR) {
+			if (game_loop_session.record) game_loop_record_key(c);
+
 			int ret = oninput(state, c);
 			if (ret != GAME_LOOP_CALLBACK_RETURN_SUCCESS) return ret;
 
-			c = getch();
+			c = wgetch(game_loop_terminal.input);
 		}
 	}
 
@@ -158,6 +346,25 @@ int game_loop_keep_fps(struct timespec frame_start, double frame_time) {
 	return 0;
 }
 
+/**
+ * @brief Internal game loop function for updating frame statistics at the end of a frame
+ * @returns 0 on success, 1 on error.
+ *
+ * @author A104348 Humberto Gomes
+ */
+int game_loop_frame_end(struct timespec frame_start) {
+	struct timespec frame_end;
+	if (clock_gettime(CLOCK_MONOTONIC, &frame_end)) return 1;
+	double delta = timespec_dif(frame_start, frame_end);
+
+	game_loop_frame_stats *stats = &game_loop_session.stats;
+	stats->frames++;
+	stats->total_time += delta;
+	if (delta > stats->worst_time) stats->worst_time = delta;
+
+	return 0;
+}
+
 /**
  * @brief Helper macro for ::game_loop_run that, based on the return value of a callback,
  *        determines whether to continue looping and the game loop's return value (if needed).
@@ -186,20 +393,36 @@ int game_loop_run(void *state, game_loop_callbacks *callbacks, unsigned int fps)
 		if (clock_gettime(CLOCK_MONOTONIC, &frame_instant)) return 1;
 		double delta = timespec_dif(last_frame_instant, frame_instant);
 		last_frame_instant = frame_instant;
+		if (game_loop_session.fixed_timestep) delta = game_loop_session.fixed_timestep;
+
+		TRACE_BEGIN("Frame");
 
 		/* Keep terminal window size up to date */
+		TRACE_BEGIN("Resize");
 		int ret = game_loop_window_size(state, &width, &height, callbacks->onresize);
+		TRACE_END("Resize");
 		game_loop_return(ret);
 
+		TRACE_BEGIN("Input");
 		ret = game_loop_handle_input(state, callbacks->oninput);
+		TRACE_END("Input");
 		game_loop_return(ret);
 
+		TRACE_BEGIN("Update");
 		if (callbacks->onupdate) ret = callbacks->onupdate(state, delta);
+		TRACE_END("Update");
 		game_loop_return(ret);
 
+		TRACE_BEGIN("Render");
+		ALLOC_TAG_BEGIN(ALLOC_TAG_RENDERING);
 		if (callbacks->onrender) ret = callbacks->onrender(state, width, height);
+		ALLOC_TAG_END();
+		TRACE_END("Render");
 		game_loop_return(ret);
 
+		if (game_loop_frame_end(frame_instant)) return 1;
+		ALLOC_TRACK_END_FRAME();
+		TRACE_END("Frame");
 		if (game_loop_keep_fps(frame_instant, frame_time)) return 1;
 	}
 
@@ -208,6 +431,28 @@ int game_loop_run(void *state, game_loop_callbacks *callbacks, unsigned int fps)
 
 int game_loop_terminate_ncurses(void) {
 	attrset(A_NORMAL);
+
+	if (game_loop_terminal.render) {
+		game_loop_terminal.render_stats = render_thread_get_stats(game_loop_terminal.render);
+		render_thread_free(game_loop_terminal.render);
+		game_loop_terminal.render = NULL;
+	}
+
+	if (game_loop_terminal.ansi) {
+		game_loop_terminal.ansi_stats = ansi_term_get_stats(game_loop_terminal.ansi);
+		ansi_term_free(game_loop_terminal.ansi);
+		game_loop_terminal.ansi = NULL;
+
+		/* ncurses doesn't know where the cursor is. Don't let it leave it in the middle */
+		printf("\x1b[%dH", LINES);
+		fflush(stdout);
+	}
+
+	if (game_loop_terminal.input) {
+		delwin(game_loop_terminal.input);
+		game_loop_terminal.input = NULL;
+	}
+
 	return endwin() == ERR; /* Restore previous terminal mode */
 }
 
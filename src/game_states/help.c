@@ -102,7 +102,7 @@ game_loop_callback_return_value state_help_onrender(void *s, int width, int heig
 	move(height - 2, (width - len) / 2);
 	printw("%s", esc_message);
 
-	refresh();
+	game_loop_refresh();
 
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
@@ -21,6 +21,8 @@
 
 #include <core.h>
 #include <map.h>
+#include <game_states/illumination.h>
+#include <profile.h>
 
 #include <stdlib.h>
 #include <math.h>
@@ -36,8 +38,9 @@
  * @param yp The vertical position of the player
  * @param m  The game map
  *
- * @note This function, even though large, is inlined because it is only called from a single place
- *       in the program (::state_main_game_circle_light_map).
+ * @note This function, even though large, is inlined because it is only called from two places
+ *       in the program (::state_main_game_circle_light_map and
+ *       ::state_main_game_circle_light_mask).
  *
  * @author A104100 Hélder Gomes
  */
@@ -81,7 +84,9 @@ INLINE int illumination_check_line_of_sight(int x, int y, int xp, int yp, map m)
 }
 
 void state_main_game_circle_light_map(map m, int x, int y, int r) {
-	int rsquared = r * r;
+	PROFILE_START(PROFILE_TIMER_LIGHT);
+
+	int rsquared = r * r, lit = 0;
 	for (int yp = y - r; yp <= y + r; ++yp) {
 		int disty = (yp - y) * (yp - y);
 		for (int xp = x - r; xp <= x + r; ++xp) {
@@ -90,12 +95,16 @@ void state_main_game_circle_light_map(map m, int x, int y, int r) {
 			if (0 <= xp && xp < (int) m.width && 0 <= yp && yp < (int) m.height) {
 				if ((xp - x) * (xp - x) + disty <= rsquared) {
 
-					m.data[yp * m.width + xp].light = illumination_check_line_of_sight(
-						x, y, xp, yp, m);
+					int light = illumination_check_line_of_sight(x, y, xp, yp, m);
+					m.data[yp * m.width + xp].light = light;
+					lit += light;
 				}
 			}
 		}
 	}
+
+	PROFILE_COUNT(PROFILE_COUNTER_TILES_LIT, lit);
+	PROFILE_STOP(PROFILE_TIMER_LIGHT);
 }
 
 void state_main_game_circle_clean_light_map(map m, int x, int y, int r) {
@@ -105,3 +114,41 @@ void state_main_game_circle_clean_light_map(map m, int x, int y, int r) {
 				m.data[yp * m.width + xp].light = 0;
 }
 
+
+void state_main_game_circle_light_mask(map m, int x, int y, int r, uint8_t *mask) {
+	int rsquared = r * r, side = 2 * r + 1;
+	for (int i = 0; i < LIGHT_MASK_BYTES(r); ++i)
+		mask[i] = 0;
+
+	for (int yp = y - r; yp <= y + r; ++yp) {
+		int disty = (yp - y) * (yp - y);
+		for (int xp = x - r; xp <= x + r; ++xp) {
+			if (0 <= xp && xp < (int) m.width && 0 <= yp && yp < (int) m.height &&
+			    (xp - x) * (xp - x) + disty <= rsquared &&
+			    illumination_check_line_of_sight(x, y, xp, yp, m)) {
+
+				int bit = (yp - y + r) * side + (xp - x + r);
+				mask[bit / 8] |= 1 << (bit % 8);
+			}
+		}
+	}
+}
+
+void state_main_game_circle_apply_light_mask(map m, int x, int y, int r, const uint8_t *mask) {
+	int rsquared = r * r, side = 2 * r + 1, lit = 0;
+	for (int yp = y - r; yp <= y + r; ++yp) {
+		int disty = (yp - y) * (yp - y);
+		for (int xp = x - r; xp <= x + r; ++xp) {
+			if (0 <= xp && xp < (int) m.width && 0 <= yp && yp < (int) m.height &&
+			    (xp - x) * (xp - x) + disty <= rsquared) {
+
+				int bit = (yp - y + r) * side + (xp - x + r);
+				int light = (mask[bit / 8] >> (bit % 8)) & 1;
+				m.data[yp * m.width + xp].light = light;
+				lit += light;
+			}
+		}
+	}
+
+	PROFILE_COUNT(PROFILE_COUNTER_TILES_LIT, lit);
+}
@@ -93,7 +93,7 @@ game_loop_callback_return_value state_leaderboard_onrender(void *s, int width, i
 	move(height - 2, (width - len) / 2);
 	printw("%s", esc_message);
 
-	refresh();
+	game_loop_refresh();
 
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
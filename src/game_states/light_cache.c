@@ -0,0 +1,99 @@
+/**
+ * @file light_cache.c
+ * @brief Light of the player's planned path, calculated before the player moves
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <alloc_track.h>
+#include <game_states/illumination.h>
+#include <game_states/light_cache.h>
+#include <profile.h>
+
+#include <stdlib.h>
+
+light_cache light_cache_create(int radius) {
+	light_cache ret = {
+		.x = NULL, .y = NULL, .masks = NULL,
+		.count = 0, .capacity = 0,
+		.radius = radius
+	};
+	return ret;
+}
+
+void light_cache_free(light_cache cache) {
+	free(cache.x);
+	free(cache.y);
+	free(cache.masks);
+}
+
+/**
+ * @brief Makes a ::light_cache able to hold (at least) @p capacity entries
+ * @returns 0 on success, 1 on allocation failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int light_cache_reserve(light_cache *cache, size_t capacity) {
+	if (capacity <= cache->capacity) return 0;
+	if (capacity < 2 * cache->capacity) capacity = 2 * cache->capacity;
+
+	ALLOC_TAG_BEGIN(ALLOC_TAG_LIGHTING);
+	int *x = realloc(cache->x, capacity * sizeof(int));
+	if (x) cache->x = x;
+	int *y = realloc(cache->y, capacity * sizeof(int));
+	if (y) cache->y = y;
+	uint8_t *masks = realloc(cache->masks, capacity * LIGHT_MASK_BYTES(cache->radius));
+	if (masks) cache->masks = masks;
+	ALLOC_TAG_END();
+
+	if (!x || !y || !masks) return 1;
+	cache->capacity = capacity;
+	return 0;
+}
+
+int light_cache_warm(light_cache *cache, map m, animation_sequence *path, size_t max_steps) {
+	/* Entries past the end of the path are thrown away */
+	if (cache->count > path->length) cache->count = path->length;
+	if (light_cache_reserve(cache, path->length)) return 0;
+
+	const animation_step *steps = animation_sequence_get_steps(path);
+	size_t calculated = 0, i;
+	for (i = 0; i < path->length; ++i) {
+		if (i < cache->count && cache->x[i] == steps[i].x && cache->y[i] == steps[i].y)
+			continue; /* Still valid */
+		if (calculated == max_steps) break;
+
+		cache->x[i] = steps[i].x;
+		cache->y[i] = steps[i].y;
+		state_main_game_circle_light_mask(m, steps[i].x, steps[i].y, cache->radius,
+			cache->masks + i * LIGHT_MASK_BYTES(cache->radius));
+		if (i == cache->count) cache->count++;
+		calculated++;
+	}
+
+	PROFILE_COUNT(PROFILE_COUNTER_LIGHT_MASKS, calculated);
+	return i == path->length;
+}
+
+int light_cache_apply(const light_cache *cache, map m, size_t step, int x, int y) {
+	if (step >= cache->count || cache->x[step] != x || cache->y[step] != y) return 0;
+
+	state_main_game_circle_apply_light_mask(m, x, y, cache->radius,
+		cache->masks + step * LIGHT_MASK_BYTES(cache->radius));
+	PROFILE_COUNT(PROFILE_COUNTER_LIGHT_CACHED, 1);
+	return 1;
+}
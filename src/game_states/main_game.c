@@ -31,13 +31,48 @@
 
 #include <generate_map.h>
 #include <entities_search.h>
+#include <trace.h>
 
 #include <time.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <ncurses.h>
 
+/** @brief Initial capacity (in bytes) of the scratch arena of a game */
+#define MAIN_GAME_SCRATCH_CAPACITY (64 * 1024)
+
+/** @brief Maximum number of steps of the player's path lit ahead of time per frame */
+#define MAIN_GAME_PATH_LIGHT_STEPS 8
+
+/**
+ * @brief Seeds for new games (see ::state_main_game_set_seed)
+ *
+ * @var state_main_game_seeds::fixed
+ *   Whether seeds are fixed (not time-based)
+ * @var state_main_game_seeds::next
+ *   Next fixed seed
+ *
+ * @author A104348 Humberto Gomes
+ */
+static struct {
+	int fixed;
+	unsigned int next;
+} state_main_game_seeds = { .fixed = 0, .next = 0 };
+
+void state_main_game_set_seed(unsigned int seed) {
+	state_main_game_seeds.fixed = 1;
+	state_main_game_seeds.next = seed;
+}
+
+unsigned int state_main_game_next_seed(void) {
+	if (state_main_game_seeds.fixed)
+		return state_main_game_seeds.next++;
+	else
+		return time(NULL);
+}
+
 /**
  * @brief Is called when the game over message is left
  * @author A104348 Humberto Gomes
@@ -48,7 +83,7 @@ void state_main_game_over_callback(void *s, int button) {
 	if (button == 0) { /* Leave button */
 		state->must_leave = 1;
 	} else { /* Play again */
-		game_state new = state_main_game_create(state->score.name);
+		game_state new = state_main_game_create(state->score.name, state_main_game_next_seed());
 		state_switch((game_state *) s, &new, 1);
 	}
 }
@@ -58,6 +93,7 @@ void state_main_game_over_callback(void *s, int button) {
  * @author A104348 Humberto Gomes
  */
 void state_main_game_over(game_state *state) {
+	state_extract_data(state_main_game_data, state)->needs_rerender = MAIN_GAME_REDRAW_ALL;
 	const char *buttons[2] = { "Leave", "Retry" };
 	game_state msg = state_msg_box_create(*state, state_main_game_over_callback,
 	                                      "Game over", buttons, 2, 0);
@@ -72,8 +108,8 @@ void state_main_drop_weapon_callback(void *s, int button) {
 	state_main_game_data *state = state_extract_data(state_main_game_data, s);
 
 	if (button == 1) { /* Picked up */
-		entity_free_combat_target(&PLAYER(state));
-		PLAYER(state).weapon = state->dropped;
+		entity_free_combat_target(state->entities, PLAYER_INDEX);
+		PLAYER_COLD(state).weapon = state->dropped;
 	}
 
 	state->dropped = WEAPON_INVALID; /* Don't show drop message next time */
@@ -91,6 +127,7 @@ void state_main_drop_weapon_message(game_state *state) {
 	char message[128];
 	state_main_game_data *data = state_extract_data(state_main_game_data, state);
 	sprintf(message, "A mob you killed dropped \"%s\"", weapon_get_name(data->dropped));
+	data->needs_rerender = MAIN_GAME_REDRAW_ALL;
 
 	game_state msg = state_msg_box_create(*state, state_main_drop_weapon_callback, message,
 	                                      buttons, 2, 0);
@@ -107,9 +144,10 @@ void state_main_drop_food_message(game_state *state) {
 	const char *message = "A mob you killed dropped food. Your health was restored.";
 
 	state_main_game_data *data = state_extract_data(state_main_game_data, state);
-	PLAYER(data).health = PLAYER(data).max_health;
+	PLAYER_HEALTH(data) = PLAYER_COLD(data).max_health;
 	data->dropped = WEAPON_INVALID; /* Don't show drop message next time */
 	data->dropped_food = 0;
+	data->needs_rerender = MAIN_GAME_REDRAW_ALL;
 
 	game_state msg = state_msg_box_create(*state, NULL, message, &button, 1, 0);
 	state_switch(state, &msg, 0);
@@ -142,15 +180,20 @@ game_loop_callback_return_value state_main_game_onupdate(void *s, double elapsed
 		state->renders_count = 0;
 
 		state->elapsed_fps -= 1.0;
-		state->needs_rerender = 1; /* Update the number on the screen */
+		state->needs_rerender |= MAIN_GAME_REDRAW_STATS; /* Update the numbers on the screen */
 	}
 
 	state->fps_count++;
-	state->renders_count += state->needs_rerender;
+	state->renders_count += state->needs_rerender != 0;
 
 	state_main_game_animate((game_state *) s, elapsed);
 
-	if (PLAYER(state).health <= 0) {
+	/* While waiting for the player to confirm their path, light it ahead of time */
+	if (state->action == MAIN_GAME_MOVEMENT_INPUT)
+		light_cache_warm(&state->path_light, state->map, &PLAYER_COLD(state).animation,
+			MAIN_GAME_PATH_LIGHT_STEPS);
+
+	if (PLAYER_HEALTH(state) <= 0) {
 		/* Save high score */
 		score_list l;
 		score_list_load(&l);
@@ -179,6 +222,7 @@ void state_main_game_msg_box_callback(void *s, int button) {
 
 /** @brief Uses a message box to ask the user if they want to leave the game */
 void state_main_game_exit_confirmation(game_state *state) {
+	state_extract_data(state_main_game_data, state)->needs_rerender = MAIN_GAME_REDRAW_ALL;
 	const char *buttons[2] = { "Cancel", "OK" };
 	game_state msg = state_msg_box_create(*state, state_main_game_msg_box_callback,
 	                                      "Leave the game?", buttons, 2, 0);
@@ -198,18 +242,18 @@ game_loop_callback_return_value state_main_game_oninput(void *s, int key) {
 	switch (key) {
 		case '\x1b': /* Escape */
 			if (state->action == MAIN_GAME_MOVEMENT_INPUT &&
-			    PLAYER(state).animation.length > 0) {
+			    PLAYER_COLD(state).animation.length > 0) {
 
 				/* Reset player movement */
-				PLAYER(state).animation.length = 0;
+				PLAYER_COLD(state).animation.length = 0;
 			}
 			else if (state->action == MAIN_GAME_COMBAT_INPUT &&
-			         !(state->cursorx == PLAYER(state).x &&
-			           state->cursory == PLAYER(state).y)) {
+			         !(state->cursorx == PLAYER_X(state) &&
+			           state->cursory == PLAYER_Y(state))) {
 
 				/* Reset cursor position */
-				state->cursorx = PLAYER(state).x;
-				state->cursory = PLAYER(state).y;
+				state->cursorx = PLAYER_X(state);
+				state->cursory = PLAYER_Y(state);
 			} else {
 				/* Ask to leave game */
 				state_main_game_exit_confirmation((game_state *) s);
@@ -218,17 +262,20 @@ game_loop_callback_return_value state_main_game_oninput(void *s, int key) {
 
 		case '\r': /* Enter */
 			if (state->action == MAIN_GAME_MOVEMENT_INPUT) {
-				state->action = MAIN_GAME_ANIMATING_PLAYER_MOVEMENT;
+				state_main_game_set_action(state, MAIN_GAME_ANIMATING_PLAYER_MOVEMENT);
 			} else if (state->action == MAIN_GAME_COMBAT_INPUT) {
 				state_main_game_attack_cursor(state, (game_state *) s);
-				state_main_game_mobs_run_ai(state);
+
+				/* Mobs plan their turn while the attack is animated */
+				if (state->action == MAIN_GAME_ANIMATING_PLAYER_COMBAT)
+					state_main_game_mobs_start_ai(state, 1);
 			}
 			break;
 
 		case 's': case 'S': /* Skip player combat */
 			if (state->action == MAIN_GAME_COMBAT_INPUT) {
 				state_main_game_mobs_run_ai(state);
-				state->action = MAIN_GAME_ANIMATING_MOBS_MOVEMENT;
+				state_main_game_set_action(state, MAIN_GAME_ANIMATING_MOBS_MOVEMENT);
 			}
 			break;
 
@@ -247,11 +294,12 @@ game_loop_callback_return_value state_main_game_oninput(void *s, int key) {
 			break;
 	}
 
-	state->needs_rerender = 1;
+	/* The path, cursor and tips may have changed */
+	state->needs_rerender |= MAIN_GAME_REDRAW_MAP | MAIN_GAME_REDRAW_TIPS;
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
 
-game_state state_main_game_create(char name[SCORE_NAME_MAX + 1]) {
+game_state state_main_game_create(char name[SCORE_NAME_MAX + 1], unsigned int seed) {
 	state_main_game_data data = {
 		.fps_show     = 0, .fps_count     = 0,
 		.renders_show = 0, .renders_count = 0,
@@ -259,16 +307,32 @@ game_state state_main_game_create(char name[SCORE_NAME_MAX + 1]) {
 
 		.must_leave = 0,
 
-		.needs_rerender = 1,
-		.overlay = NULL,
+		.needs_rerender = MAIN_GAME_REDRAW_ALL,
+		.windows = { .sidebar = NULL, .map = NULL, .tips = { NULL, NULL } },
+		.overlay = combat_overlay_create(),
 
 		.score = { .score = 0 },
 		.dropped = WEAPON_INVALID,
 		.dropped_food = 0,
+		.kills = { 0 },
+
+		.rng = rng_create(seed, 0),
+		.scratch = arena_create(MAIN_GAME_SCRATCH_CAPACITY),
 
 		.action = MAIN_GAME_MOVEMENT_INPUT,
 		.animation_step = 0,
 		.time_since_last_animation = 0,
+
+		.closeby = NULL,
+		.closeby_count = 0, .closeby_capacity = 0,
+		.closeby_valid = 0,
+
+		.lit = NULL,
+		.lit_count = 0,
+		.acting = NULL,
+		.acting_count = 0,
+		.ai = mob_ai_job_create(),
+		.turn = 0
 	};
 
 	strcpy(data.score.name, name);
@@ -278,11 +342,20 @@ game_state state_main_game_create(char name[SCORE_NAME_MAX + 1]) {
 	data.cursorx = data.map.width  / 2;
 	data.cursory = data.map.height / 2;
 
-	state_main_game_circle_light_map(
-		data.map, PLAYER(&data).x, PLAYER(&data).y, CIRCLE_RADIUS);
+	data.lit    = malloc(data.entities.capacity * sizeof(size_t));
+	data.acting = malloc(data.entities.capacity * sizeof(size_t));
+	data.paths  = malloc(data.entities.capacity * sizeof(path_search));
+	if (data.paths)
+		for (size_t i = 0; i < data.entities.capacity; ++i)
+			data.paths[i] = path_search_create();
+	data.lod = mob_lod_grid_create(&data.map);
+	data.wake = mob_wake_set_create(data.entities.capacity);
+	data.path_light = light_cache_create(CIRCLE_RADIUS);
+	state_main_game_light(&data);
 
 	state_main_game_data *data_ptr = malloc(sizeof(state_main_game_data));
 	*data_ptr = data;
+	TRACE_ASYNC_BEGIN(state_main_game_action_get_name(data.action), (uintptr_t) data_ptr);
 
 	game_loop_callbacks callbacks = {
 		.oninput  = state_main_game_oninput,
@@ -301,12 +374,66 @@ game_state state_main_game_create(char name[SCORE_NAME_MAX + 1]) {
 
 void state_main_game_destroy(game_state* state) {
 	state_main_game_data *game_data = state_extract_data(state_main_game_data, state);
+	TRACE_ASYNC_END(state_main_game_action_get_name(game_data->action), (uintptr_t) game_data);
 
+	mob_ai_job_free(game_data->ai); /* Before anything its thread may be reading is freed */
 	map_free(game_data->map);
 	entity_set_free(game_data->entities);
-	if (game_data->overlay)
-		free(game_data->overlay);
+	free(game_data->lit);
+	free(game_data->acting);
+	if (game_data->paths)
+		for (size_t i = 0; i < game_data->entities.capacity; ++i)
+			path_search_free(&game_data->paths[i]);
+	free(game_data->paths);
+	mob_lod_grid_free(game_data->lod);
+	mob_wake_set_free(game_data->wake);
+	light_cache_free(game_data->path_light);
+	combat_overlay_free(game_data->overlay);
+	free(game_data->closeby);
+	arena_free(&game_data->scratch);
+	state_main_game_free_windows(&game_data->windows);
 
 	free(state->data);
 }
 
+
+const char *state_main_game_action_get_name(state_main_game_action action) {
+	switch (action) {
+		case MAIN_GAME_MOVEMENT_INPUT:
+			return "Movement input";
+		case MAIN_GAME_ANIMATING_PLAYER_MOVEMENT:
+			return "Player movement";
+		case MAIN_GAME_COMBAT_INPUT:
+			return "Combat input";
+		case MAIN_GAME_ANIMATING_PLAYER_COMBAT:
+			return "Player combat";
+		case MAIN_GAME_ANIMATING_MOBS_MOVEMENT:
+			return "Mobs movement";
+		case MAIN_GAME_ANIMATING_MOBS_COMBAT:
+			return "Mobs combat";
+		default:
+			return "Unknown";
+	}
+}
+
+void state_main_game_light(state_main_game_data *state) {
+	state_main_game_circle_light_map(state->map, PLAYER_X(state), PLAYER_Y(state), CIRCLE_RADIUS);
+	state_main_game_update_lit(state);
+}
+
+void state_main_game_update_lit(state_main_game_data *state) {
+	state->lit_count = entity_set_get_lit(state->entities, &state->map,
+		PLAYER_X(state), PLAYER_Y(state), CIRCLE_RADIUS, state->lit);
+	state->closeby_valid = 0; /* Entities may have moved, died, or become visible */
+}
+
+void state_main_game_set_action(state_main_game_data *state, state_main_game_action action) {
+	if (action == MAIN_GAME_ANIMATING_MOBS_MOVEMENT)
+		state_main_game_mobs_finish_ai(state); /* Mobs can't move before their plans are done */
+
+	TRACE_ASYNC_END(state_main_game_action_get_name(state->action), (uintptr_t) state);
+	arena_reset(&state->scratch); /* Temporary data doesn't outlive an action */
+	entity_set_compact(state->entities); /* No entity loops run between actions */
+	state->action = action;
+	TRACE_ASYNC_BEGIN(state_main_game_action_get_name(action), (uintptr_t) state);
+}
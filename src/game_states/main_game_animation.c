@@ -23,56 +23,101 @@
 
 #include <combat.h>
 #include <score.h>
+#include <profile.h>
+#include <alloc_track.h>
 #include <game_states/main_game_animation.h>
 #include <game_states/illumination.h>
+#include <game_states/mob_wake.h>
 
 #define MAIN_GAME_ANIMATION_TIME 0.2
 #define WEAPON_DROP_PROBABILITY_PERCENT 20
 #define FOOD_DROP_PROBABILITY_PERCENT 50
 
+/** @brief Distance (in each axis) at which mobs hear an attack (and wake up) */
+#define MAIN_GAME_ATTACK_NOISE_RADIUS 8
+
+/** @brief Distance (in each axis) at which mobs hear a bomb explosion */
+#define MAIN_GAME_BOMB_NOISE_RADIUS 16
+
+/** @brief Distance (in each axis) at which mobs notice a death */
+#define MAIN_GAME_DEATH_NOISE_RADIUS 8
+
 /**
  * @brief Gets called to update the score and handle mob drops when a mob is killed
- * @param ent The entity killed
- * @param s   A ::game_state pointer
+ * @param entities The set of entities the killed entity is in
+ * @param index    The index of the entity killed
+ * @param s        A ::game_state pointer
  *
  * @author A104348 Humberto Gomes
  */
-void state_main_game_entity_kill_callback(const entity *ent, void *s) {
+void state_main_game_entity_kill_callback(entity_set entities, size_t index, void *s) {
 
-	(void) ent;
 	state_main_game_data *state = state_extract_data(state_main_game_data, s);
+	entity_type type = entities.type[index];
+	state->kills[type]++;
+
+	/* Wake up mobs around the corpse. The dead mob itself can't act anymore */
+	mob_wake_set_wake(&state->wake, state->entities, entities.x[index], entities.y[index],
+		MAIN_GAME_DEATH_NOISE_RADIUS, state->turn, &state->scratch);
+	mob_wake_set_sleep(&state->wake, index);
 
 	/* Score changes only from player kills */
 	if (state->action == MAIN_GAME_ANIMATING_PLAYER_COMBAT) {
-		state->score.score += score_from_entity(ent->type);
+		state->score.score += score_from_entity(type);
 
 		/* Randomly drop a weapon */
-		if ((rand() % 100) < WEAPON_DROP_PROBABILITY_PERCENT)
-			state->dropped = ent->weapon;
-		else if ((rand() & 100) < FOOD_DROP_PROBABILITY_PERCENT)
+		if (rng_range(&state->rng, 100) < WEAPON_DROP_PROBABILITY_PERCENT)
+			state->dropped = entities.cold[index].weapon;
+		else if ((rng_next(&state->rng) & 100) < FOOD_DROP_PROBABILITY_PERCENT)
 			state->dropped_food = 1;
 	}
 }
 
-entity_set state_main_game_entities_to_animate(entity_set all, state_main_game_action act) {
-	entity_set ret = all;
-
-	switch (act) {
+entity_set state_main_game_entities_to_animate(const state_main_game_data *state) {
+	switch (state->action) {
 		case MAIN_GAME_ANIMATING_PLAYER_MOVEMENT:
 		case MAIN_GAME_ANIMATING_PLAYER_COMBAT:
-			ret.count = 1;
-			break;
+			/* The player is the first living entity */
+			return entity_set_slice(state->entities, 0, 1);
 		case MAIN_GAME_ANIMATING_MOBS_MOVEMENT:
 		case MAIN_GAME_ANIMATING_MOBS_COMBAT:
-			ret.entities++;
-			ret.count--;
-			break;
+			return entity_set_view(state->entities, state->acting, state->acting_count);
 		default:
 			/* Not supposed to happen */
-			break;
+			return state->entities;
 	}
+}
 
-	return ret;
+/**
+ * @brief Wakes up the mobs that hear the attacks of some entities (::state_main_game_data::wake)
+ * @author A104348 Humberto Gomes
+ */
+void state_main_game_combat_noise(state_main_game_data *state, entity_set attackers) {
+	size_t count;
+	const size_t *live = entity_set_get_live(attackers, &count);
+	for (size_t k = 0; k < count; ++k) {
+		size_t i = live[k];
+		void *target = attackers.cold[i].combat_target;
+		if (attackers.health[i] <= 0 || !attackers.cold[i].attacking) continue;
+
+		/* Noise comes from where the attack lands */
+		int x = attackers.x[i], y = attackers.y[i], radius = MAIN_GAME_ATTACK_NOISE_RADIUS;
+		if (attackers.cold[i].weapon == WEAPON_BOMB) {
+			x = ((combat_bomb_info *) target)->x;
+			y = ((combat_bomb_info *) target)->y;
+			radius = MAIN_GAME_BOMB_NOISE_RADIUS;
+		} else if (attackers.cold[i].weapon == WEAPON_ARROW) {
+			animation_sequence anim = ((combat_arrow_info *) target)->animation;
+			if (anim.length) {
+				animation_step last = animation_sequence_get_steps(&anim)[anim.length - 1];
+				x = last.x;
+				y = last.y;
+			}
+		}
+
+		mob_wake_set_wake(&state->wake, state->entities, x, y, radius, state->turn,
+			&state->scratch);
+	}
 }
 
 /**
@@ -92,8 +137,10 @@ int state_main_game_animate_entities(game_state *s, entity_set to_animate,
 			return entity_set_animate(to_animate, step_index);
 		case MAIN_GAME_ANIMATING_MOBS_COMBAT:
 		case MAIN_GAME_ANIMATING_PLAYER_COMBAT:
+			if (step_index == 0)
+				state_main_game_combat_noise(state, to_animate);
 			return combat_animation_update(state->entities, to_animate, step_index,
-				state_main_game_entity_kill_callback, s);
+				state_main_game_entity_kill_callback, s, &state->rng);
 		default:
 			/* Not supposed to happen. Skip to next action */
 			return 1;
@@ -113,24 +160,26 @@ int state_main_game_animate_entities(game_state *s, entity_set to_animate,
 void state_main_game_animation_cleanup(entity_set just_animated, state_main_game_action act,
                                        int *cursorx, int *cursory) {
 
-	size_t i;
+	size_t k, count;
+	const size_t *live = entity_set_get_live(just_animated, &count);
+
 	switch (act) {
 		case MAIN_GAME_ANIMATING_PLAYER_MOVEMENT:
-			*cursorx = just_animated.entities[0].x;
-			*cursory = just_animated.entities[0].y;
+			*cursorx = just_animated.x[PLAYER_INDEX];
+			*cursory = just_animated.y[PLAYER_INDEX];
 			__attribute__ ((fallthrough)); /* Explicit fallthrough to disable warning */
 		case MAIN_GAME_ANIMATING_MOBS_MOVEMENT:
-			for (i = 0; i < just_animated.count; ++i)
-				if (just_animated.entities[i].health > 0)
-					just_animated.entities[i].animation.length = 0;
+			for (k = 0; k < count; ++k)
+				if (just_animated.health[live[k]] > 0)
+					just_animated.cold[live[k]].animation.length = 0;
 			break;
 
 		case MAIN_GAME_ANIMATING_MOBS_COMBAT:
 		case MAIN_GAME_ANIMATING_PLAYER_COMBAT:
 
-			for (i = 0; i < just_animated.count; ++i)
-				if (just_animated.entities[i].health > 0)
-					entity_free_combat_target(&just_animated.entities[i]);
+			for (k = 0; k < count; ++k)
+				if (just_animated.health[live[k]] > 0)
+					entity_free_combat_target(just_animated, live[k]);
 			break;
 		default:
 			break;
@@ -138,40 +187,62 @@ void state_main_game_animation_cleanup(entity_set just_animated, state_main_game
 	}
 }
 
-void state_main_game_animate(game_state *s, double elapsed) {
+int state_main_game_animation_advance(game_state *s) {
 	state_main_game_data *state = state_extract_data(state_main_game_data, s);
 
-	/* Animate entities (movement or combat) only if that is the case */
-	if (state->action != MAIN_GAME_MOVEMENT_INPUT && state->action != MAIN_GAME_COMBAT_INPUT) {
-		/* Animation timing */
-		if (state->time_since_last_animation >= MAIN_GAME_ANIMATION_TIME) {
-			state->time_since_last_animation -= MAIN_GAME_ANIMATION_TIME;
+	entity_set to_animate = state_main_game_entities_to_animate(state);
 
-			/* Remove light from last position */
-			state_main_game_circle_clean_light_map(
-				state->map, PLAYER(state).x, PLAYER(state).y, CIRCLE_RADIUS);
+	if (state_main_game_animate_entities(s, to_animate, state->animation_step)) {
 
-			entity_set to_animate =
-				state_main_game_entities_to_animate(state->entities, state->action);
+		/* End of animation. Clean up and move to next action */
+		state_main_game_animation_cleanup(to_animate, state->action,
+			&state->cursorx, &state->cursory);
 
-			if (state_main_game_animate_entities(s, to_animate, state->animation_step)) {
+		state_main_game_set_action(state, (state->action + 1) % 6);
+		state->animation_step = 0;
 
-				/* End of animation. Clean up and move to next action */
-				state_main_game_animation_cleanup(to_animate, state->action,
-					&state->cursorx, &state->cursory);
+		if (state->action == MAIN_GAME_MOVEMENT_INPUT) {
+			state->turn++;
+			PROFILE_END_TURN();
+			ALLOC_TRACK_END_TURN();
+		}
+		return 1;
+	} else {
+		/* Not the end of the animation. Continue */
+		state->animation_step++;
+		return 0;
+	}
+}
 
-				state->action = (state->action + 1) % 6;
-				state->animation_step = 0;
-			} else {
-				/* Not the end of the animation. Continue */
-				state->animation_step++;
-			}
+void state_main_game_animate(game_state *s, double elapsed) {
+	state_main_game_data *state = state_extract_data(state_main_game_data, s);
 
-			/* Radiate light from new player position */
-			state_main_game_circle_light_map(
-				state->map, PLAYER(state).x, PLAYER(state).y, CIRCLE_RADIUS);
+	/* Animate entities (movement or combat) only if that is the case */
+	if (state->action != MAIN_GAME_MOVEMENT_INPUT && state->action != MAIN_GAME_COMBAT_INPUT) {
+		/* Animation timing */
+		if (state->time_since_last_animation >= MAIN_GAME_ANIMATION_TIME) {
+			state->time_since_last_animation -= MAIN_GAME_ANIMATION_TIME;
 
-			state->needs_rerender = 1;
+			/*
+			 * The light only changes when the player moves. Otherwise, the map must not be
+			 * written to, as it may be read by mob AI (see state_main_game_mobs_start_ai).
+			 */
+			int player_moves = state->action == MAIN_GAME_ANIMATING_PLAYER_MOVEMENT;
+			size_t step = state->animation_step;
+			if (player_moves) /* Remove light from last position */
+				state_main_game_circle_clean_light_map(
+					state->map, PLAYER_X(state), PLAYER_Y(state), CIRCLE_RADIUS);
+
+			state_main_game_animation_advance(s);
+
+			/* Radiate light from new player position (calculated ahead of time if possible) */
+			if (player_moves && !light_cache_apply(&state->path_light, state->map, step,
+			                                       PLAYER_X(state), PLAYER_Y(state)))
+				state_main_game_circle_light_map(
+					state->map, PLAYER_X(state), PLAYER_Y(state), CIRCLE_RADIUS);
+			state_main_game_update_lit(state);
+			state->needs_rerender |=
+				MAIN_GAME_REDRAW_SIDEBAR | MAIN_GAME_REDRAW_MAP | MAIN_GAME_REDRAW_TIPS;
 		} else {
 			/* Not enought time for the next animation step. Keep waiting */
 			state->time_since_last_animation += elapsed;
@@ -23,6 +23,8 @@
 #include <game_states/main_game_animation.h>
 #include <game_states/main_game_renderer.h>
 #include <game_states/player_action.h>
+#include <profile.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -48,6 +50,43 @@
  */
 #define SIDEBAR_TOP_LINES 7
 
+#ifdef PROFILE
+/**
+ * @struct main_game_panel_counter
+ * @brief A row of the debug panel of profiling builds
+ *
+ * @var main_game_panel_counter::counter
+ *   The counter shown
+ * @var main_game_panel_counter::label
+ *   Short name of the counter (up to 8 characters)
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	profile_counter counter;
+	const char *label;
+} main_game_panel_counter;
+
+/**
+ * @brief   Counters shown on the debug panel
+ * @details Not all of them, so that the panel leaves room for health bars on small terminals. All
+ *          counters are written to the profiling report.
+ */
+static const main_game_panel_counter main_game_panel_counters[] = {
+	{ PROFILE_COUNTER_PATH_SEARCHES, "Paths"   },
+	{ PROFILE_COUNTER_PATH_NODES,    "Nodes"   },
+	{ PROFILE_COUNTER_TILES_LIT,     "Lit"     },
+	{ PROFILE_COUNTER_MALLOCS,       "Mallocs" },
+	{ PROFILE_COUNTER_MOBS_WOKEN,    "Woken"   },
+	{ PROFILE_COUNTER_MOBS_DUE,      "Due"     },
+	{ PROFILE_COUNTER_LIGHT_CACHED,  "Cached"  }
+};
+
+/** @brief Number of rows in ::main_game_panel_counters */
+#define MAIN_GAME_PANEL_COUNTER_COUNT \
+	((int) (sizeof(main_game_panel_counters) / sizeof(main_game_panel_counters[0])))
+#endif
+
 /**
  * @brief The number of lines on the sidebar after the health bars
  * @details Currently three:
@@ -55,127 +94,217 @@
  * 1. Space between bottom lines and health bars
  * 2. FPS
  * 3. Number of renders
+ *
+ * In profiling builds, the last two are replaced by a debug panel: FPS and renders in a single
+ * line, followed by the value of some counters in the last turn (see ::main_game_panel_counters).
  */
-#define SIDEBAR_BOTTOM_LINES 3
+#ifdef PROFILE
+	#define SIDEBAR_BOTTOM_LINES (2 + MAIN_GAME_PANEL_COUNTER_COUNT)
+#else
+	#define SIDEBAR_BOTTOM_LINES 3
+#endif
 
 /**
  * @brief The number of lines on the sidebar occupied by data other than health bars
  */
 #define SIDEBAR_TOP_BOTTOM_LINES (SIDEBAR_TOP_LINES + SIDEBAR_BOTTOM_LINES)
 
+/**
+ * @brief Clears lines of the sidebar (without the vertical separation line)
+ * @author A104348 Humberto Gomes
+ */
+void main_game_clear_sidebar_lines(WINDOW *win, int top, int count) {
+	for (int y = top; y < top + count; ++y) {
+		wmove(win, y, 0);
+		for (int x = 0; x < SIDEBAR_WIDTH - 1; ++x)
+			waddch(win, ' ');
+	}
+}
+
+/**
+ * @brief Prints a string centered on a line of the sidebar
+ * @author A104348 Humberto Gomes
+ */
+void main_game_print_sidebar_centered(WINDOW *win, int y, const char *str) {
+	int len = strlen(str);
+	mvwprintw(win, y, (SIDEBAR_WIDTH - len) / 2, "%s", str);
+}
+
 /**
  * @brief Draws the health of an entity on the side bar
  * @author A104348 Humberto Gomes
  */
-void main_game_render_health(entity ent, int y) {
+void main_game_render_health(WINDOW *win, entity_set entities, size_t index, int y) {
 	/* Draw centered entity name and weapon */
 	char name[128];
-	int len = sprintf(name, "%s (%s)", entity_get_name(ent.type), weapon_get_name(ent.weapon));
-	move(y, (SIDEBAR_WIDTH - len) / 2);
-	printw("%s", name);
+	const entity_cold *cold = &entities.cold[index];
+	sprintf(name, "%s (%s)", entity_get_name(entities.type[index]),
+	        weapon_get_name(cold->weapon));
+	main_game_print_sidebar_centered(win, y, name);
 
 	/* Draw health bar */
 	/* Example: [███     ] */
-	int health_dots = round(HEALTHBAR_WIDTH * ((float) ent.health / (float) ent.max_health));
-	move(y + 1, 1);
-	addch('[');
+	int health_dots = round(HEALTHBAR_WIDTH *
+		((float) entities.health[index] / (float) cold->max_health));
+	wmove(win, y + 1, 1);
+	waddch(win, '[');
 
 	for (int i = 1; i <= HEALTHBAR_WIDTH; ++i) {
 		if (i <= health_dots) {
-			attron(COLOR_PAIR(COLOR_RED) | A_REVERSE); /* Red background (health) */
+			wattron(win, COLOR_PAIR(COLOR_RED) | A_REVERSE); /* Red background (health) */
 		} else {
-			attroff(A_REVERSE); /* Empty (lost health points) */
+			wattroff(win, A_REVERSE); /* Empty (lost health points) */
 		}
-		addch(' ');
+		waddch(win, ' ');
 	}
-	attroff(COLOR_PAIR(COLOR_RED) | A_REVERSE);
-	addch(']');
+	wattroff(win, COLOR_PAIR(COLOR_RED) | A_REVERSE);
+	waddch(win, ']');
 }
 
 /**
- * @brief Renders the sidebar of the main game
+ * @brief   Updates the list of entities whose health bars are shown on the sidebar
+ * @details Only done if ::state_main_game_data::closeby has been invalidated or if the number of
+ *          health bars that fit on the screen has changed.
+ *
  * @author A104348 Humberto Gomes
  */
-void main_game_render_sidebar(const state_main_game_data *state, int height) {
+void main_game_update_closeby(state_main_game_data *state, size_t max_health_bars) {
+	if (max_health_bars != state->closeby_capacity) {
+		entity_handle *closeby = realloc(state->closeby, max_health_bars * sizeof(entity_handle));
+		if (!closeby && max_health_bars) {
+			/* Allocation failure: keep the old list, with the bars that fit */
+			if (max_health_bars > state->closeby_capacity)
+				max_health_bars = state->closeby_capacity;
+		} else {
+			state->closeby = closeby;
+			state->closeby_capacity = max_health_bars;
+		}
+		state->closeby_valid = 0;
+	}
+
+	if (!state->closeby_valid) {
+		state->closeby_count = entity_get_closeby(PLAYER_X(state), PLAYER_Y(state),
+			state->entities, state->lit, state->lit_count, max_health_bars, state->closeby);
+		state->closeby_valid = 1;
+	}
+}
+
+/**
+ * @brief Renders the parts of the sidebar that never change (only needed when it's created)
+ * @author A104348 Humberto Gomes
+ */
+void main_game_render_sidebar_static(WINDOW *win, int height) {
 	/* Draw vertical separation line */
 	for (int y = 0; y < height; ++y)
-		mvaddch(y, SIDEBAR_WIDTH - 1, '|');
+		mvwaddch(win, y, SIDEBAR_WIDTH - 1, '|');
 
-	/* Draw game name (centered) */
-	const char *game_name = "Roguelite";
-	move(0, (SIDEBAR_WIDTH - strlen(game_name)) / 2);
-	attron(A_BOLD); printw("%s", game_name); attroff(A_BOLD);
+	/* Draw game name and weapon label (centered) */
+	wattron(win, A_BOLD);
+	main_game_print_sidebar_centered(win, 0, "Roguelite");
+	main_game_print_sidebar_centered(win, 4, "Weapon");
+	wattroff(win, A_BOLD);
+}
+
+/**
+ * @brief Renders the parts of the sidebar that change during the game (score, weapon, health)
+ * @author A104348 Humberto Gomes
+ */
+void main_game_render_sidebar(state_main_game_data *state, int height) {
+	WINDOW *win = state->windows.sidebar;
 
 	/* Draw score */
 	char score[SIDEBAR_WIDTH + 1];
-	int len = sprintf(score, "Score: %d", state->score.score);
-	move(2, (SIDEBAR_WIDTH - len) / 2);
-	printw("%s", score);
-
-	/* Draw player weapon (centered)
-	 *
-	 * 1.    Weapon
-	 * 2.  Weapon name
-	 */
-
-	/* 1. Weapon word centered */
-	const char *equiped = "Weapon";
-	move(4, (SIDEBAR_WIDTH - strlen(equiped)) / 2);
-	attron(A_BOLD); printw("%s", equiped); attroff(A_BOLD);
-
-	/* 2. Weapon name centered */
-	equiped = weapon_get_name(PLAYER(state).weapon);
-	move(5, (SIDEBAR_WIDTH - strlen(equiped)) / 2);
-	printw("%s", equiped);
-
+	sprintf(score, "Score: %d", state->score.score);
+	main_game_clear_sidebar_lines(win, 2, 1);
+	main_game_print_sidebar_centered(win, 2, score);
 
+	/* Draw player weapon name (below the label) */
+	main_game_clear_sidebar_lines(win, 5, 1);
+	main_game_print_sidebar_centered(win, 5, weapon_get_name(PLAYER_COLD(state).weapon));
 
 	/* Draw health of surronding enemies */
 	int max_health_bars = (height - SIDEBAR_TOP_BOTTOM_LINES) / HEALTHBAR_HEIGHT;
-	entity_set health_entities =
-		entity_get_closeby(PLAYER(state), state->entities, max_health_bars, &state->map);
-
-	for (size_t i = 0; i < health_entities.count; ++i) {
-		main_game_render_health(health_entities.entities[i],
-			SIDEBAR_TOP_LINES + i * HEALTHBAR_HEIGHT);
+	if (max_health_bars < 0) max_health_bars = 0; /* Terminal too short */
+	main_game_update_closeby(state, max_health_bars);
+
+	if (height > SIDEBAR_TOP_BOTTOM_LINES)
+		main_game_clear_sidebar_lines(win, SIDEBAR_TOP_LINES, height - SIDEBAR_TOP_BOTTOM_LINES);
+	int y = SIDEBAR_TOP_LINES;
+	for (size_t i = 0; i < state->closeby_count; ++i) {
+		size_t index;
+		if (!entity_set_resolve(state->entities, state->closeby[i], &index))
+			continue; /* Killed since the list was updated */
+
+		main_game_render_health(win, state->entities, index, y);
+		y += HEALTHBAR_HEIGHT;
 	}
+}
 
-	free(health_entities.entities); /* Don't use entity_set_free not to free entity data */
+/**
+ * @brief Renders the FPS and the number of renders on the bottom of the sidebar
+ * @author A104348 Humberto Gomes
+ */
+void main_game_render_stats(const state_main_game_data *state, int height) {
+	WINDOW *win = state->windows.sidebar;
+	main_game_clear_sidebar_lines(win, height - (SIDEBAR_BOTTOM_LINES - 1),
+		SIDEBAR_BOTTOM_LINES - 1);
 
-	/* Draw FPS and number of renders */
 	char txt[SIDEBAR_WIDTH + 1];
-	len = sprintf(txt, "FPS: %d", state->fps_show);
-	move(height - 2, (SIDEBAR_WIDTH - len) / 2);
-	printw("%s", txt);
+#ifdef PROFILE
+	/* Debug panel */
+	int y = height - (SIDEBAR_BOTTOM_LINES - 1);
+	snprintf(txt, sizeof(txt), "FPS:%d Rnd:%d", state->fps_show, state->renders_show);
+	main_game_print_sidebar_centered(win, y++, txt);
+
+	profile_snapshot turn = profile_get_last_turn();
+	for (int i = 0; i < MAIN_GAME_PANEL_COUNTER_COUNT; ++i) {
+		const main_game_panel_counter *row = &main_game_panel_counters[i];
+		snprintf(txt, sizeof(txt), "%-8.8s%10" PRIu64, row->label, turn.counters[row->counter]);
+		mvwprintw(win, y++, 0, "%s", txt);
+	}
+#else
+	sprintf(txt, "FPS: %d", state->fps_show);
+	main_game_print_sidebar_centered(win, height - 2, txt);
 
-	len = sprintf(txt, "Renders: %d", state->renders_show);
-	move(height - 1, (SIDEBAR_WIDTH - len) / 2);
-	printw("%s", txt);
+	sprintf(txt, "Renders: %d", state->renders_show);
+	main_game_print_sidebar_centered(win, height - 1, txt);
+#endif
 }
 
 /**
  * @brief Renders the overlay on top of the map
  * @author A104348 Humberto Gomes
  */
-void main_game_render_overlay(ncurses_char *overlay, int width, int height) {
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width - SIDEBAR_WIDTH; ++x) {
-			if (overlay->chr) { /* Don't draw '\0' */
-				move(y, SIDEBAR_WIDTH + x);
-				ncurses_char_print(*overlay);
-			}
+void main_game_render_overlay(const combat_overlay *overlay, const map_window *wnd) {
+	for (size_t i = 0; i < overlay->length; ++i) {
+		combat_overlay_cell cell = overlay->cells[i];
 
-			overlay++;
+		if (map_window_visible(cell.x, cell.y, wnd)) { /* Don't draw out-of-screen effects */
+			int screenx, screeny;
+			map_window_to_screen(wnd, cell.x, cell.y, &screenx, &screeny);
+
+			wmove(wnd->win, screeny, screenx);
+			ncurses_char_print(wnd->win, cell.chr);
 		}
 	}
 }
 
 /**
- * @brief Draws tips for the player on how to play the game
+ * @brief   Creates the windows with tips for the player on how to play the game
+ * @details Each line of tips is its own window, only as wide as the text, so that the map is still
+ *          visible around it.
+ *
+ * @param windows Where to store the windows (previous tip windows are deleted)
+ * @param act     Current action in the game (the tip depends on it)
+ * @param top     Vertical position of the first line of tips on the screen
+ * @param left    Horizontal position of the map on the screen
+ * @param width   Width of the map on the screen
+ *
  * @author A104348 Humberto Gomes
  * @author A104082 Pedro Pereira
  */
-void state_main_game_draw_tips(state_main_game_action act, const map_window *wnd) {
+void state_main_game_draw_tips(state_main_game_windows *windows, state_main_game_action act,
+                               int top, int left, int width) {
 
 	/* Choose tip message */
 	const char *message[2];
@@ -200,85 +329,140 @@ void state_main_game_draw_tips(state_main_game_action act, const map_window *wnd
 
 	/* Print message on the bottom center */
 	for (int i = 0; i < 2; ++i) {
+		if (windows->tips[i]) delwin(windows->tips[i]);
+		windows->tips[i] = NULL;
+
 		int len = strlen(message[i]);
-		move(wnd->height - 3 + i, wnd->term_left + (wnd->width - len) / 2);
-		printw("%s", message[i]);
+		if (len == 0 || len > width) continue;
+
+		windows->tips[i] = newwin(1, len, top + i, left + (width - len) / 2);
+		if (windows->tips[i])
+			mvwaddstr(windows->tips[i], 0, 0, message[i]);
+	}
+}
+
+/**
+ * @brief Creates the windows the screen is divided in, for a terminal of a given size
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int main_game_create_windows(state_main_game_windows *windows, int width, int height) {
+	state_main_game_free_windows(windows);
+
+	windows->sidebar = newwin(height, SIDEBAR_WIDTH, 0, 0);
+	windows->map     = newwin(height, width - SIDEBAR_WIDTH, 0, SIDEBAR_WIDTH);
+	if (!windows->sidebar || !windows->map) return 1;
+
+	main_game_render_sidebar_static(windows->sidebar, height);
+	return 0;
+}
+
+void state_main_game_free_windows(state_main_game_windows *windows) {
+	WINDOW **all[4] = { &windows->sidebar, &windows->map, &windows->tips[0], &windows->tips[1] };
+	for (int i = 0; i < 4; ++i) {
+		if (*all[i]) delwin(*all[i]);
+		*all[i] = NULL;
 	}
 }
 
 game_loop_callback_return_value state_main_game_onrender(void *s, int width, int height) {
 	state_main_game_data *state = state_extract_data(state_main_game_data, s);
 
-	if (!state->needs_rerender) return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
+	int redraw = state->needs_rerender;
+	if (!redraw) return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 	state->needs_rerender = 0;
-	erase();
 
 	if (width < 80 || height < 24) {
 
 		/* Terminal too small: print invalid layout in the middle */
 		const char * const msg = "Invalid terminal size (Please Zoom Out)";
 		int len = strlen(msg);
+		erase();
 		move(height / 2, (width - len) / 2);
 		printw("%s", msg);
 
+		game_loop_refresh();
 		return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 	}
 
 	/* Render game normally (valid screen) */
+	state_main_game_windows *windows = &state->windows;
+	if (redraw & MAIN_GAME_REDRAW_LAYOUT) {
+		if (main_game_create_windows(windows, width, height))
+			return GAME_LOOP_CALLBACK_RETURN_ERROR;
+		redraw = MAIN_GAME_REDRAW_ALL;
+	}
 
 	map_window wnd = { /* Region of the screen for the map (exclude sidebar) */
-		.map_top  = PLAYER(state).y - (height / 2),
-		.map_left = PLAYER(state).x - ((width - SIDEBAR_WIDTH) / 2),
-		.term_top = 0, .term_left = SIDEBAR_WIDTH,
-		.height = height, .width = width - SIDEBAR_WIDTH
+		.map_top  = PLAYER_Y(state) - (height / 2),
+		.map_left = PLAYER_X(state) - ((width - SIDEBAR_WIDTH) / 2),
+		.term_top = 0, .term_left = 0,
+		.height = height, .width = width - SIDEBAR_WIDTH,
+		.win = windows->map
 	};
 
-	main_game_render_sidebar(state, height);
+	if (redraw & MAIN_GAME_REDRAW_SIDEBAR)
+		main_game_render_sidebar(state, height);
 
-	map_render(state->map, &wnd);
+	if (redraw & MAIN_GAME_REDRAW_STATS)
+		main_game_render_stats(state, height);
 
-	state_main_game_draw_player_path(state, &wnd);
+	if (redraw & MAIN_GAME_REDRAW_MAP) {
+		map_render(state->map, &wnd);
 
-	entity_set_render(state->entities, state->map, &wnd);
+		state_main_game_draw_player_path(state, &wnd);
 
-	/* Draw combat overlay, after cleaning it and drawing it */
-	if (state->action == MAIN_GAME_ANIMATING_PLAYER_COMBAT ||
-	    state->action == MAIN_GAME_ANIMATING_MOBS_COMBAT) {
+		/* Only entities on lit tiles are shown */
+		entity_set_render(entity_set_view(state->entities, state->lit, state->lit_count),
+			state->map, &wnd);
 
-		if (!state->overlay) /* Allocate overlay if not allocated (after game overs) */
-			state->overlay = malloc(wnd.width * wnd.height * sizeof(ncurses_char));
+		/* Draw combat overlay, after cleaning it and drawing it */
+		if (state->action == MAIN_GAME_ANIMATING_PLAYER_COMBAT ||
+		    state->action == MAIN_GAME_ANIMATING_MOBS_COMBAT) {
 
-		memset(state->overlay, 0, wnd.width * wnd.height * sizeof(ncurses_char));
-		entity_set to_animate = state_main_game_entities_to_animate(state->entities,
-			state->action);
-		combat_entity_set_animate(to_animate, state->animation_step, state->overlay,
-	                                &wnd);
+			combat_overlay_clear(&state->overlay);
+			entity_set to_animate = state_main_game_entities_to_animate(state);
+			combat_entity_set_animate(to_animate, state->animation_step, &state->overlay);
+
+			main_game_render_overlay(&state->overlay, &wnd);
+		}
 
-		main_game_render_overlay(state->overlay, width, height);
+		if (state->action == MAIN_GAME_COMBAT_INPUT)
+			state_main_game_draw_cursor(state, &wnd);
 	}
 
-	state_main_game_draw_tips(state->action, &wnd);
+	if (redraw & MAIN_GAME_REDRAW_TIPS)
+		state_main_game_draw_tips(windows, state->action, height - 3, SIDEBAR_WIDTH, wnd.width);
 
-	if (state->action == MAIN_GAME_COMBAT_INPUT)
-		state_main_game_draw_cursor(state, &wnd);
+	/*
+	 * Compose windows on the virtual screen. Tips are on top of the map, so they need to be
+	 * composed again after the map is (or after they're removed).
+	 */
+	if (redraw & (MAIN_GAME_REDRAW_MAP | MAIN_GAME_REDRAW_TIPS)) {
+		if (!(redraw & MAIN_GAME_REDRAW_MAP)) touchwin(windows->map);
+		wnoutrefresh(windows->map);
+
+		for (int i = 0; i < 2; ++i) {
+			if (windows->tips[i]) {
+				touchwin(windows->tips[i]);
+				wnoutrefresh(windows->tips[i]);
+			}
+		}
+	}
+
+	if (redraw & (MAIN_GAME_REDRAW_SIDEBAR | MAIN_GAME_REDRAW_STATS))
+		wnoutrefresh(windows->sidebar);
 
-	refresh();
+	game_loop_doupdate();
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
 
 game_loop_callback_return_value state_main_game_onresize(void *s, int width, int height) {
-	state_main_game_data *state = state_extract_data(state_main_game_data, s);
-	state->needs_rerender = 1;
-
-	/* Reallocate the overlay (if it has been allocated already) */
-	const size_t bytes = (width - SIDEBAR_WIDTH) * height * sizeof(ncurses_char);
-	if (state->overlay)
-		state->overlay = realloc(state->overlay, bytes);
-	else
-		state->overlay = malloc(bytes);
+	(void) width; (void) height;
 
-	memset(state->overlay, 0, bytes);
+	state_main_game_data *state = state_extract_data(state_main_game_data, s);
+	state->needs_rerender = MAIN_GAME_REDRAW_ALL;
 
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
-
@@ -134,7 +134,7 @@ game_loop_callback_return_value state_main_menu_onrender(void *s, int width, int
 		attroff(A_REVERSE);
 	}
 
-	refresh();
+	game_loop_refresh();
 
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
@@ -21,47 +21,484 @@
 
 #include <map.h>
 #include <combat.h>
+#include <game_states/illumination.h>
 #include <game_states/main_game.h>
+#include <game_states/mob_action.h>
+#include <game_states/mob_lod.h>
+#include <game_states/mob_wake.h>
 #include <entities_search.h>
+#include <profile.h>
+#include <thread_pool.h>
+#include <trace.h>
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <time.h>
 
+/** @brief Energy of a coarse move, in actions (it crosses many tiles at once) */
+#define MOB_LOD_PERIOD 4
 
-void state_main_game_mob_run_ai(entity *mob, state_main_game_data *state, int distance_x, int distance_y) {
+/** @brief Minimum number of acting mobs for their AI to be planned on many threads */
+#define MOB_AI_PARALLEL_MIN 50
+
+/** @brief Initial capacity of the scratch arena of each thread planning mob AI */
+#define MOB_AI_SCRATCH_CAPACITY (64 * 1024)
+
+/** @brief Number of coarse moves between checks of the time budget */
+#define MOB_LOD_BUDGET_CHECK 32
+
+/** @brief Maximum time (in microseconds) spent in coarse moves per turn (`0` for no limit) */
+static unsigned int mob_lod_budget = MOB_LOD_DEFAULT_BUDGET;
+
+void state_main_game_set_lod_budget(unsigned int microseconds) {
+	mob_lod_budget = microseconds;
+}
+
+
+/**
+ * @struct mob_ai_plan
+ * @brief What a mob does in a turn, planned without changing the game (see ::mob_ai_plan_run)
+ *
+ * @var mob_ai_plan::distance_x
+ *   Horizontal distance to the player the mob wants to be at
+ * @var mob_ai_plan::distance_y
+ *   Vertical distance to the player the mob wants to be at
+ * @var mob_ai_plan::path
+ *   Path to be walked by the mob (on the heap, as plans are made on multiple threads)
+ * @var mob_ai_plan::attack
+ *   Whether the mob can attack the player from the end of ::mob_ai_plan::path
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	int distance_x, distance_y;
+	animation_sequence path;
+	int attack;
+} mob_ai_plan;
+
+/**
+ * @brief   Plans the movement and the attack of a mob
+ * @details Only reads the game, so plans of many mobs can be made in parallel.
+ *
+ * @param mob     The index of the mob in ::state_main_game_data::entities
+ * @param state   The game (only read, except for the path finding state of @p mob)
+ * @param plan    Where to write the plan. Its distances to the player must be already set.
+ * @param scratch Arena for temporary data (left as it was found)
+ *
+ * @author A104348 Humberto Gomes
+ */
+void mob_ai_plan_run(size_t mob, state_main_game_data *state, mob_ai_plan *plan,
+                     arena *scratch) {
+
+	entity_set entities = state->entities;
 
 	// Pathfinding
-	animation_step start = { .x = mob->x, .y = mob->y };
-	animation_step end = { .x = PLAYER(state).x + distance_x, .y = PLAYER(state).y + distance_y };
-	mob->animation = search_path(&(state->map), mob->type, start, end);
-
-	// Combat
-	animation_step old = { .x = mob->x, .y = mob->y };
-	if (mob->animation.length != 0) {
-		mob->x = mob->animation.steps[mob->animation.length - 1].x;
-		mob->y = mob->animation.steps[mob->animation.length - 1].y;
+	animation_step start = { .x = entities.x[mob], .y = entities.y[mob] };
+	animation_step end = {
+		.x = PLAYER_X(state) + plan->distance_x,
+		.y = PLAYER_Y(state) + plan->distance_y
+	};
+	if (state->paths)
+		plan->path = path_search_find(&state->paths[mob], &state->map, entities.type[mob], start,
+		                              end);
+	else
+		plan->path = search_path(&state->map, entities.type[mob], start, end, scratch);
+
+	// Combat (from the end of the path)
+	if (plan->path.length != 0)
+		start = animation_sequence_get_steps(&plan->path)[plan->path.length - 1];
+	plan->attack = combat_can_attack_from(entities, mob, start, PLAYER_INDEX, &state->map);
+}
+
+/**
+ * @brief Applies a ::mob_ai_plan to the game (not thread-safe)
+ * @author A104348 Humberto Gomes
+ */
+void mob_ai_plan_commit(size_t mob, state_main_game_data *state, mob_ai_plan plan) {
+	entity_set entities = state->entities;
+	entity_cold *cold = &entities.cold[mob];
+
+	/* Move the path into the game's pool */
+	animation_pool *pool = entity_set_get_animation_pool(entities);
+	animation_sequence_free(pool, cold->animation);
+	cold->animation = animation_sequence_copy(pool, &plan.path);
+	animation_sequence_free(NULL, plan.path);
+
+	if (plan.attack) {
+		/* Attack from the end of the path */
+		int x = entities.x[mob], y = entities.y[mob];
+		size_t length = cold->animation.length;
+		if (length != 0) {
+			animation_step last = animation_sequence_get_steps(&cold->animation)[length - 1];
+			entity_set_move(entities, mob, last.x, last.y);
+		}
+
+		combat_attack(entities, mob, PLAYER_INDEX, &state->map);
+		entity_set_move(entities, mob, x, y);
+	}
+}
+
+void state_main_game_mob_run_ai(size_t mob, state_main_game_data *state,
+                                int distance_x, int distance_y) {
+
+	mob_ai_plan plan = { .distance_x = distance_x, .distance_y = distance_y };
+	mob_ai_plan_run(mob, state, &plan, &state->scratch);
+	mob_ai_plan_commit(mob, state, plan);
+}
+
+/**
+ * @brief Threads mob AI is planned on (see ::state_main_game_set_ai_threads)
+ *
+ * @var pool   Worker threads (`NULL` when planning on the calling thread only)
+ * @var arenas Scratch arena of each worker, for path finding
+ */
+static struct {
+	thread_pool *pool;
+	arena *arenas;
+} mob_ai_threads = { .pool = NULL, .arenas = NULL };
+
+/**
+ * @brief Frees the threads of mob AI (registered with `atexit`)
+ * @author A104348 Humberto Gomes
+ */
+void mob_ai_threads_free(void) {
+	if (!mob_ai_threads.pool) return;
+
+	size_t threads = thread_pool_get_thread_count(mob_ai_threads.pool);
+	for (size_t i = 0; i < threads; ++i)
+		arena_free(&mob_ai_threads.arenas[i]);
+	free(mob_ai_threads.arenas);
+	thread_pool_free(mob_ai_threads.pool);
+
+	mob_ai_threads.pool   = NULL;
+	mob_ai_threads.arenas = NULL;
+}
+
+int state_main_game_set_ai_threads(size_t threads) {
+	static int registered = 0;
+	if (!registered) {
+		atexit(mob_ai_threads_free);
+		registered = 1;
 	}
 
-	if (combat_can_attack(mob, &PLAYER(state), &state->map)) {
-		combat_attack(mob, &PLAYER(state), &state->map);
+	mob_ai_threads_free();
+	if (threads == 1) return 0;
+
+	mob_ai_threads.pool = thread_pool_create(threads);
+	if (!mob_ai_threads.pool) return 1;
+
+	threads = thread_pool_get_thread_count(mob_ai_threads.pool);
+	mob_ai_threads.arenas = malloc(threads * sizeof(arena));
+	if (!mob_ai_threads.arenas) {
+		thread_pool_free(mob_ai_threads.pool);
+		mob_ai_threads.pool = NULL;
+		return 1;
 	}
-	mob->x = old.x; mob->y = old.y;
+
+	for (size_t i = 0; i < threads; ++i)
+		mob_ai_threads.arenas[i] = arena_create(MOB_AI_SCRATCH_CAPACITY);
+	return 0;
 }
 
-void state_main_game_mobs_run_ai(state_main_game_data *state) {
+/**
+ * @struct mob_ai_job
+ * @brief AI of the visible mobs in a turn, planned while the player's attack is animated
+ *
+ * @var mob_ai_job::state
+ *   The game the mobs are in
+ * @var mob_ai_job::plans
+ *   Plan of each of the first ::mob_ai_job::count mobs in ::state_main_game_data::acting
+ * @var mob_ai_job::count
+ *   Number of plans in ::mob_ai_job::plans
+ * @var mob_ai_job::capacity
+ *   Number of plans that fit in ::mob_ai_job::plans
+ * @var mob_ai_job::scratch
+ *   Scratch arena for path finding (when not planning on the threads of
+ *   ::state_main_game_set_ai_threads)
+ * @var mob_ai_job::thread
+ *   Thread the plans are being made on
+ * @var mob_ai_job::running
+ *   Whether ::mob_ai_job::thread must be joined
+ * @var mob_ai_job::pending
+ *   Whether there are plans that haven't been applied to the game
+ *
+ * @author A104348 Humberto Gomes
+ */
+struct mob_ai_job {
+	state_main_game_data *state;
+
+	mob_ai_plan *plans;
+	size_t count, capacity;
+	arena scratch;
+
+	pthread_t thread;
+	int running, pending;
+};
+
+mob_ai_job *mob_ai_job_create(void) {
+	mob_ai_job *job = malloc(sizeof(mob_ai_job));
+	if (!job) return NULL;
+
+	job->plans    = NULL;
+	job->count    = job->capacity = 0;
+	job->scratch  = arena_create(MOB_AI_SCRATCH_CAPACITY);
+	job->running  = job->pending = 0;
+	return job;
+}
+
+void mob_ai_job_free(mob_ai_job *job) {
+	if (!job) return;
+	if (job->running)
+		pthread_join(job->thread, NULL);
+
+	/* Plans that were never applied */
+	if (job->pending)
+		for (size_t i = 0; i < job->count; ++i)
+			animation_sequence_free(NULL, job->plans[i].path);
+
+	free(job->plans);
+	arena_free(&job->scratch);
+	free(job);
+}
+
+/**
+ * @brief Task of the ::thread_pool that plans the AI of a mob
+ * @author A104348 Humberto Gomes
+ */
+void mob_ai_plan_task(size_t index, size_t worker, void *data) {
+	mob_ai_job *job = data;
+	size_t mob = job->state->acting[index];
+
+	TRACE_BEGIN_ARG(entity_get_name(job->state->entities.type[mob]), mob);
+	mob_ai_plan_run(mob, job->state, &job->plans[index], &mob_ai_threads.arenas[worker]);
+	TRACE_END(entity_get_name(job->state->entities.type[mob]));
+}
+
+/**
+ * @brief Makes all the plans of a ::mob_ai_job
+ * @details Runs on ::mob_ai_job::thread, or on the game's thread if it couldn't be created.
+ * @returns `NULL` (for `pthread_create`)
+ *
+ * @author A104348 Humberto Gomes
+ */
+void *mob_ai_job_run(void *data) {
+	mob_ai_job *job = data;
+	state_main_game_data *state = job->state;
+
+	TRACE_BEGIN("Mobs AI planning");
+	if (mob_ai_threads.pool && job->count >= MOB_AI_PARALLEL_MIN) {
+		thread_pool_run(mob_ai_threads.pool, job->count, mob_ai_plan_task, job);
+	} else {
+		for (size_t i = 0; i < job->count; ++i) {
+			size_t mob = state->acting[i];
+			TRACE_BEGIN_ARG(entity_get_name(state->entities.type[mob]), mob);
+			mob_ai_plan_run(mob, state, &job->plans[i], &job->scratch);
+			TRACE_END(entity_get_name(state->entities.type[mob]));
+		}
+	}
+	TRACE_END("Mobs AI planning");
+
+	return NULL;
+}
+
+void state_main_game_mobs_start_ai(state_main_game_data *state, int background) {
 
 	int possible_distances[] = {-3, -2, -1, 0, 1, 2, 3};
+	mob_ai_job *job = state->ai;
+	state_main_game_mobs_finish_ai(state); /* Plans from before (not supposed to happen) */
+
+	TRACE_BEGIN("Mobs AI");
 
-	for (size_t i = 1; i < state->entities.count; ++i) {
-		entity *ent = state->entities.entities + i;
-		if (ent->health > 0 && ent->x >= 0 && (unsigned) ent->x < state->map.width &&
-		                       ent->y >= 0 && (unsigned) ent->y < state->map.height) {
+	/* Wake up mobs about to be reached by the light, so that they can walk into it */
+	mob_wake_set_wake(&state->wake, state->entities, PLAYER_X(state), PLAYER_Y(state),
+		CIRCLE_RADIUS, state->turn, &state->scratch);
 
-			if (state->map.data[ent->y * state->map.width + ent->x].light) {
-				int seed_x = rand() % 7;
-				int seed_y = rand() % 7;
-				state_main_game_mob_run_ai(ent, state, possible_distances[seed_x], possible_distances[seed_y]);
-			}
+	/* Only mobs with enough energy act in this turn. Others aren't even looked at */
+	arena_mark mark = arena_get_mark(&state->scratch);
+	size_t *due = arena_alloc(&state->scratch, state->wake.schedule.count * sizeof(size_t));
+	size_t due_count = due ? mob_wake_set_pop(&state->wake, state->entities.health,
+	                                          state->turn, due) : 0;
+	PROFILE_COUNT(PROFILE_COUNTER_MOBS_DUE, due_count);
+
+	if (job->capacity < due_count) {
+		mob_ai_plan *plans = realloc(job->plans, due_count * sizeof(mob_ai_plan));
+		if (plans) {
+			job->plans    = plans;
+			job->capacity = due_count;
+		}
+	}
+
+	/*
+	 * Only mobs on lit tiles run the full AI (others are moved by state_main_game_mobs_run_lod).
+	 * Random numbers are generated here, in the same order as when plans were made one at a
+	 * time, so that the game is the same no matter how many threads plans are made on.
+	 */
+	mob_schedule *schedule = &state->wake.schedule;
+	size_t unlit = 0;
+	state->acting_count = 0;
+	for (size_t i = 0; i < due_count; ++i) {
+		size_t mob = due[i];
+		int speed = entity_get_speed(state->entities.type[mob]);
+		if (!state->map.data[state->entities.y[mob] * state->map.width +
+		                     state->entities.x[mob]].light) {
+			due[unlit++] = mob;
+		} else if (state->acting_count < job->capacity) {
+			mob_ai_plan *plan = &job->plans[state->acting_count];
+			state->acting[state->acting_count++] = mob;
+			plan->distance_x = possible_distances[rng_range(&state->rng, 7)];
+			plan->distance_y = possible_distances[rng_range(&state->rng, 7)];
+			mob_schedule_spend(schedule, mob, state->turn, speed, ENTITY_ACTION_ENERGY);
+		} else {
+			/* No memory for the plan. Try again in the next turn */
+			mob_schedule_add(schedule, mob, state->turn + 1, schedule->energy[mob]);
 		}
 	}
+	job->count   = state->acting_count;
+	job->state   = state;
+	job->pending = 1;
+
+	/* Coarse moves don't touch what plans are made from (lit mobs and the map) */
+	state_main_game_mobs_run_lod(state, due, unlit);
+	arena_restore(&state->scratch, mark);
+
+	job->running = background && job->count &&
+	               pthread_create(&job->thread, NULL, mob_ai_job_run, job) == 0;
+	if (!job->running)
+		mob_ai_job_run(job);
+
+	TRACE_END("Mobs AI");
+}
+
+void state_main_game_mobs_finish_ai(state_main_game_data *state) {
+	mob_ai_job *job = state->ai;
+	if (!job->pending) return;
+
+	TRACE_BEGIN("Mobs AI commit");
+	if (job->running) {
+		pthread_join(job->thread, NULL);
+		job->running = 0;
+	}
+
+	/* Plans are applied in a fixed order (attacks allocate memory and move entities) */
+	for (size_t i = 0; i < job->count; ++i) {
+		size_t mob = state->acting[i];
+		if (state->entities.health[mob] > 0) {
+			mob_ai_plan_commit(mob, state, job->plans[i]);
+		} else {
+			animation_sequence_free(NULL, job->plans[i].path); /* Killed by the player meanwhile */
+			if (state->paths)
+				path_search_free(&state->paths[mob]);
+		}
+	}
+	job->pending = 0;
+	TRACE_END("Mobs AI commit");
+}
+
+void state_main_game_mobs_run_ai(state_main_game_data *state) {
+	state_main_game_mobs_start_ai(state, 0);
+	state_main_game_mobs_finish_ai(state);
+}
+
+/**
+ * @brief Gets the current time (in microseconds) from a monotonic clock
+ * @author A104348 Humberto Gomes
+ */
+uint64_t mob_lod_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief   Moves a mob that isn't lit, but isn't far from the player, to a neighbor cell of the
+ *          ::mob_lod_grid
+ * @details Mobs either wander or get closer to the player. When the destination is lit, mobs walk
+ *          into the light a single tile at a time, and that movement is animated.
+ * @returns 1 if the mob moved, 0 otherwise
+ *
+ * @author A104348 Humberto Gomes
+ */
+int state_main_game_mob_coarse_move(size_t mob, state_main_game_data *state) {
+	entity_set entities = state->entities;
+	const map *m = &state->map;
+	int x = entities.x[mob], y = entities.y[mob];
+
+	/* Don't use the game's generator, so that coarse moves don't change the rest of the game */
+	rng rng = rng_create(state->turn, mob);
+	int dx = (PLAYER_X(state) > x) - (PLAYER_X(state) < x);
+	int dy = (PLAYER_Y(state) > y) - (PLAYER_Y(state) < y);
+	if (rng_range(&rng, 4)) { /* Mostly wander */
+		dx = rng_range(&rng, 3) - 1;
+		dy = rng_range(&rng, 3) - 1;
+	}
+
+	/* Try going diagonally, and then along each axis */
+	int directions[3][2] = { { dx, dy }, { dx, 0 }, { 0, dy } };
+	for (int d = 0; d < 3; ++d) {
+		int ddx = directions[d][0], ddy = directions[d][1], tx, ty;
+		if ((ddx == 0 && ddy == 0) || (d > 0 && (dx == 0 || dy == 0))) continue;
+		if (!mob_lod_grid_step(&state->lod, m, x, y, ddx, ddy, &tx, &ty)) continue;
+
+		int lit = m->data[ty * m->width + tx].light;
+		if (lit) {
+			/* Walk into the light one tile at a time */
+			tx = x + ddx; ty = y + ddy;
+			if (m->data[ty * m->width + tx].type != TILE_EMPTY) continue;
+		}
+
+		/* Don't stack mobs */
+		size_t live_count;
+		entity_set_get_live(entities, &live_count);
+		if (entity_set_find_at(entities, 0, tx, ty) < live_count) continue;
+
+		if (lit) {
+			/* Animated, to be seen by the player */
+			animation_step step = { .x = tx, .y = ty };
+			entities.cold[mob].animation.length = 0;
+			animation_sequence_add_step(entity_set_get_animation_pool(entities),
+			                            &entities.cold[mob].animation, step);
+			state->acting[state->acting_count++] = mob;
+		} else {
+			/* Unseen by the player: jump to the destination */
+			entity_set_move(entities, mob, tx, ty);
+		}
+		return 1;
+	}
+
+	return 0;
+}
+
+void state_main_game_mobs_run_lod(state_main_game_data *state, const size_t *mobs,
+                                  size_t count) {
+	PROFILE_START(PROFILE_TIMER_LOD);
+	TRACE_BEGIN("Mobs LOD");
+
+	mob_schedule *schedule = &state->wake.schedule;
+	uint64_t start = mob_lod_now();
+	size_t moved = 0, deferred = 0;
+	for (size_t i = 0; i < count; ++i) {
+		size_t mob = mobs[i];
+		if (mob_lod_budget && (i + 1) % MOB_LOD_BUDGET_CHECK == 0 &&
+		    mob_lod_now() - start > mob_lod_budget) {
+			/* Out of time. Move these mobs in the next turn */
+			deferred = count - i;
+			for (; i < count; ++i)
+				mob_schedule_add(schedule, mobs[i], state->turn + 1, schedule->energy[mobs[i]]);
+			break;
+		}
+
+		/* A coarse move covers as much ground as many single-tile moves */
+		if (state_main_game_mob_coarse_move(mob, state)) {
+			moved++;
+			if (state->paths)
+				path_search_free(&state->paths[mob]); /* Its search started elsewhere */
+		}
+		mob_schedule_spend(schedule, mob, state->turn, entity_get_speed(state->entities.type[mob]),
+		                   MOB_LOD_PERIOD * ENTITY_ACTION_ENERGY);
+	}
+
+	PROFILE_COUNT(PROFILE_COUNTER_LOD_MOVES, moved);
+	PROFILE_COUNT(PROFILE_COUNTER_LOD_DEFERRED, deferred);
+	TRACE_END("Mobs LOD");
+	PROFILE_STOP(PROFILE_TIMER_LOD);
 }
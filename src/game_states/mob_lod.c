@@ -0,0 +1,105 @@
+/**
+ * @file mob_lod.c
+ * @brief Coarse passability grid, for cheap movement of mobs far from the player
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <alloc_track.h>
+#include <game_states/mob_lod.h>
+
+#include <stdlib.h>
+
+/**
+ * @brief Chooses the representative tile of a cell of a ::mob_lod_grid
+ * @returns The position of the tile in the cell, or ::MOB_LOD_BLOCKED if the cell isn't passable
+ *
+ * @author A104348 Humberto Gomes
+ */
+uint8_t mob_lod_grid_choose_tile(const map *map, unsigned cx, unsigned cy) {
+	int side = 1 << MOB_LOD_CELL_SHIFT, center = side - 1; /* Doubled, to avoid fractions */
+	int empty = 0, best_dist = INT32_MAX;
+	uint8_t best = MOB_LOD_BLOCKED;
+
+	for (int oy = 0; oy < side; ++oy) {
+		unsigned y = (cy << MOB_LOD_CELL_SHIFT) + oy;
+		for (int ox = 0; ox < side; ++ox) {
+			unsigned x = (cx << MOB_LOD_CELL_SHIFT) + ox;
+			if (x >= map->width || y >= map->height ||
+			    map->data[y * map->width + x].type != TILE_EMPTY)
+				continue;
+
+			empty++;
+			int dist = abs(2 * ox - center) + abs(2 * oy - center);
+			if (dist < best_dist) {
+				best_dist = dist;
+				best = (oy << MOB_LOD_CELL_SHIFT) | ox;
+			}
+		}
+	}
+
+	return 2 * empty >= side * side ? best : MOB_LOD_BLOCKED;
+}
+
+mob_lod_grid mob_lod_grid_create(const map *map) {
+	unsigned side = 1 << MOB_LOD_CELL_SHIFT;
+	mob_lod_grid ret = {
+		.width  = (map->width  + side - 1) >> MOB_LOD_CELL_SHIFT,
+		.height = (map->height + side - 1) >> MOB_LOD_CELL_SHIFT
+	};
+
+	ALLOC_TAG_BEGIN(ALLOC_TAG_MAP_GENERATION);
+	ret.cells = malloc((size_t) ret.width * ret.height);
+	ALLOC_TAG_END();
+	if (!ret.cells) return ret;
+
+	for (unsigned cy = 0; cy < ret.height; ++cy)
+		for (unsigned cx = 0; cx < ret.width; ++cx)
+			ret.cells[cy * ret.width + cx] = mob_lod_grid_choose_tile(map, cx, cy);
+
+	return ret;
+}
+
+void mob_lod_grid_free(mob_lod_grid grid) {
+	free(grid.cells);
+}
+
+int mob_lod_grid_step(const mob_lod_grid *grid, const map *map, int x, int y, int dx, int dy,
+                      int *tx, int *ty) {
+
+	int cx = (x >> MOB_LOD_CELL_SHIFT) + dx, cy = (y >> MOB_LOD_CELL_SHIFT) + dy;
+	if (x < 0 || y < 0 || cx < 0 || cy < 0 ||
+	    (unsigned) cx >= grid->width || (unsigned) cy >= grid->height)
+		return 0;
+
+	uint8_t cell = grid->cells[cy * grid->width + cx];
+	if (cell == MOB_LOD_BLOCKED) return 0;
+
+	/* Keep the position inside the cell if possible, not to pile up mobs in the same tile */
+	int side = 1 << MOB_LOD_CELL_SHIFT;
+	int nx = x + dx * side, ny = y + dy * side;
+	if ((unsigned) nx >= map->width || (unsigned) ny >= map->height ||
+	    map->data[ny * map->width + nx].type != TILE_EMPTY) {
+
+		nx = (cx << MOB_LOD_CELL_SHIFT) | (cell & (side - 1));
+		ny = (cy << MOB_LOD_CELL_SHIFT) | (cell >> MOB_LOD_CELL_SHIFT);
+	}
+
+	*tx = nx;
+	*ty = ny;
+	return 1;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file mob_schedule.c
+ * @brief Timing wheel of the turns when awake mobs act next
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <alloc_track.h>
+#include <game_states/mob_schedule.h>
+
+#include <stdlib.h>
+
+mob_schedule mob_schedule_create(size_t capacity) {
+	ALLOC_TAG_BEGIN(ALLOC_TAG_ENTITIES);
+	mob_schedule ret = {
+		.next     = malloc(capacity * sizeof(size_t)),
+		.previous = malloc(capacity * sizeof(size_t)),
+		.due      = malloc(capacity * sizeof(unsigned int)),
+		.energy   = malloc(capacity * sizeof(int)),
+		.count    = 0,
+		.now      = 0
+	};
+	ALLOC_TAG_END();
+
+	if (!ret.next || !ret.previous || !ret.due || !ret.energy) {
+		mob_schedule_free(ret);
+		return (mob_schedule) { .next = NULL, .previous = NULL, .due = NULL, .energy = NULL };
+	}
+
+	for (size_t i = 0; i < capacity; ++i)
+		ret.previous[i] = MOB_SCHEDULE_UNSCHEDULED;
+	for (size_t i = 0; i < MOB_SCHEDULE_WHEEL_SIZE; ++i)
+		ret.first[i] = ret.last[i] = MOB_SCHEDULE_NONE;
+	return ret;
+}
+
+void mob_schedule_free(mob_schedule schedule) {
+	free(schedule.next);
+	free(schedule.previous);
+	free(schedule.due);
+	free(schedule.energy);
+}
+
+int mob_schedule_contains(const mob_schedule *schedule, size_t mob) {
+	return schedule->previous[mob] != MOB_SCHEDULE_UNSCHEDULED;
+}
+
+/**
+ * @brief Appends a mob to the list of a bucket of a ::mob_schedule
+ * @author A104348 Humberto Gomes
+ */
+void mob_schedule_append(mob_schedule *schedule, size_t bucket, size_t mob) {
+	size_t last = schedule->last[bucket];
+	schedule->next[mob]     = MOB_SCHEDULE_NONE;
+	schedule->previous[mob] = last;
+
+	if (last == MOB_SCHEDULE_NONE)
+		schedule->first[bucket] = mob;
+	else
+		schedule->next[last] = mob;
+	schedule->last[bucket] = mob;
+}
+
+void mob_schedule_add(mob_schedule *schedule, size_t mob, unsigned int due, int energy) {
+	/* Turns may wrap around, so they're compared by their difference */
+	if ((int) (due - schedule->now) < 0) due = schedule->now;
+
+	schedule->due[mob]    = due;
+	schedule->energy[mob] = energy;
+	mob_schedule_append(schedule, due & (MOB_SCHEDULE_WHEEL_SIZE - 1), mob);
+	schedule->count++;
+}
+
+void mob_schedule_remove(mob_schedule *schedule, size_t mob) {
+	size_t previous = schedule->previous[mob], next = schedule->next[mob];
+	if (previous == MOB_SCHEDULE_UNSCHEDULED) return;
+
+	size_t bucket = schedule->due[mob] & (MOB_SCHEDULE_WHEEL_SIZE - 1);
+	if (previous == MOB_SCHEDULE_NONE)
+		schedule->first[bucket] = next;
+	else
+		schedule->next[previous] = next;
+
+	if (next == MOB_SCHEDULE_NONE)
+		schedule->last[bucket] = previous;
+	else
+		schedule->previous[next] = previous;
+
+	schedule->previous[mob] = MOB_SCHEDULE_UNSCHEDULED;
+	schedule->count--;
+}
+
+void mob_schedule_spend(mob_schedule *schedule, size_t mob, unsigned int turn, int speed,
+                        int cost) {
+
+	/* Wait for the missing energy, but never act more than once per turn */
+	int energy = schedule->energy[mob], missing = cost - energy;
+	int turns = missing > speed ? (missing + speed - 1) / speed : 1;
+	mob_schedule_add(schedule, mob, turn + turns, energy + turns * speed - cost);
+}
+
+size_t mob_schedule_pop(mob_schedule *schedule, unsigned int turn, size_t *mobs) {
+	size_t bucket = turn & (MOB_SCHEDULE_WHEEL_SIZE - 1), count = 0;
+	size_t mob = schedule->first[bucket];
+	schedule->first[bucket] = schedule->last[bucket] = MOB_SCHEDULE_NONE;
+	schedule->now = turn + 1;
+
+	while (mob != MOB_SCHEDULE_NONE) {
+		size_t next = schedule->next[mob];
+		if ((int) (schedule->due[mob] - turn) <= 0) {
+			schedule->previous[mob] = MOB_SCHEDULE_UNSCHEDULED;
+			schedule->count--;
+			mobs[count++] = mob;
+		} else {
+			/* Due on a later revolution of the wheel */
+			mob_schedule_append(schedule, bucket, mob);
+		}
+		mob = next;
+	}
+
+	return count;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file mob_wake.c
+ * @brief Set of mobs woken up by events around them (light, combat noise and deaths)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <alloc_track.h>
+#include <game_states/mob_wake.h>
+#include <profile.h>
+
+#include <stdlib.h>
+
+mob_wake_set mob_wake_set_create(size_t capacity) {
+	ALLOC_TAG_BEGIN(ALLOC_TAG_ENTITIES);
+	mob_wake_set ret = {
+		.schedule = mob_schedule_create(capacity),
+		.woken    = malloc(capacity * sizeof(unsigned int))
+	};
+	ALLOC_TAG_END();
+
+	if (!ret.schedule.next || !ret.woken) {
+		mob_wake_set_free(ret);
+		return (mob_wake_set) { .schedule = { .next = NULL }, .woken = NULL };
+	}
+	return ret;
+}
+
+void mob_wake_set_free(mob_wake_set set) {
+	mob_schedule_free(set.schedule);
+	free(set.woken);
+}
+
+void mob_wake_set_wake(mob_wake_set *set, entity_set entities, int x, int y, int radius,
+                       unsigned int turn, arena *scratch) {
+
+	/* Round the area out to whole cells (arithmetic shifts round towards -infinity) */
+	int x0 = ((x - radius) >> MOB_WAKE_CELL_SHIFT) << MOB_WAKE_CELL_SHIFT;
+	int y0 = ((y - radius) >> MOB_WAKE_CELL_SHIFT) << MOB_WAKE_CELL_SHIFT;
+	int x1 = ((((x + radius) >> MOB_WAKE_CELL_SHIFT) + 1) << MOB_WAKE_CELL_SHIFT) - 1;
+	int y1 = ((((y + radius) >> MOB_WAKE_CELL_SHIFT) + 1) << MOB_WAKE_CELL_SHIFT) - 1;
+
+	arena_mark mark = arena_get_mark(scratch);
+	size_t live_count;
+	entity_set_get_live(entities, &live_count);
+	size_t *mobs = arena_alloc(scratch, live_count * sizeof(size_t));
+	size_t count = entity_set_get_in_area_unordered(entities, x0, y0, x1, y1, mobs), woken = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		size_t mob = mobs[i];
+		if (entities.type[mob] == ENTITY_PLAYER || entities.health[mob] <= 0) continue;
+
+		if (!mob_schedule_contains(&set->schedule, mob))
+			mob_schedule_add(&set->schedule, mob, turn, 0); /* Act as soon as possible */
+		set->woken[mob] = turn;
+		woken++;
+	}
+
+	arena_restore(scratch, mark);
+	PROFILE_COUNT(PROFILE_COUNTER_MOBS_WOKEN, woken);
+}
+
+void mob_wake_set_sleep(mob_wake_set *set, size_t mob) {
+	mob_schedule_remove(&set->schedule, mob);
+}
+
+size_t mob_wake_set_pop(mob_wake_set *set, const int *health, unsigned int turn, size_t *mobs) {
+	size_t count = mob_schedule_pop(&set->schedule, turn, mobs), awake = 0;
+
+	/* Not scheduling mobs again puts them to sleep */
+	for (size_t i = 0; i < count; ++i) {
+		size_t mob = mobs[i];
+		if (health[mob] > 0 && turn - set->woken[mob] < MOB_WAKE_IDLE_TURNS)
+			mobs[awake++] = mob;
+	}
+	return awake;
+}
@@ -22,6 +22,7 @@
 #include <game_state.h>
 #include <game_states/msg_box.h>
 #include <menu_tools.h>
+#include <alloc_track.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -140,7 +141,7 @@ game_loop_callback_return_value state_msg_box_onrender(void *s, int width, int h
 		addch(' ');
 	}
 
-	refresh();
+	game_loop_refresh();
 
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
@@ -162,6 +163,8 @@ game_state state_msg_box_create(game_state parent, state_msg_box_exit_callback e
                                 const char *msg,
                                 const char **buttons, int button_count, int default_button) {
 
+	ALLOC_TAG_BEGIN(ALLOC_TAG_MSG_BOX);
+
 	/* Allocate space for the message (owned by this game state) */
 	char *msg_cpy = malloc(strlen(msg) + 1);
 	strcpy(msg_cpy, msg);
@@ -201,6 +204,7 @@ game_state state_msg_box_create(game_state parent, state_msg_box_exit_callback e
 		.callbacks = callbacks
 	};
 
+	ALLOC_TAG_END();
 	return ret;
 }
 
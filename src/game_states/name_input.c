@@ -52,7 +52,7 @@ game_loop_callback_return_value state_name_input_oninput(void *s, int key) {
 		}
 
 		case '\r': { /* Enter - proceed to game if the name is not empty */
-			game_state new = state_main_game_create(state->name);
+			game_state new = state_main_game_create(state->name, state_main_game_next_seed());
 			state_switch((game_state *) s, &new, 1);
 			break;
 		}
@@ -109,7 +109,7 @@ game_loop_callback_return_value state_name_input_onrender(void *s, int width, in
 	move(top + 3, left + 1);
 		printw("%s", state->name);
 
-	refresh();
+	game_loop_refresh();
 
 	return GAME_LOOP_CALLBACK_RETURN_SUCCESS;
 }
@@ -23,18 +23,10 @@
 #include <combat.h>
 #include <game_states/main_game.h>
 #include <game_states/msg_box.h>
+#include <game_states/player_action.h>
 
 #include <ncurses.h>
 
-/**
- * @brief Verifies if a player position is valid (inside the map, not a wall, ...)
- * @param state A pointer to the main game state data.
- * @param x The x coordinate of the player.
- * @param y The y coordinate of the player.
- * @return 1 if the position is valid, 0 otherwise.
- *
- * @author A90817 Mariana Rocha
- */
 int state_main_game_verify_player_position(state_main_game_data *state, int x, int y) {
 	return (x >= 0 && y >= 0 &&
 	        (unsigned)x < state->map.height && (unsigned)y < state->map.width &&
@@ -63,27 +55,26 @@ void state_main_game_move_player(state_main_game_data *state, int key) {
 
 	int x, y;
 	animation_step last_pos;
+	animation_step *steps = animation_sequence_get_steps(&PLAYER_COLD(state).animation);
 
 	/*
 	 * Define the current position and the last position. This depends on length of the
 	 * animation.
 	 */
-	if (PLAYER(state).animation.length == 0) {
+	if (PLAYER_COLD(state).animation.length == 0) {
 		last_pos.x = -1; last_pos.y = -1; /* Invalid position for later */
-		x = PLAYER(state).x; y = PLAYER(state).y;
+		x = PLAYER_X(state); y = PLAYER_Y(state);
 	}
-	else if (PLAYER(state).animation.length == 1) {
-		last_pos.x = PLAYER(state).x; last_pos.y = PLAYER(state).y;
+	else if (PLAYER_COLD(state).animation.length == 1) {
+		last_pos.x = PLAYER_X(state); last_pos.y = PLAYER_Y(state);
 
-		animation_step current_pos =
-			PLAYER(state).animation.steps[PLAYER(state).animation.length - 1];
+		animation_step current_pos = steps[PLAYER_COLD(state).animation.length - 1];
 		x = current_pos.x; y = current_pos.y;
 
 	} else {
-		last_pos = PLAYER(state).animation.steps[PLAYER(state).animation.length - 2];
+		last_pos = steps[PLAYER_COLD(state).animation.length - 2];
 
-		animation_step current_pos =
-			PLAYER(state).animation.steps[PLAYER(state).animation.length - 1];
+		animation_step current_pos = steps[PLAYER_COLD(state).animation.length - 1];
 		x = current_pos.x; y = current_pos.y;
 	}
 
@@ -99,9 +90,10 @@ void state_main_game_move_player(state_main_game_data *state, int key) {
 		if (last_pos.x == step.x && last_pos.y == step.y) {
 			/* Player wants to go back. Revert last movement */
 			/* This won't trigger if the last postion is invalid */
-			PLAYER(state).animation.length--;
+			PLAYER_COLD(state).animation.length--;
 		} else {
-			animation_sequence_add_step(&PLAYER(state).animation, step);
+			animation_sequence_add_step(entity_set_get_animation_pool(state->entities),
+			                            &PLAYER_COLD(state).animation, step);
 		}
 	} else {
 		beep();
@@ -125,31 +117,32 @@ void state_main_game_move_cursor(state_main_game_data *state, int key) {
 
 void state_main_game_attack_cursor(state_main_game_data *state, game_state *box_state) {
 
-	/* Get entity in the cursor postion */
-	entity *target = NULL;
-	for (size_t i = 1; i < state->entities.count; ++i) { /* Start at one not to attack player */
-		if (state->entities.entities[i].health <= 0) continue;
-
-		if (state->entities.entities[i].x == state->cursorx &&
-		    state->entities.entities[i].y == state->cursory) {
-			target = &state->entities.entities[i];
+	/* Get entity in the cursor postion (always lit), not to attack the player */
+	size_t target = PLAYER_INDEX;
+	for (size_t k = 0; k < state->lit_count; ++k) {
+		size_t i = state->lit[k];
+		if (i != PLAYER_INDEX && state->entities.health[i] > 0 &&
+		    state->entities.x[i] == state->cursorx && state->entities.y[i] == state->cursory) {
+			target = i;
 			break;
 		}
 	}
 
 	/* Try to attack entity */
-	if (target) {
-		if (combat_can_attack(&PLAYER(state), target, &state->map)) {
-			combat_attack(&PLAYER(state), target, &state->map);
-			state->action = MAIN_GAME_ANIMATING_PLAYER_COMBAT;
+	if (target != PLAYER_INDEX) {
+		if (combat_can_attack(state->entities, PLAYER_INDEX, target, &state->map)) {
+			combat_attack(state->entities, PLAYER_INDEX, target, &state->map);
+			state_main_game_set_action(state, MAIN_GAME_ANIMATING_PLAYER_COMBAT);
 		} else {
 			const char *button = "OK";
+			state->needs_rerender = MAIN_GAME_REDRAW_ALL;
 			game_state msg = state_msg_box_create(*box_state, NULL, "Out of range weapon!",
 				&button, 1, 0);
 			state_switch(box_state, &msg, 0);
 		}
 	} else {
 		const char *button = "OK";
+		state->needs_rerender = MAIN_GAME_REDRAW_ALL;
 		game_state msg = state_msg_box_create(*box_state, NULL, "No mob here!", &button, 1, 0);
 		state_switch(box_state, &msg, 0);
 	}
@@ -157,21 +150,22 @@ void state_main_game_attack_cursor(state_main_game_data *state, game_state *box_
 
 void state_main_game_draw_player_path(state_main_game_data *state, const map_window *wnd) {
 
-	attron(COLOR_PAIR(COLOR_WHITE) | A_REVERSE);
-	animation_sequence seq = PLAYER(state).animation;
+	wattron(wnd->win, COLOR_PAIR(COLOR_WHITE) | A_REVERSE);
+	animation_sequence *seq = &PLAYER_COLD(state).animation;
+	animation_step *steps = animation_sequence_get_steps(seq);
 
-	for (size_t i = (size_t) state->animation_step; i < seq.length; ++i) {
-		animation_step step = seq.steps[i];
+	for (size_t i = (size_t) state->animation_step; i < seq->length; ++i) {
+		animation_step step = steps[i];
 
 		if (map_window_visible(step.x, step.y, wnd)) { /* Don't draw out-of-screen paths */
 
 			int screenx, screeny;
 			map_window_to_screen(wnd, step.x, step.y, &screenx, &screeny);
-			mvaddch(screeny, screenx, ' ');
+			mvwaddch(wnd->win, screeny, screenx, ' ');
 		}
 	}
 
-	attroff(COLOR_PAIR(COLOR_WHITE) | A_REVERSE);
+	wattroff(wnd->win, COLOR_PAIR(COLOR_WHITE) | A_REVERSE);
 }
 
 void state_main_game_draw_cursor(state_main_game_data *state, const map_window *wnd) {
@@ -180,9 +174,9 @@ void state_main_game_draw_cursor(state_main_game_data *state, const map_window *
 		int screenx = wnd->term_left + (state->cursorx - wnd->map_left),
 		    screeny = wnd->term_top  + (state->cursory - wnd->map_top);
 
-		attron(COLOR_PAIR(COLOR_BLACK) | A_REVERSE);
-		mvaddch(screeny, screenx, ' ');
-		attroff(COLOR_PAIR(COLOR_BLACK) | A_REVERSE);
+		wattron(wnd->win, COLOR_PAIR(COLOR_BLACK) | A_REVERSE);
+		mvwaddch(wnd->win, screeny, screenx, ' ');
+		wattroff(wnd->win, COLOR_PAIR(COLOR_BLACK) | A_REVERSE);
 	}
 }
 
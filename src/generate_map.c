@@ -21,10 +21,11 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include <core.h>
 #include <generate_map.h>
 #include <map.h>
+#include <trace.h>
+#include <alloc_track.h>
 
 #include <entities/rat.h>
 #include <entities/goblin.h>
@@ -34,7 +35,6 @@
 #define MAP_WIDTH 1024
 #define MAP_HEIGHT 1024
 
-#define ENTITY_COUNT 2500
 #define TILE_PERCENTAGE 45
 
 #define ENTITY_PLAYER_HEALTH 10
@@ -115,29 +115,8 @@ void map_swap(map *a, map *b) {
 	*b = tmp;
 }
 
-/**
- * @brief Fills a map with natural-looking blobs of a certain tile type.
- *
- * @param scratch_map A map that will be used for intermediate computations (will be altered).
- *                    Must be the same size as @p map.
- * @param map Struct containing the map (for output)
- * @param radius1 The radius used in the smoothing process for the walls
- * @param radius2 The radius used in the smoothing process for the walls
- * @param tile The type of tile to be placed in the empty map
- *
- * @details
- *
- * 1. The function fills the map grid randomly with tiles of type @p tile and empty spaces.
- * 2. The walls are smoothed by replacing the wall tile type of each cell with
- *    the empty tile type if it has fewer than @p radius2 wall neighbors or more than radius1 wall
- *    neighbors within a given radius.
- * 3. This process is repeated again, but with a fixed internal radius.
- *
- * @author A104082 Pedro Pereira
- * @author A104348 Humberto Gomes
- */
-void generate_random(map scratch_map, map map, int radius1, int radius2, tile_type tile) {
-	srand(time(NULL));
+void generate_random(map scratch_map, map map, int radius1, int radius2, tile_type tile,
+                     rng noise) {
 
 	// Initialize empty map data to prevent access to uninitialized data
 	map_zero(map);
@@ -146,7 +125,7 @@ void generate_random(map scratch_map, map map, int radius1, int radius2, tile_ty
 	// Randomly generate the tile everywhere
 	unsigned tile_count = map.width * map.height;
 	for (unsigned i = 0; i < tile_count; ++i) {
-		map.data[i].type = ((rand()%100) < TILE_PERCENTAGE) ? tile : TILE_EMPTY;
+		map.data[i].type = (rng_range(&noise, 100) < TILE_PERCENTAGE) ? tile : TILE_EMPTY;
 	}
 
 	// Smooths the tiles
@@ -234,36 +213,49 @@ void draw_border(map map) {
  */
 void entity_spawn(state_main_game_data *data){
 
-	for (int i = 1; i < ENTITY_COUNT; ++i) {
+	for (size_t i = 1; i < data->entities.capacity; ++i) {
 
-		int seed = rand() % 100 + 1;
+		int seed = rng_range(&data->rng, 100) + 1;
 
 		unsigned x, y;
 		do {
-			x = rand() % MAP_WIDTH;
-			y = rand() % MAP_WIDTH;
+			x = rng_range(&data->rng, MAP_WIDTH);
+			y = rng_range(&data->rng, MAP_WIDTH);
 		} while (data->map.data[y * data->map.width + x].type != TILE_EMPTY);
 
 		if (seed < 50) {
-			data->entities.entities[i] = entity_create_rat(x, y, ENTITY_RAT_HEALTH);
+			entity_set_spawn(data->entities, entity_create_rat(x, y, ENTITY_RAT_HEALTH));
 		} else if (seed >= 50 && seed < 85) {
-			data->entities.entities[i] = entity_create_goblin(x, y, ENTITY_GOBLIN_HEALTH);
+			entity_set_spawn(data->entities,
+				entity_create_goblin(x, y, ENTITY_GOBLIN_HEALTH, &data->rng));
 		} else {
-			data->entities.entities[i] = entity_create_cristino(x, y, ENTITY_CRISTINO_HEALTH);
+			entity_set_spawn(data->entities,
+				entity_create_cristino(x, y, ENTITY_CRISTINO_HEALTH, &data->rng));
 		}
 	}
 }
 
 /**
- * @brief Spawns the player entity and opens a safe starting area on the map.
+ * @brief   Spawns the player entity on the center of the map.
+ * @details Must be called before any other entity is spawned, for the player to be the first one.
  * @param data Pointer to the main game state data.
  *
  * @author A104082 Pedro Pereira
  */
 void player_spawn(state_main_game_data *data){
-
 	int playerx = data->map.width / 2, playery = data->map.height / 2;
-	data->entities.entities[0] = entity_create_player(playerx, playery, ENTITY_PLAYER_HEALTH);
+	entity_set_spawn(data->entities, entity_create_player(playerx, playery, ENTITY_PLAYER_HEALTH));
+}
+
+/**
+ * @brief Opens a safe starting area around the player.
+ * @param data Pointer to the main game state data.
+ *
+ * @author A104082 Pedro Pereira
+ */
+void player_open_starting_area(state_main_game_data *data){
+
+	int playerx = PLAYER_X(data), playery = PLAYER_Y(data);
 
 	// Open a safe place to start
 	for (unsigned y = playery - STARTER_CIRCLE; y < data->map.height; y++) {
@@ -279,32 +271,52 @@ void player_spawn(state_main_game_data *data){
 	}
 }
 
+/** @brief Number of entities in generated maps (see ::generate_map_set_entity_count) */
+static size_t generate_map_entity_count = GENERATE_MAP_DEFAULT_ENTITIES;
+
+void generate_map_set_entity_count(size_t count) {
+	generate_map_entity_count = max(1, min(count, (size_t) ENTITY_HANDLE_INDEX_MASK + 1));
+}
+
 void generate_map_random(state_main_game_data *data) {
+	TRACE_BEGIN("Map generation");
+	ALLOC_TAG_BEGIN(ALLOC_TAG_MAP_GENERATION);
 
 	map scratch_map = map_allocate(MAP_WIDTH, MAP_HEIGHT); /* For temporary calculations */
 
 	data->map = map_allocate(MAP_WIDTH, MAP_HEIGHT);
-	data->entities = entity_set_allocate(ENTITY_COUNT);
+	data->entities = entity_set_allocate(generate_map_entity_count, MAP_WIDTH, MAP_HEIGHT);
 
 	// Randomly generate water map
-	generate_random(scratch_map, data->map, 6, 1, TILE_WATER);
+	TRACE_BEGIN("Water");
+	generate_random(scratch_map, data->map, 6, 1, TILE_WATER, data->rng);
+	TRACE_END("Water");
 
-	// Randomly generate new map with walls
+	// Randomly generate new map with walls (from the same noise as water)
+	TRACE_BEGIN("Walls");
 	map wall_map = map_allocate(MAP_WIDTH, MAP_HEIGHT);
-	generate_random(scratch_map, wall_map, 5, 2, TILE_WALL);
+	generate_random(scratch_map, wall_map, 5, 2, TILE_WALL, data->rng);
+	TRACE_END("Walls");
 
 	// Intersect the two maps
+	TRACE_BEGIN("Intersection and border");
 	intersect_maps(wall_map, data->map, data->map);
 
 	// Draw border with walls
 	draw_border(data->map);
+	TRACE_END("Intersection and border");
 
 	// Populate the map with entities and the player
-	entity_spawn(data);
+	TRACE_BEGIN("Spawning");
 	player_spawn(data);
+	entity_spawn(data);
+	player_open_starting_area(data);
+	TRACE_END("Spawning");
 
 	// Free temporary data
 	map_free(wall_map);
 	map_free(scratch_map);
+	ALLOC_TAG_END();
+	TRACE_END("Map generation");
 }
 
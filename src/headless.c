@@ -0,0 +1,232 @@
+/**
+ * @file headless.c
+ * @brief Simulation of the game without a terminal, for benchmarking
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <headless.h>
+
+#include <combat.h>
+#include <game_states/main_game.h>
+#include <game_states/main_game_animation.h>
+#include <game_states/player_action.h>
+#include <game_states/mob_action.h>
+#include <game_states/illumination.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ncurses.h>
+
+/** @brief Maximum number of steps the scripted player walks per turn */
+#define HEADLESS_MAX_PLAYER_STEPS 4
+
+/** @brief Names of each ::headless_phase, for printing */
+static const char *const HEADLESS_PHASE_NAMES[HEADLESS_PHASE_COUNT] = {
+	"Map generation", "Player", "Lighting", "Mob AI", "Combat", "Animation"
+};
+
+const char *headless_phase_get_name(headless_phase phase) {
+	return HEADLESS_PHASE_NAMES[phase];
+}
+
+/**
+ * @brief Gets the CPU time (in seconds) used by the calling thread
+ * @author A104348 Humberto Gomes
+ */
+double headless_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Adds the time since @p start to a ::headless_timer
+ * @author A104348 Humberto Gomes
+ */
+void headless_timer_stop(headless_timer *timer, double start) {
+	double elapsed = headless_now() - start;
+
+	timer->calls++;
+	timer->total += elapsed;
+	if (elapsed > timer->max) timer->max = elapsed;
+}
+
+void headless_timer_merge(headless_timer *total, const headless_timer *timer) {
+	total->calls += timer->calls;
+	total->total += timer->total;
+	if (timer->max > total->max) total->max = timer->max;
+}
+
+/**
+ * @brief Scripted player: walks up to ::HEADLESS_MAX_PLAYER_STEPS steps in a random direction
+ * @author A104348 Humberto Gomes
+ */
+void headless_player_move(state_main_game_data *state) {
+	const int keys[4] = { KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT };
+	const int dx[4] = { 0, 0, -1, 1 }, dy[4] = { -1, 1, 0, 0 };
+
+	int dir = rng_range(&state->rng, 4);
+	int x = PLAYER_X(state), y = PLAYER_Y(state);
+
+	/* Check positions beforehand, as invalid movements beep */
+	for (int i = 0; i < HEADLESS_MAX_PLAYER_STEPS; ++i) {
+		x += dx[dir]; y += dy[dir];
+		if (!state_main_game_verify_player_position(state, x, y)) break;
+
+		state_main_game_move_player(state, keys[dir]);
+	}
+}
+
+/**
+ * @brief Scripted player: attacks the first visible mob within range
+ * @returns 1 if a mob was attacked, 0 otherwise
+ *
+ * @author A104348 Humberto Gomes
+ */
+int headless_player_attack(state_main_game_data *state) {
+	for (size_t k = 0; k < state->lit_count; ++k) {
+		size_t i = state->lit[k];
+		if (i != PLAYER_INDEX && state->entities.health[i] > 0 &&
+		    combat_can_attack(state->entities, PLAYER_INDEX, i, &state->map)) {
+
+			combat_attack(state->entities, PLAYER_INDEX, i, &state->map);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief   Scripted player: accepts dropped weapons and food
+ * @details Does the same as the message boxes shown during the game.
+ *
+ * @author A104348 Humberto Gomes
+ */
+void headless_player_pick_drops(state_main_game_data *state) {
+	if (state->dropped != WEAPON_INVALID) {
+		entity_free_combat_target(state->entities, PLAYER_INDEX);
+		PLAYER_COLD(state).weapon = state->dropped;
+	} else if (state->dropped_food) {
+		PLAYER_HEALTH(state) = PLAYER_COLD(state).max_health;
+	}
+
+	state->dropped = WEAPON_INVALID;
+	state->dropped_food = 0;
+}
+
+/**
+ * @brief Plays an animated action until its end, timing animation and lighting
+ * @author A104348 Humberto Gomes
+ */
+void headless_animate_action(game_state *s, headless_result *result) {
+	state_main_game_data *state = state_extract_data(state_main_game_data, s);
+
+	headless_phase phase = (state->action == MAIN_GAME_ANIMATING_PLAYER_COMBAT ||
+	                        state->action == MAIN_GAME_ANIMATING_MOBS_COMBAT) ?
+	                       HEADLESS_PHASE_COMBAT : HEADLESS_PHASE_ANIMATION;
+
+	int done = 0;
+	while (!done) {
+		double start = headless_now();
+		state_main_game_circle_clean_light_map(
+			state->map, PLAYER_X(state), PLAYER_Y(state), CIRCLE_RADIUS);
+		headless_timer_stop(&result->timers[HEADLESS_PHASE_LIGHTING], start);
+
+		start = headless_now();
+		done = state_main_game_animation_advance(s);
+		headless_timer_stop(&result->timers[phase], start);
+
+		start = headless_now();
+		state_main_game_light(state);
+		headless_timer_stop(&result->timers[HEADLESS_PHASE_LIGHTING], start);
+	}
+
+	headless_player_pick_drops(state);
+}
+
+headless_result headless_run(unsigned int seed, unsigned int turns) {
+	headless_result result;
+	memset(&result, 0, sizeof(headless_result));
+
+	char name[SCORE_NAME_MAX + 1] = "headless";
+
+	double start = headless_now();
+	game_state s = state_main_game_create(name, seed);
+	headless_timer_stop(&result.timers[HEADLESS_PHASE_MAP_GENERATION], start);
+
+	state_main_game_data *state = state_extract_data(state_main_game_data, &s);
+
+	while (result.turns < turns && PLAYER_HEALTH(state) > 0) {
+		/* MAIN_GAME_MOVEMENT_INPUT */
+		start = headless_now();
+		headless_player_move(state);
+		headless_timer_stop(&result.timers[HEADLESS_PHASE_PLAYER], start);
+		state_main_game_set_action(state, MAIN_GAME_ANIMATING_PLAYER_MOVEMENT);
+
+		/* MAIN_GAME_ANIMATING_PLAYER_MOVEMENT */
+		headless_animate_action(&s, &result);
+
+		/* MAIN_GAME_COMBAT_INPUT (the mob AI runs after the player attacks, like in the game) */
+		start = headless_now();
+		int attacked = headless_player_attack(state);
+		headless_timer_stop(&result.timers[HEADLESS_PHASE_PLAYER], start);
+
+		start = headless_now();
+		state_main_game_mobs_run_ai(state);
+		headless_timer_stop(&result.timers[HEADLESS_PHASE_MOB_AI], start);
+
+		state_main_game_set_action(state, attacked ? MAIN_GAME_ANIMATING_PLAYER_COMBAT :
+		                                             MAIN_GAME_ANIMATING_MOBS_MOVEMENT);
+
+		/* Animated actions until the next MAIN_GAME_MOVEMENT_INPUT */
+		while (state->action != MAIN_GAME_MOVEMENT_INPUT && PLAYER_HEALTH(state) > 0)
+			headless_animate_action(&s, &result);
+
+		result.turns++;
+	}
+
+	result.score  = state->score.score;
+	result.health = PLAYER_HEALTH(state);
+	memcpy(result.kills, state->kills, sizeof(result.kills));
+
+	s.destroy(&s);
+	return result;
+}
+
+void headless_print_result(FILE *out, const headless_result *result) {
+	fprintf(out, "Turns: %u, score: %d, health: %d%s\n\n", result->turns, result->score,
+	        result->health, result->health > 0 ? "" : " (dead)");
+
+	fprintf(out, "Kills:");
+	for (int i = 0; i < ENTITY_TYPE_COUNT; ++i)
+		fprintf(out, " %s: %u%s", entity_get_name(i), result->kills[i],
+		        i == ENTITY_TYPE_COUNT - 1 ? "\n\n" : ",");
+
+	fprintf(out, "%-16s %10s %12s %12s %12s\n",
+	        "Phase (CPU)", "Calls", "Total (ms)", "Mean (us)", "Max (us)");
+
+	for (int i = 0; i < HEADLESS_PHASE_COUNT; ++i) {
+		const headless_timer *t = &result->timers[i];
+		double mean = t->calls ? t->total / t->calls : 0.0;
+
+		fprintf(out, "%-16s %10zu %12.3f %12.3f %12.3f\n", HEADLESS_PHASE_NAMES[i], t->calls,
+		        t->total * 1e3, mean * 1e6, t->max * 1e6);
+	}
+}
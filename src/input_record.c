@@ -0,0 +1,216 @@
+/**
+ * @file input_record.c
+ * @brief Recording of user input to a file, for deterministic replays
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <input_record.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INPUT_RECORD_MAGIC "RGLR" /**< @brief First bytes of every recording */
+
+/**
+ * @brief   Version of the file format
+ * @details Also bumped when the simulation changes, as old recordings would no longer replay the
+ *          same game. Version 2: level of detail of unseen mobs and energy-based mob turns.
+ *          Version 3: number of entities in each map.
+ */
+#define INPUT_RECORD_VERSION 3
+
+/**
+ * @struct input_record
+ * @brief An open recording
+ *
+ * @var input_record::file
+ *   The file
+ * @var input_record::fps
+ *   Frame rate of the recorded session
+ * @var input_record::seed
+ *   Seed of the random number generator of the recorded session
+ * @var input_record::entities
+ *   Number of entities in each map of the recorded session
+ * @var input_record::last
+ *   Last event written or read (for delta encoding)
+ * @var input_record::next
+ *   Event read by ::input_record_peek
+ * @var input_record::has_next
+ *   Whether ::input_record::next holds an event not yet consumed
+ *
+ * @author A104348 Humberto Gomes
+ */
+struct input_record {
+	FILE *file;
+	unsigned int fps, seed, entities;
+
+	input_record_event last, next;
+	int has_next;
+};
+
+/**
+ * @brief Writes an unsigned LEB128 number
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int input_record_write_uleb(FILE *file, uint64_t n) {
+	do {
+		int byte = n & 0x7f;
+		n >>= 7;
+		if (n) byte |= 0x80; /* More bytes follow */
+
+		if (fputc(byte, file) == EOF) return 1;
+	} while (n);
+
+	return 0;
+}
+
+/**
+ * @brief Reads an unsigned LEB128 number
+ * @returns 0 on success, 1 on failure (or end of file)
+ *
+ * @author A104348 Humberto Gomes
+ */
+int input_record_read_uleb(FILE *file, uint64_t *n) {
+	*n = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int byte = fgetc(file);
+		if (byte == EOF) return 1;
+
+		*n |= (uint64_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return 0;
+	}
+
+	return 1; /* Too many bytes */
+}
+
+/**
+ * @brief Allocates an ::input_record for a file
+ * @author A104348 Humberto Gomes
+ */
+input_record *input_record_allocate(FILE *file, unsigned int fps, unsigned int seed,
+                                    unsigned int entities) {
+	input_record *rec = malloc(sizeof(input_record));
+	if (!rec) return NULL;
+
+	rec->file = file;
+	rec->fps = fps;
+	rec->seed = seed;
+	rec->entities = entities;
+
+	memset(&rec->last, 0, sizeof(input_record_event));
+	rec->has_next = 0;
+	return rec;
+}
+
+input_record *input_record_create(const char *path, unsigned int fps, unsigned int seed,
+                                  unsigned int entities) {
+	FILE *file = fopen(path, "wb");
+	if (!file) return NULL;
+
+	if (fwrite(INPUT_RECORD_MAGIC, 1, 4, file) != 4 ||
+	    input_record_write_uleb(file, INPUT_RECORD_VERSION) ||
+	    input_record_write_uleb(file, fps) ||
+	    input_record_write_uleb(file, seed) ||
+	    input_record_write_uleb(file, entities)) {
+
+		fclose(file);
+		return NULL;
+	}
+
+	input_record *rec = input_record_allocate(file, fps, seed, entities);
+	if (!rec) fclose(file);
+	return rec;
+}
+
+input_record *input_record_open(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (!file) return NULL;
+
+	char magic[4];
+	uint64_t version, fps, seed, entities;
+	if (fread(magic, 1, 4, file) != 4 || memcmp(magic, INPUT_RECORD_MAGIC, 4) ||
+	    input_record_read_uleb(file, &version) || version != INPUT_RECORD_VERSION ||
+	    input_record_read_uleb(file, &fps) || fps == 0 ||
+	    input_record_read_uleb(file, &seed) ||
+	    input_record_read_uleb(file, &entities)) {
+
+		fclose(file);
+		return NULL;
+	}
+
+	input_record *rec = input_record_allocate(file, fps, seed, entities);
+	if (!rec) fclose(file);
+	return rec;
+}
+
+int input_record_close(input_record *rec) {
+	int err = fclose(rec->file) == EOF;
+	free(rec);
+	return err;
+}
+
+unsigned int input_record_get_fps(const input_record *rec) {
+	return rec->fps;
+}
+
+unsigned int input_record_get_seed(const input_record *rec) {
+	return rec->seed;
+}
+
+unsigned int input_record_get_entity_count(const input_record *rec) {
+	return rec->entities;
+}
+
+int input_record_write(input_record *rec, input_record_event event) {
+	if (input_record_write_uleb(rec->file, event.frame - rec->last.frame) ||
+	    input_record_write_uleb(rec->file, event.time_us - rec->last.time_us) ||
+	    input_record_write_uleb(rec->file, (unsigned int) event.key) ||
+	    fflush(rec->file) == EOF) /* Keep the recording if the game crashes */
+		return 1;
+
+	rec->last = event;
+	return 0;
+}
+
+int input_record_peek(input_record *rec, input_record_event *event) {
+	if (!rec->has_next) {
+		uint64_t frame, time, key;
+		if (input_record_read_uleb(rec->file, &frame) ||
+		    input_record_read_uleb(rec->file, &time) ||
+		    input_record_read_uleb(rec->file, &key))
+			return 1;
+
+		rec->next.frame   = rec->last.frame   + frame;
+		rec->next.time_us = rec->last.time_us + time;
+		rec->next.key     = (int) key;
+		rec->has_next = 1;
+	}
+
+	*event = rec->next;
+	return 0;
+}
+
+void input_record_next(input_record *rec) {
+	if (rec->has_next) {
+		rec->last = rec->next;
+		rec->has_next = 0;
+	}
+}
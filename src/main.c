@@ -21,14 +21,190 @@
 
 #include <game_state.h>
 #include <game_states/main_menu.h>
+#include <game_states/main_game.h>
+#include <game_states/mob_action.h>
+#include <generate_map.h>
+#include <headless.h>
+#include <batch.h>
+#include <input_record.h>
+#include <profile.h>
+#include <trace.h>
+#include <alloc_track.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Prints how the game should be invoked
+ * @author A104348 Humberto Gomes
+ */
+void main_usage(const char *program) {
+	fprintf(stderr, "Usage: %s [--ansi | --threaded] [--record FILE [--seed S]] [WORLD]\n"
+	                "       %s [--ansi | --threaded] --replay FILE [--fast] [WORLD]\n"
+	                "       %s --headless [--turns N] [--seed S] [WORLD]\n"
+	                "       %s --batch GAMES [--threads T] [--turns N] [--seed S] [WORLD]\n"
+	                "\n"
+	                "  WORLD: [--entities E] [--lod-budget US] [--ai-threads T]\n"
+	                "\n"
+	                "  --ansi      Output with ANSI escape sequences instead of ncurses\n"
+	                "  --threaded  Like --ansi, but output on a separate thread\n"
+	                "  --record    Record all keys pressed to FILE (maps are generated\n"
+	                "              from seeds S, S + 1, ...)\n"
+	                "  --replay    Play the keys recorded in FILE, in real time or, with\n"
+	                "              --fast, as fast as possible, and report the CPU time\n"
+	                "              (on maps with as many entities as when recorded)\n"
+	                "  --headless  Play N turns (default: 100) without a terminal, with a\n"
+	                "              scripted player on a map generated from seed S, and\n"
+	                "              report how long each part of the game took\n"
+	                "  --batch     Like --headless, but play GAMES games (with seeds S,\n"
+	                "              S + 1, ...) on T threads (default: all CPUs), and\n"
+	                "              report aggregated results\n"
+	                "  --entities  Number of entities in each map (default: %d)\n"
+	                "  --lod-budget\n"
+	                "              Microseconds per turn spent moving mobs that the\n"
+	                "              player can't see (default: %d, 0 for no limit). Not\n"
+	                "              used with --record and --replay, that must be exact,\n"
+	                "              and 0 by default with --headless and --batch, so that\n"
+	                "              their results don't depend on the speed of the CPU\n"
+	                "  --ai-threads\n"
+	                "              Threads the AI of visible mobs is planned on (default:\n"
+	                "              all CPUs). Ignored with --batch, that already plays\n"
+	                "              games in parallel\n",
+	                program, program, program, program, GENERATE_MAP_DEFAULT_ENTITIES,
+	                MOB_LOD_DEFAULT_BUDGET);
+}
+
+/**
+ * @brief Parses the value of a numeric command-line option
+ * @returns 0 on success, 1 on failure
+ *
+ * @author A104348 Humberto Gomes
+ */
+int main_parse_unsigned(const char *str, unsigned int *out) {
+	if (!str) return 1;
+
+	char *end;
+	unsigned long value = strtoul(str, &end, 10);
+	if (*str == '\0' || *end != '\0') return 1;
+
+	*out = value;
+	return 0;
+}
 
 /**
  * @brief The entry point for the game
  * @author A104348 Humberto Gomes
  */
-int main(void) {
-	int err = game_loop_init_ncurses();
+int main(int argc, char **argv) {
+	game_loop_backend backend = GAME_LOOP_BACKEND_NCURSES;
+	int headless = 0, fast = 0;
+	unsigned int turns = 100, seed = time(NULL), batch_games = 0, threads = 0;
+	unsigned int entities = GENERATE_MAP_DEFAULT_ENTITIES, lod_budget = MOB_LOD_DEFAULT_BUDGET;
+	unsigned int ai_threads = 0;
+	int lod_budget_given = 0;
+	const char *record_path = NULL, *replay_path = NULL;
+
+	PROFILE_INIT("profile.tsv");
+	TRACE_INIT("trace.json");
+	ALLOC_TRACK_INIT("alloc.tsv");
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--ansi") == 0) {
+			backend = GAME_LOOP_BACKEND_ANSI;
+		} else if (strcmp(argv[i], "--threaded") == 0) {
+			backend = GAME_LOOP_BACKEND_ANSI_THREADED;
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			headless = 1;
+		} else if (strcmp(argv[i], "--turns") == 0 && !main_parse_unsigned(argv[i + 1], &turns)) {
+			++i;
+		} else if (strcmp(argv[i], "--seed") == 0 && !main_parse_unsigned(argv[i + 1], &seed)) {
+			++i;
+		} else if (strcmp(argv[i], "--batch") == 0 &&
+		           !main_parse_unsigned(argv[i + 1], &batch_games)) {
+			++i;
+		} else if (strcmp(argv[i], "--threads") == 0 &&
+		           !main_parse_unsigned(argv[i + 1], &threads)) {
+			++i;
+		} else if (strcmp(argv[i], "--entities") == 0 &&
+		           !main_parse_unsigned(argv[i + 1], &entities)) {
+			++i;
+		} else if (strcmp(argv[i], "--lod-budget") == 0 &&
+		           !main_parse_unsigned(argv[i + 1], &lod_budget)) {
+			lod_budget_given = 1;
+			++i;
+		} else if (strcmp(argv[i], "--ai-threads") == 0 &&
+		           !main_parse_unsigned(argv[i + 1], &ai_threads)) {
+			++i;
+		} else if (strcmp(argv[i], "--record") == 0 && argv[i + 1]) {
+			record_path = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && argv[i + 1]) {
+			replay_path = argv[++i];
+		} else if (strcmp(argv[i], "--fast") == 0) {
+			fast = 1;
+		} else {
+			main_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	/* Benchmarks are only reproducible without a wall-clock budget, unless one is asked for */
+	if ((headless || batch_games) && !lod_budget_given)
+		lod_budget = 0;
+
+	generate_map_set_entity_count(entities);
+	state_main_game_set_lod_budget(record_path || replay_path ? 0 : lod_budget);
+
+	if (batch_games) {
+		printf("Seed: %u\n", seed);
+		batch_result result = batch_run(batch_games, threads, seed, turns);
+		batch_print_result(stdout, &result);
+		return result.games == 0;
+	}
+
+	/* Only one game is played from now on */
+	if (state_main_game_set_ai_threads(ai_threads))
+		fprintf(stderr, "Could not create threads for mob AI. Using a single thread.\n");
+
+	if (headless) {
+		printf("Seed: %u\n", seed);
+		headless_result result = headless_run(seed, turns);
+		headless_print_result(stdout, &result);
+		return 0;
+	}
+
+	if (record_path && replay_path) {
+		main_usage(argv[0]);
+		return 1;
+	}
+
+	/* Input recording / replaying */
+	unsigned int fps = 60;
+	input_record *record = NULL;
+	if (record_path) {
+		record = input_record_create(record_path, fps, seed, entities);
+		if (!record) {
+			fprintf(stderr, "Could not create \"%s\"\n", record_path);
+			return 1;
+		}
+
+		state_main_game_set_seed(seed);
+		game_loop_record_input(record);
+	} else if (replay_path) {
+		record = input_record_open(replay_path);
+		if (!record) {
+			fprintf(stderr, "Could not open the recording \"%s\"\n", replay_path);
+			return 1;
+		}
+
+		state_main_game_set_seed(input_record_get_seed(record));
+		generate_map_set_entity_count(input_record_get_entity_count(record));
+		game_loop_replay_input(record);
+		fps = fast ? 0 : input_record_get_fps(record);
+	}
+
+	int err = game_loop_init_ncurses(backend);
 	if (err) {
 		/* Don't handle errors. Just try to return to a canonical terminal mode */
 		game_loop_terminate_ncurses();
@@ -36,19 +212,50 @@ int main(void) {
 		return 1;
 	}
 
+	struct timespec cpu_start, cpu_end;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+
 	game_state state = state_main_menu_create();
 
-	err = state_game_loop_run(&state, 60);
+	err = state_game_loop_run(&state, fps);
 	if (err) {
 		/* Don't handle errors. Just try to return to a canonical terminal mode */
 		if (state.destroy) state.destroy(&state);
 		game_loop_terminate_ncurses();
+		if (record) input_record_close(record);
 		puts("An error occurred in the game");
 		return 1;
 	}
 
 	if (state.destroy) state.destroy(&state);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
 
 	err = game_loop_terminate_ncurses();
+	if (record && input_record_close(record)) {
+		fprintf(stderr, "Could not write \"%s\"\n", record_path);
+		err = 1;
+	}
+
+	if (record) {
+		game_loop_frame_stats frames = game_loop_get_frame_stats();
+		double cpu_time = (cpu_end.tv_sec - cpu_start.tv_sec) +
+		                  (cpu_end.tv_nsec - cpu_start.tv_nsec) * 1e-9;
+
+		printf("Frames: %" PRIu64 ", CPU time: %.3f s, mean frame: %.3f ms, worst frame: %.3f ms\n",
+		       frames.frames, cpu_time,
+		       frames.frames ? frames.total_time * 1e3 / frames.frames : 0.0,
+		       frames.worst_time * 1e3);
+	}
+
+	ansi_term_stats stats;
+	if (!game_loop_ansi_stats(&stats) && stats.frames)
+		printf("ANSI output: %zu frames, %zu bytes/frame on average, %zu bytes/frame maximum\n",
+		       stats.frames, stats.total_bytes / stats.frames, stats.max_frame_bytes);
+
+	render_thread_stats render_stats;
+	if (!game_loop_render_thread_stats(&render_stats))
+		printf("Render thread: %zu frames published, %zu presented, %zu dropped\n",
+		       render_stats.published, render_stats.presented, render_stats.dropped);
+
 	return err;
 }
@@ -24,6 +24,7 @@
 
 #include <core.h>
 #include <map.h>
+#include <profile.h>
 
 /**
  * @brief Returns the rendering information for a tile type.
@@ -92,20 +93,24 @@ void map_free(map map) {
 
 
 void map_render(map map, const map_window *wnd) {
+	PROFILE_START(PROFILE_TIMER_MAP_RENDER);
 
 	for (int y = 0; y < wnd->height; ++y) {
-		move(wnd->term_top + y, wnd->term_left);
+		wmove(wnd->win, wnd->term_top + y, wnd->term_left);
 		for (int x = 0; x < wnd->width; ++x) {
 
 			unsigned mx = wnd->map_left + x, my = wnd->map_top + y;
 			if (mx < map.width && my < map.height) {
 
 				tile t = map.data[my * map.width + mx];
-				ncurses_char_print(tile_get_render_info(t.type, t.light));
+				ncurses_char_print(wnd->win, tile_get_render_info(t.type, t.light));
 			} else {
-				addch(' ');
+				waddch(wnd->win, ' ');
 			}
 		}
 	}
+
+	PROFILE_COUNT(PROFILE_COUNTER_CELLS_RENDERED, wnd->width * wnd->height);
+	PROFILE_STOP(PROFILE_TIMER_MAP_RENDER);
 }
 
@@ -0,0 +1,266 @@
+/**
+ * @file profile.c
+ * @brief Hot-path counters and cycle timers (only compiled in with `PROFILE=1 make`)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <profile.h>
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief Global state of the profiler
+ *
+ * @var total      Values since the start of the program (updated atomically)
+ * @var turn_start Value of ::total at the start of the current turn
+ * @var last_turn  Values during the last turn
+ * @var max_turn   Maximum values of each counter and timer in a single turn
+ * @var turns      Number of turns played
+ * @var path       Where to write the results on exit (see ::profile_init)
+ * @var lock       Lock for everything except ::total
+ *
+ * @author A104348 Humberto Gomes
+ */
+static struct {
+	profile_snapshot total, turn_start, last_turn, max_turn;
+	uint64_t turns;
+	const char *path;
+	pthread_mutex_t lock;
+} profile_state = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+uint64_t profile_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+void profile_count(profile_counter counter, uint64_t n) {
+	__atomic_fetch_add(&profile_state.total.counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Atomically sets `*value` to the maximum of `*value` and @p candidate
+ * @author A104348 Humberto Gomes
+ */
+void profile_atomic_max(uint64_t *value, uint64_t candidate) {
+	uint64_t current = __atomic_load_n(value, __ATOMIC_RELAXED);
+	while (candidate > current &&
+	       !__atomic_compare_exchange_n(value, &current, candidate, 1,
+	                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void profile_time(profile_timer timer, uint64_t cycles) {
+	profile_timing *t = &profile_state.total.timers[timer];
+	__atomic_fetch_add(&t->calls , 1     , __ATOMIC_RELAXED);
+	__atomic_fetch_add(&t->cycles, cycles, __ATOMIC_RELAXED);
+	profile_atomic_max(&t->max_cycles, cycles);
+}
+
+profile_snapshot profile_get_total(void) {
+	profile_snapshot ret;
+
+	for (int i = 0; i < PROFILE_COUNTER_COUNT; ++i)
+		ret.counters[i] = __atomic_load_n(&profile_state.total.counters[i], __ATOMIC_RELAXED);
+
+	for (int i = 0; i < PROFILE_TIMER_COUNT; ++i) {
+		const profile_timing *t = &profile_state.total.timers[i];
+		ret.timers[i] = (profile_timing) {
+			.calls      = __atomic_load_n(&t->calls     , __ATOMIC_RELAXED),
+			.cycles     = __atomic_load_n(&t->cycles    , __ATOMIC_RELAXED),
+			.max_cycles = __atomic_load_n(&t->max_cycles, __ATOMIC_RELAXED)
+		};
+	}
+
+	return ret;
+}
+
+void profile_end_turn(void) {
+	profile_snapshot total = profile_get_total();
+
+	pthread_mutex_lock(&profile_state.lock);
+	profile_snapshot *last = &profile_state.last_turn, *start = &profile_state.turn_start,
+	                 *max_turn = &profile_state.max_turn;
+
+	for (int i = 0; i < PROFILE_COUNTER_COUNT; ++i) {
+		last->counters[i] = total.counters[i] - start->counters[i];
+		if (last->counters[i] > max_turn->counters[i])
+			max_turn->counters[i] = last->counters[i];
+	}
+
+	for (int i = 0; i < PROFILE_TIMER_COUNT; ++i) {
+		/* The longest call of a turn is unknown. Keep the longest of all calls instead */
+		last->timers[i] = (profile_timing) {
+			.calls      = total.timers[i].calls  - start->timers[i].calls,
+			.cycles     = total.timers[i].cycles - start->timers[i].cycles,
+			.max_cycles = total.timers[i].max_cycles
+		};
+
+		if (last->timers[i].calls > max_turn->timers[i].calls)
+			max_turn->timers[i].calls = last->timers[i].calls;
+		if (last->timers[i].cycles > max_turn->timers[i].cycles)
+			max_turn->timers[i].cycles = last->timers[i].cycles;
+		max_turn->timers[i].max_cycles = total.timers[i].max_cycles;
+	}
+
+	*start = total;
+	profile_state.turns++;
+	pthread_mutex_unlock(&profile_state.lock);
+}
+
+profile_snapshot profile_get_last_turn(void) {
+	pthread_mutex_lock(&profile_state.lock);
+	profile_snapshot ret = profile_state.last_turn;
+	pthread_mutex_unlock(&profile_state.lock);
+	return ret;
+}
+
+const char *profile_counter_get_name(profile_counter counter) {
+	switch (counter) {
+		case PROFILE_COUNTER_PATH_SEARCHES:
+			return "path_searches";
+		case PROFILE_COUNTER_PATH_NODES:
+			return "path_nodes_expanded";
+		case PROFILE_COUNTER_TILES_LIT:
+			return "tiles_lit";
+		case PROFILE_COUNTER_CELLS_RENDERED:
+			return "map_cells_rendered";
+		case PROFILE_COUNTER_ENTITIES_SCANNED:
+			return "closeby_entities_scanned";
+		case PROFILE_COUNTER_MALLOCS:
+			return "mallocs";
+		case PROFILE_COUNTER_LOD_MOVES:
+			return "lod_moves";
+		case PROFILE_COUNTER_LOD_DEFERRED:
+			return "lod_deferred";
+		case PROFILE_COUNTER_MOBS_WOKEN:
+			return "mobs_woken";
+		case PROFILE_COUNTER_MOBS_DUE:
+			return "mobs_due";
+		case PROFILE_COUNTER_LIGHT_MASKS:
+			return "light_masks";
+		case PROFILE_COUNTER_LIGHT_CACHED:
+			return "light_cached";
+		default:
+			return "unknown";
+	}
+}
+
+const char *profile_timer_get_name(profile_timer timer) {
+	switch (timer) {
+		case PROFILE_TIMER_SEARCH_PATH:
+			return "search_path";
+		case PROFILE_TIMER_LIGHT:
+			return "circle_light_map";
+		case PROFILE_TIMER_MAP_RENDER:
+			return "map_render";
+		case PROFILE_TIMER_CLOSEBY:
+			return "entity_get_closeby";
+		case PROFILE_TIMER_LOD:
+			return "mobs_run_lod";
+		default:
+			return "unknown";
+	}
+}
+
+int profile_dump(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (!file) return 1;
+
+	profile_snapshot total = profile_get_total();
+	pthread_mutex_lock(&profile_state.lock);
+	profile_snapshot max_turn = profile_state.max_turn;
+	uint64_t turns = profile_state.turns;
+	pthread_mutex_unlock(&profile_state.lock);
+
+	double per_turn = turns ? 1.0 / turns : 0.0;
+
+	fprintf(file, "turns\t%" PRIu64 "\n\n", turns);
+
+	fprintf(file, "counter\ttotal\tmean_per_turn\tmax_per_turn\n");
+	for (int i = 0; i < PROFILE_COUNTER_COUNT; ++i)
+		fprintf(file, "%s\t%" PRIu64 "\t%.1f\t%" PRIu64 "\n", profile_counter_get_name(i),
+		        total.counters[i], total.counters[i] * per_turn, max_turn.counters[i]);
+
+	fprintf(file, "\ntimer\tcalls\ttotal_cycles\tmean_cycles\tmax_cycles\t"
+	              "mean_cycles_per_turn\tmax_cycles_per_turn\n");
+	for (int i = 0; i < PROFILE_TIMER_COUNT; ++i) {
+		profile_timing t = total.timers[i];
+		fprintf(file, "%s\t%" PRIu64 "\t%" PRIu64 "\t%.0f\t%" PRIu64 "\t%.0f\t%" PRIu64 "\n",
+		        profile_timer_get_name(i), t.calls, t.cycles,
+		        t.calls ? (double) t.cycles / t.calls : 0.0, t.max_cycles,
+		        t.cycles * per_turn, max_turn.timers[i].cycles);
+	}
+
+	return fclose(file) != 0;
+}
+
+/**
+ * @brief Writes the profiling results on exit (registered with `atexit` by ::profile_init)
+ * @author A104348 Humberto Gomes
+ */
+void profile_dump_on_exit(void) {
+	if (profile_dump(profile_state.path))
+		fprintf(stderr, "Could not write profiling results to \"%s\"\n", profile_state.path);
+}
+
+void profile_init(const char *path) {
+	profile_state.path = path;
+	atexit(profile_dump_on_exit);
+}
+
+#if defined(PROFILE) && !defined(ALLOC_TRACK)
+
+/*
+ * Memory allocation functions are wrapped at link time (-Wl,--wrap=malloc), so that allocations
+ * done by the game (not by libraries) are counted. When allocations are also being tracked, the
+ * wrappers in alloc_track.c (that also count them) are used instead.
+ */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+/** @brief Counted `malloc` */
+void *__wrap_malloc(size_t size) {
+	profile_count(PROFILE_COUNTER_MALLOCS, 1);
+	return __real_malloc(size);
+}
+
+/** @brief Counted `calloc` */
+void *__wrap_calloc(size_t count, size_t size) {
+	profile_count(PROFILE_COUNTER_MALLOCS, 1);
+	return __real_calloc(count, size);
+}
+
+/** @brief Counted `realloc` */
+void *__wrap_realloc(void *ptr, size_t size) {
+	profile_count(PROFILE_COUNTER_MALLOCS, 1);
+	return __real_realloc(ptr, size);
+}
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * @file random.c
+ * @brief Instance-local pseudo-random number generation
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <random.h>
+
+/** @brief Multiplier of PCG's linear congruential generator */
+#define RNG_MULTIPLIER 6364136223846793005ULL
+
+rng rng_create(uint64_t seed, uint64_t stream) {
+	/* Initialization as in the reference implementation of PCG */
+	rng r = { .state = 0, .increment = (stream << 1) | 1 };
+	rng_next(&r);
+	r.state += seed;
+	rng_next(&r);
+	return r;
+}
+
+uint32_t rng_next(rng *r) {
+	uint64_t old = r->state;
+	r->state = old * RNG_MULTIPLIER + r->increment;
+
+	/* Output permutation: xorshift, followed by a random rotation */
+	uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+	uint32_t rot = old >> 59;
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+int rng_range(rng *r, int n) {
+	return rng_next(r) % (uint32_t) n;
+}
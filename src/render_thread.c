@@ -0,0 +1,190 @@
+/**
+ * @file render_thread.c
+ * @brief Terminal output on a dedicated thread, fed with immutable frame snapshots
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <render_thread.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+
+/** @brief Bit set on ::render_thread::middle when it holds a frame not yet presented */
+#define RENDER_THREAD_FRESH 4u
+
+/**
+ * @struct render_thread_frame
+ * @brief An immutable (after being published) snapshot of the screen
+ *
+ * @var render_thread_frame::cells
+ *   ncurses cells of the screen, ordered by lines
+ * @var render_thread_frame::width
+ *   Width of the screen
+ * @var render_thread_frame::height
+ *   Height of the screen
+ * @var render_thread_frame::capacity
+ *   Maximum number of cells in ::render_thread_frame::cells
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	chtype *cells;
+	int width, height;
+	size_t capacity;
+} render_thread_frame;
+
+/**
+ * @struct render_thread
+ * @brief State of the render thread
+ *
+ * @var render_thread::frames
+ *   Triple buffer of frames
+ * @var render_thread::back
+ *   Index of the frame being written by the simulation thread (only accessed by it)
+ * @var render_thread::middle
+ *   Index of the latest published frame, ORed with ::RENDER_THREAD_FRESH if it hasn't been
+ *   presented yet. Only accessed atomically.
+ * @var render_thread::front
+ *   Index of the frame being presented by the render thread (only accessed by it)
+ *
+ * @var render_thread::term
+ *   Terminal backend (only accessed by the render thread while it runs)
+ * @var render_thread::thread
+ *   The render thread
+ * @var render_thread::wake
+ *   Posted when a frame is published (or the thread must stop), so that the render thread
+ *   doesn't need to busy-wait
+ * @var render_thread::running
+ *   Cleared to stop the render thread. Only accessed atomically.
+ * @var render_thread::failed
+ *   Set by the render thread when it fails to output to the terminal. Only accessed atomically.
+ *
+ * @var render_thread::stats
+ *   Statistics. render_thread_stats::presented is only accessed atomically.
+ *
+ * @author A104348 Humberto Gomes
+ */
+struct render_thread {
+	render_thread_frame frames[3];
+	unsigned back, middle, front;
+
+	ansi_term *term;
+	pthread_t thread;
+	sem_t wake;
+	int running, failed;
+
+	render_thread_stats stats;
+};
+
+/**
+ * @brief Entry point of the render thread: presents frames as they're published
+ * @author A104348 Humberto Gomes
+ */
+void *render_thread_main(void *arg) {
+	render_thread *rt = arg;
+
+	while (1) {
+		while (sem_wait(&rt->wake) && errno == EINTR);
+
+		/* Exchange the presented frame for the latest one, if it's new */
+		if (__atomic_load_n(&rt->middle, __ATOMIC_ACQUIRE) & RENDER_THREAD_FRESH) {
+			unsigned latest = __atomic_exchange_n(&rt->middle, rt->front, __ATOMIC_ACQ_REL);
+			rt->front = latest & ~RENDER_THREAD_FRESH;
+
+			const render_thread_frame *frame = &rt->frames[rt->front];
+			if (ansi_term_present(rt->term, frame->cells, frame->width, frame->height))
+				__atomic_store_n(&rt->failed, 1, __ATOMIC_RELEASE);
+
+			__atomic_add_fetch(&rt->stats.presented, 1, __ATOMIC_RELAXED);
+		}
+
+		if (!__atomic_load_n(&rt->running, __ATOMIC_ACQUIRE)) break;
+	}
+
+	return NULL;
+}
+
+render_thread *render_thread_create(ansi_term *term) {
+	render_thread *rt = calloc(1, sizeof(render_thread));
+	if (!rt) return NULL;
+
+	rt->back = 0; rt->middle = 1; rt->front = 2;
+	rt->term = term;
+	rt->running = 1;
+
+	if (sem_init(&rt->wake, 0, 0)) {
+		free(rt);
+		return NULL;
+	}
+
+	if (pthread_create(&rt->thread, NULL, render_thread_main, rt)) {
+		sem_destroy(&rt->wake);
+		free(rt);
+		return NULL;
+	}
+
+	return rt;
+}
+
+void render_thread_free(render_thread *rt) {
+	__atomic_store_n(&rt->running, 0, __ATOMIC_RELEASE);
+	sem_post(&rt->wake);
+	pthread_join(rt->thread, NULL);
+
+	sem_destroy(&rt->wake);
+	for (int i = 0; i < 3; ++i)
+		free(rt->frames[i].cells);
+	free(rt);
+}
+
+int render_thread_publish_window(render_thread *rt, WINDOW *win) {
+	render_thread_frame *frame = &rt->frames[rt->back];
+	getmaxyx(win, frame->height, frame->width);
+
+	/* +1: winchnstr writes a terminator after the last cell (see ansi_term_present_window) */
+	size_t cells = (size_t) frame->width * frame->height + 1;
+	if (cells > frame->capacity) {
+		chtype *new_cells = realloc(frame->cells, cells * sizeof(chtype));
+		if (!new_cells) return 1;
+
+		frame->cells = new_cells;
+		frame->capacity = cells;
+	}
+
+	for (int y = 0; y < frame->height; ++y)
+		mvwinchnstr(win, y, 0, frame->cells + y * frame->width, frame->width);
+
+	/* Publish the frame and take the previous one (which the render thread isn't using) */
+	unsigned previous = __atomic_exchange_n(&rt->middle, rt->back | RENDER_THREAD_FRESH,
+		__ATOMIC_ACQ_REL);
+	rt->back = previous & ~RENDER_THREAD_FRESH;
+
+	rt->stats.published++;
+	if (previous & RENDER_THREAD_FRESH) rt->stats.dropped++;
+
+	sem_post(&rt->wake);
+	return __atomic_load_n(&rt->failed, __ATOMIC_ACQUIRE);
+}
+
+render_thread_stats render_thread_get_stats(const render_thread *rt) {
+	render_thread_stats ret = rt->stats;
+	ret.presented = __atomic_load_n(&rt->stats.presented, __ATOMIC_RELAXED);
+	return ret;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file thread_pool.c
+ * @brief A pool of worker threads for running independent tasks in parallel
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <thread_pool.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @struct thread_pool_worker
+ * @brief Argument of a worker thread
+ *
+ * @var thread_pool_worker::pool
+ *   The pool the worker belongs to
+ * @var thread_pool_worker::index
+ *   Index of the worker (see ::thread_pool_task)
+ * @var thread_pool_worker::thread
+ *   The worker thread
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	thread_pool *pool;
+	size_t index;
+	pthread_t thread;
+} thread_pool_worker;
+
+/**
+ * @struct thread_pool
+ * @brief State of a thread pool
+ *
+ * @var thread_pool::workers
+ *   Worker threads (the first one is the calling thread, and is never started)
+ * @var thread_pool::thread_count
+ *   Number of elements in ::thread_pool::workers
+ *
+ * @var thread_pool::mutex
+ *   Protects all fields below, except ::thread_pool::next
+ * @var thread_pool::start
+ *   Signaled when there's a new run (or the pool is being freed)
+ * @var thread_pool::done
+ *   Signaled when the last worker finishes its part of a run
+ *
+ * @var thread_pool::generation
+ *   Incremented on every run, so that workers know when new work is available
+ * @var thread_pool::stop
+ *   Set when the pool is being freed
+ * @var thread_pool::busy
+ *   Number of started threads still working on the current run
+ *
+ * @var thread_pool::task
+ *   Task of the current run
+ * @var thread_pool::data
+ *   Data for ::thread_pool::task
+ * @var thread_pool::count
+ *   Number of tasks in the current run
+ * @var thread_pool::next
+ *   Index of the next task to be taken. Only accessed atomically.
+ *
+ * @author A104348 Humberto Gomes
+ */
+struct thread_pool {
+	thread_pool_worker *workers;
+	size_t thread_count;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t start, done;
+
+	unsigned long generation;
+	int stop;
+	size_t busy;
+
+	thread_pool_task task;
+	void *data;
+	size_t count, next;
+};
+
+/**
+ * @brief Takes and runs tasks of the current run until there are none left
+ * @author A104348 Humberto Gomes
+ */
+void thread_pool_work(thread_pool *pool, size_t worker) {
+	while (1) {
+		size_t index = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+		if (index >= pool->count) return;
+
+		pool->task(index, worker, pool->data);
+	}
+}
+
+/**
+ * @brief Entry point of a worker thread: waits for runs and works on them
+ * @author A104348 Humberto Gomes
+ */
+void *thread_pool_worker_main(void *arg) {
+	thread_pool_worker *worker = arg;
+	thread_pool *pool = worker->pool;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (1) {
+		while (!pool->stop && pool->generation == seen)
+			pthread_cond_wait(&pool->start, &pool->mutex);
+		if (pool->stop) break;
+		seen = pool->generation;
+
+		pthread_mutex_unlock(&pool->mutex);
+		thread_pool_work(pool, worker->index);
+		pthread_mutex_lock(&pool->mutex);
+
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+thread_pool *thread_pool_create(size_t threads) {
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (size_t) cpus : 1;
+	}
+
+	thread_pool *pool = malloc(sizeof(thread_pool));
+	if (!pool) return NULL;
+
+	pool->workers = malloc(threads * sizeof(thread_pool_worker));
+	if (!pool->workers) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->generation = 0;
+	pool->stop = 0;
+	pool->busy = 0;
+	pool->count = pool->next = 0;
+
+	/* Worker 0 is the calling thread */
+	pool->thread_count = 1;
+	for (size_t i = 1; i < threads; ++i) {
+		thread_pool_worker *worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i;
+
+		if (pthread_create(&worker->thread, NULL, thread_pool_worker_main, worker)) {
+			thread_pool_free(pool);
+			return NULL;
+		}
+		pool->thread_count++;
+	}
+
+	return pool;
+}
+
+void thread_pool_free(thread_pool *pool) {
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (size_t i = 1; i < pool->thread_count; ++i)
+		pthread_join(pool->workers[i].thread, NULL);
+
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	free(pool->workers);
+	free(pool);
+}
+
+size_t thread_pool_get_thread_count(const thread_pool *pool) {
+	return pool->thread_count;
+}
+
+void thread_pool_run(thread_pool *pool, size_t count, thread_pool_task task, void *data) {
+	if (count == 0) return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->data = data;
+	pool->count = count;
+	pool->next = 0;
+	pool->busy = pool->thread_count - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->mutex);
+
+	thread_pool_work(pool, 0);
+
+	/* Wait for the other workers to finish their last tasks */
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->busy)
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,196 @@
+/**
+ * @file trace.c
+ * @brief Timeline of events in Chrome's Trace Event format (only compiled in with `TRACE=1 make`)
+ */
+
+/*
+ *   Copyright 2023 Hélder Gomes, Humberto Gomes, Mariana Rocha, Pedro Pereira
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <trace.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @struct trace_event
+ * @brief An event recorded in a ::trace_buffer
+ *
+ * @var trace_event::name
+ *   Name of the event
+ * @var trace_event::time
+ *   Instant of the event (nanoseconds, monotonic clock)
+ * @var trace_event::value
+ *   Identifier (asynchronous events) or argument (see ::trace_event::has_arg)
+ * @var trace_event::type
+ *   Type of the event
+ * @var trace_event::has_arg
+ *   Whether ::trace_event::value is an argument to be shown with the slice
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct {
+	const char *name;
+	uint64_t time, value;
+	trace_event_type type;
+	int has_arg;
+} trace_event;
+
+/**
+ * @struct trace_buffer
+ * @brief Ring buffer of events of a single thread
+ *
+ * @var trace_buffer::events
+ *   Recorded events (`written % TRACE_BUFFER_EVENTS` is the position of the next one)
+ * @var trace_buffer::written
+ *   Number of events ever recorded (only written by the owner thread)
+ * @var trace_buffer::thread
+ *   Identifier of the owner thread in the trace
+ * @var trace_buffer::next
+ *   Next buffer in the list of all buffers (see ::trace_state)
+ *
+ * @author A104348 Humberto Gomes
+ */
+typedef struct trace_buffer {
+	trace_event events[TRACE_BUFFER_EVENTS];
+	uint64_t written;
+	unsigned int thread;
+	struct trace_buffer *next;
+} trace_buffer;
+
+/**
+ * @brief Global state of the tracer
+ *
+ * @var buffers Lock-free list of the buffers of all threads (new buffers are pushed to its head)
+ * @var threads Number of threads that have recorded events
+ * @var origin  Instant that corresponds to the start of the trace
+ * @var path    Where to write the trace on exit (see ::trace_init)
+ *
+ * @author A104348 Humberto Gomes
+ */
+static struct {
+	trace_buffer *buffers;
+	unsigned int threads;
+	uint64_t origin;
+	const char *path;
+} trace_state;
+
+/** @brief Buffer of the current thread (`NULL` until its first event) */
+static __thread trace_buffer *trace_local = NULL;
+
+/**
+ * @brief Gets the current time (in nanoseconds) from a monotonic clock
+ * @author A104348 Humberto Gomes
+ */
+uint64_t trace_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * @brief Creates the buffer of the current thread and adds it to the list of all buffers
+ * @returns `NULL` on allocation failure (events are then ignored)
+ *
+ * @author A104348 Humberto Gomes
+ */
+trace_buffer *trace_buffer_create(void) {
+	trace_buffer *buf = malloc(sizeof(trace_buffer));
+	if (!buf) return NULL;
+
+	buf->written = 0;
+	buf->thread  = __atomic_add_fetch(&trace_state.threads, 1, __ATOMIC_RELAXED);
+
+	buf->next = __atomic_load_n(&trace_state.buffers, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&trace_state.buffers, &buf->next, buf, 1,
+	                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	return buf;
+}
+
+void trace_event_add(trace_event_type type, const char *name, uint64_t value, int has_arg) {
+	if (!trace_local) {
+		trace_local = trace_buffer_create();
+		if (!trace_local) return;
+	}
+
+	uint64_t written = trace_local->written;
+	trace_local->events[written % TRACE_BUFFER_EVENTS] = (trace_event) {
+		.name    = name,
+		.time    = trace_now(),
+		.value   = value,
+		.type    = type,
+		.has_arg = has_arg
+	};
+
+	/* Publish the event only after it's completely written */
+	__atomic_store_n(&trace_local->written, written + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Writes an event as a JSON object
+ * @author A104348 Humberto Gomes
+ */
+void trace_write_event(FILE *file, const trace_event *ev, unsigned int thread, int first) {
+	fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+	        first ? "" : ",", ev->name, (char) ev->type,
+	        (ev->time - trace_state.origin) / 1000.0, thread);
+
+	if (ev->type == TRACE_EVENT_ASYNC_BEGIN || ev->type == TRACE_EVENT_ASYNC_END)
+		fprintf(file, ",\"cat\":\"async\",\"id\":\"0x%" PRIx64 "\"", ev->value);
+	else if (ev->has_arg)
+		fprintf(file, ",\"args\":{\"arg\":%" PRIu64 "}", ev->value);
+
+	fputc('}', file);
+}
+
+int trace_write(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (!file) return 1;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	int first = 1;
+	trace_buffer *buf = __atomic_load_n(&trace_state.buffers, __ATOMIC_ACQUIRE);
+	for (; buf; buf = buf->next) {
+		uint64_t written = __atomic_load_n(&buf->written, __ATOMIC_ACQUIRE);
+		uint64_t start   = written > TRACE_BUFFER_EVENTS ? written - TRACE_BUFFER_EVENTS : 0;
+
+		for (uint64_t i = start; i < written; ++i) {
+			trace_write_event(file, &buf->events[i % TRACE_BUFFER_EVENTS], buf->thread, first);
+			first = 0;
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	return fclose(file) != 0;
+}
+
+/**
+ * @brief Writes the trace on exit (registered with `atexit` by ::trace_init)
+ * @author A104348 Humberto Gomes
+ */
+void trace_write_on_exit(void) {
+	if (trace_write(trace_state.path))
+		fprintf(stderr, "Could not write the trace to \"%s\"\n", trace_state.path);
+}
+
+void trace_init(const char *path) {
+	trace_state.origin = trace_now();
+	trace_state.path   = path;
+	atexit(trace_write_on_exit);
+}